@@ -1,5 +1,7 @@
 // UMA Serve - CLI client (framed JSON over UDS)
 #include "ipc/protocol.h"
+#include "ipc/shm_ring.h"
+#include "ipc/uds_server.h"
 
 #include <sys/socket.h>
 #include <sys/un.h>
@@ -9,6 +11,7 @@
 #include <cstring>
 #include <ctime>
 #include <iostream>
+#include <memory>
 #include <optional>
 #include <sstream>
 #include <string>
@@ -27,12 +30,19 @@ struct CliOptions {
     bool has_top_p = false;
     bool stream = true;
     bool metrics = false;
+    bool binary = false;   // negotiate the binary token stream
+    bool ids_only = false; // binary stream without piece text; prints token ids
+    int flush_ms = 0;             // server-side token coalescing window
+    int min_tokens_per_frame = 0; // server-side token coalescing count
+    bool shm = false;             // receive events through a shared-memory ring
+    std::string prompt_tokens;    // comma-separated token ids (sent instead of --prompt)
+    bool return_prompt_tokens = false;
 };
 
 void print_usage(const char* argv0) {
     std::cerr << "uma-cli - UMA Serve client (UDS, framed JSON)\n"
               << "Usage: " << argv0
-              << " --prompt 'text' [--socket /tmp/uma.sock] [--id req-1] [--max-tokens N] [--temp T] [--top-p P] [--no-stream] [--metrics]\n";
+              << " --prompt 'text' [--socket /tmp/uma.sock] [--id req-1] [--max-tokens N] [--temp T] [--top-p P] [--no-stream] [--binary] [--ids-only] [--flush-ms MS] [--min-tokens-per-frame N] [--shm] [--prompt-tokens 1,2,3] [--return-prompt-tokens] [--metrics]\n";
 }
 
 std::string gen_default_id() {
@@ -77,16 +87,9 @@ bool send_all(int fd, const uint8_t* data, size_t len) {
     return true;
 }
 
-// Very small JSON value extractor for event fields we care about
-std::string json_get_string(const std::string& j, const char* key) {
-    std::string k = std::string("\"") + key + "\"";
-    size_t p = j.find(k);
-    if (p == std::string::npos) return {};
-    size_t colon = j.find(':', p);
-    if (colon == std::string::npos) return {};
-    size_t q1 = j.find('"', colon);
-    if (q1 == std::string::npos) return {};
-    size_t i = q1 + 1;
+// Decode the JSON string whose opening quote is at j[q1]; i is left past the closing quote.
+std::string json_string_at(const std::string& j, size_t q1, size_t& i) {
+    i = q1 + 1;
     std::string out;
     while (i < j.size()) {
         char c = j[i++];
@@ -110,6 +113,94 @@ std::string json_get_string(const std::string& j, const char* key) {
     return out;
 }
 
+// Very small JSON value extractor for event fields we care about
+std::string json_get_string(const std::string& j, const char* key) {
+    std::string k = std::string("\"") + key + "\"";
+    size_t p = j.find(k);
+    if (p == std::string::npos) return {};
+    size_t colon = j.find(':', p);
+    if (colon == std::string::npos) return {};
+    size_t q1 = j.find('"', colon);
+    if (q1 == std::string::npos) return {};
+    size_t i = 0;
+    return json_string_at(j, q1, i);
+}
+
+// Concatenate the strings of a JSON string array (e.g. the "text" of a "tokens" event)
+std::string json_join_string_array(const std::string& j, const char* key) {
+    std::string k = std::string("\"") + key + "\"";
+    size_t p = j.find(k);
+    if (p == std::string::npos) return {};
+    size_t i = j.find('[', p + k.size());
+    if (i == std::string::npos) return {};
+    std::string out;
+    for (++i; i < j.size() && j[i] != ']'; ) {
+        if (j[i] == '"') out += json_string_at(j, i, i);
+        else ++i; // separators / whitespace
+    }
+    return out;
+}
+
+// Read one frame from the socket into js. When fds is non-null, descriptors passed with
+// the frame (SCM_RIGHTS) are stored there. Returns 1 on a frame, 0 on EOF, -1 on error.
+int read_socket_frame(int fd, std::string& js, int* fds = nullptr, int* nfds = nullptr) {
+    uint8_t hdr[4];
+    size_t got = 0;
+    while (got < 4) {
+        ssize_t n = fds ? uma::ipc::UDSServer::recv_with_fds(fd, hdr + got, 4 - got, fds,
+                                                             uma::ipc::UDSServer::kMaxPassFds, nfds)
+                        : ::read(fd, hdr + got, 4 - got);
+        if (n == 0) return got == 0 ? 0 : -1;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (fds && *nfds > 0) fds = nullptr; // descriptors arrive with the first byte only
+        got += (size_t)n;
+    }
+    uint32_t len = (uint32_t)hdr[0] | ((uint32_t)hdr[1] << 8) | ((uint32_t)hdr[2] << 16) | ((uint32_t)hdr[3] << 24);
+    js.resize(len);
+    size_t off = 0;
+    while (off < len) {
+        ssize_t r = ::read(fd, &js[off], len - off);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return -1;
+        off += (size_t)r;
+    }
+    return 1;
+}
+
+// Read one frame from the shared-memory ring (buf keeps partial frames between calls).
+// Returns false once the server closed the ring, or the socket hung up, and no frame is left.
+bool read_ring_frame(uma::ipc::ShmRingReader& ring, int sock, std::string& buf, std::string& js) {
+    for (;;) {
+        if (buf.size() >= 4) {
+            const auto* h = reinterpret_cast<const uint8_t*>(buf.data());
+            uint32_t len = (uint32_t)h[0] | ((uint32_t)h[1] << 8) | ((uint32_t)h[2] << 16) | ((uint32_t)h[3] << 24);
+            if (buf.size() >= 4 + (size_t)len) {
+                js.assign(buf, 4, len);
+                buf.erase(0, 4 + (size_t)len);
+                return true;
+            }
+        }
+        if (size_t avail = ring.available()) {
+            size_t old = buf.size();
+            buf.resize(old + avail);
+            buf.resize(old + ring.read(&buf[old], avail));
+            continue;
+        }
+        if (ring.writer_closed()) {
+            if (ring.available() == 0) return false;
+            continue;
+        }
+        // the socket only becomes readable on hangup (the server never writes to it again)
+        uint8_t probe;
+        ssize_t n = ::recv(sock, &probe, 1, MSG_PEEK | MSG_DONTWAIT);
+        if (n == 0 && ring.available() == 0) return false;
+        ring.wait(-1, n == 0 ? -1 : sock);
+    }
+}
+
 } // namespace
 
 int main(int argc, char** argv) {
@@ -126,6 +217,13 @@ int main(int argc, char** argv) {
         else if (a == "--top-p" && need(i)) { opt.top_p = std::atof(argv[++i]); opt.has_top_p = true; }
         else if (a == "--no-stream") { opt.stream = false; }
         else if (a == "--metrics") { opt.metrics = true; }
+        else if (a == "--binary") { opt.binary = true; }
+        else if (a == "--ids-only") { opt.binary = true; opt.ids_only = true; }
+        else if (a == "--flush-ms" && need(i)) { opt.flush_ms = std::atoi(argv[++i]); }
+        else if (a == "--min-tokens-per-frame" && need(i)) { opt.min_tokens_per_frame = std::atoi(argv[++i]); }
+        else if (a == "--shm") { opt.shm = true; }
+        else if (a == "--prompt-tokens" && need(i)) { opt.prompt_tokens = argv[++i]; }
+        else if (a == "--return-prompt-tokens") { opt.return_prompt_tokens = true; }
         else {
             std::cerr << "Unknown or incomplete flag: " << a << "\n";
             print_usage(argv[0]);
@@ -133,8 +231,8 @@ int main(int argc, char** argv) {
         }
     }
 
-    if (!opt.metrics && opt.prompt.empty()) {
-        std::cerr << "--prompt is required (or use --metrics)\n";
+    if (!opt.metrics && opt.prompt.empty() && opt.prompt_tokens.empty()) {
+        std::cerr << "--prompt or --prompt-tokens is required (or use --metrics)\n";
         print_usage(argv[0]);
         return 1;
     }
@@ -150,17 +248,34 @@ int main(int argc, char** argv) {
         // Build request JSON (minimal manual serialization)
         payload.reserve(opt.prompt.size() + 128);
         payload += "{\"id\":\"" + uma::ipc::protocol::json_escape(opt.id) + "\",";
-        payload += "\"prompt\":\"" + uma::ipc::protocol::json_escape(opt.prompt) + "\",";
+        if (!opt.prompt_tokens.empty()) {
+            // ids are passed through verbatim; the server validates them
+            payload += "\"prompt_tokens\":[" + opt.prompt_tokens + "],";
+        } else {
+            payload += "\"prompt\":\"" + uma::ipc::protocol::json_escape(opt.prompt) + "\",";
+        }
+        if (opt.return_prompt_tokens) payload += "\"return_prompt_tokens\":true,";
         payload += std::string("\"stream\":") + (opt.stream ? "true" : "false");
         if (opt.max_tokens > 0) payload += ",\"max_tokens\":" + std::to_string(opt.max_tokens);
         // temperature/top_p are optional and may be ignored server-side for now
         if (opt.has_temperature) payload += ",\"temperature\":" + std::to_string(opt.temperature);
         if (opt.has_top_p) payload += ",\"top_p\":" + std::to_string(opt.top_p);
+        if (opt.flush_ms > 0) payload += ",\"flush_ms\":" + std::to_string(opt.flush_ms);
+        if (opt.min_tokens_per_frame > 1)
+            payload += ",\"min_tokens_per_frame\":" + std::to_string(opt.min_tokens_per_frame);
         payload += "}";
     }
 
-    // Frame and send
+    // Frame and send (the hello is pipelined ahead of the request)
     std::vector<uint8_t> tx;
+    if ((opt.binary || opt.shm) && !opt.metrics) {
+        std::string hello = std::string("{\"type\":\"hello\",\"stream_format\":\"") +
+                            (opt.binary ? "binary" : "json") + "\"";
+        if (opt.ids_only) hello += ",\"text\":false";
+        if (opt.shm) hello += ",\"transport\":\"shm\"";
+        hello += "}";
+        uma::ipc::protocol::write_frame(tx, hello);
+    }
     uma::ipc::protocol::write_frame(tx, payload);
     if (!send_all(fd, tx.data(), tx.size())) {
         std::perror("send");
@@ -168,28 +283,50 @@ int main(int argc, char** argv) {
         return 3;
     }
 
-    // Receive and print events until eos or error (or metrics one-shot)
-    while (true) {
-        uint8_t hdr[4];
-        ssize_t n = ::read(fd, hdr, 4);
-        if (n == 0) break;
-        if (n < 0) {
-            if (errno == EINTR) continue;
-            std::perror("read");
+    // Shared-memory transport: the hello reply carries the ring's descriptors; every later
+    // event is read from the ring. Without descriptors the server kept the socket transport.
+    std::unique_ptr<uma::ipc::ShmRingReader> ring;
+    std::string ring_buf;
+    std::string js;
+    bool have_frame = false;
+    if (opt.shm && !opt.metrics) {
+        int fds[uma::ipc::UDSServer::kMaxPassFds];
+        int nfds = 0;
+        int rc = read_socket_frame(fd, js, fds, &nfds);
+        if (rc < 0) {
+            std::cerr << "hello read failed\n";
             ::close(fd);
             return 3;
         }
-        if (n != 4) { std::cerr << "short header read\n"; break; }
-        uint32_t len = (uint32_t)hdr[0] | ((uint32_t)hdr[1] << 8) | ((uint32_t)hdr[2] << 16) | ((uint32_t)hdr[3] << 24);
-        std::string js;
-        js.resize(len);
-        size_t off = 0;
-        while (off < len) {
-            ssize_t r = ::read(fd, &js[off], len - off);
-            if (r <= 0) { if (errno == EINTR) continue; break; }
-            off += (size_t)r;
+        if (nfds >= 2) {
+            ring = std::make_unique<uma::ipc::ShmRingReader>();
+            for (int k = 2; k < nfds; ++k) ::close(fds[k]);
+            if (!ring->attach(fds[0], fds[1])) {
+                std::cerr << "invalid shm ring from server\n";
+                ::close(fd);
+                return 3;
+            }
+        } else {
+            for (int k = 0; k < nfds; ++k) ::close(fds[k]);
+        }
+        have_frame = rc > 0;
+    }
+
+    // Receive and print events until eos or error (or metrics one-shot)
+    while (true) {
+        if (have_frame) {
+            have_frame = false;
+        } else if (ring) {
+            if (!read_ring_frame(*ring, fd, ring_buf, js)) break;
+        } else {
+            int rc = read_socket_frame(fd, js);
+            if (rc == 0) break;
+            if (rc < 0) {
+                std::cerr << "short or failed read\n";
+                ::close(fd);
+                return 3;
+            }
         }
-        if (off != len) { std::cerr << "short payload read\n"; break; }
 
         // Metrics one-shot
         if (opt.metrics) {
@@ -198,10 +335,30 @@ int main(int argc, char** argv) {
             return 0;
         }
 
+        if (uma::ipc::protocol::is_binary_payload(js)) {
+            std::vector<uma::ipc::protocol::BinTokenEvent> evs;
+            if (!uma::ipc::protocol::parse_token_events_bin(js, evs)) {
+                std::cerr << "malformed binary frame\n";
+                break;
+            }
+            for (const auto& te : evs) {
+                if (opt.ids_only) std::cout << te.token_id << ' ';
+                else std::cout << te.text;
+            }
+            std::cout << std::flush;
+            continue;
+        }
+
         std::string event = json_get_string(js, "event");
-        if (event == "token") {
+        if (event == "hello" || event == "start") {
+            // stream negotiation / handle announcement; nothing to print
+        } else if (event == "prompt_tokens") {
+            std::cerr << js << std::endl; // keep stdout for generated text
+        } else if (event == "token") {
             std::string text = json_get_string(js, "text");
             if (!text.empty()) std::cout << text << std::flush;
+        } else if (event == "tokens") {
+            std::cout << json_join_string_array(js, "text") << std::flush;
         } else if (event == "eos") {
             std::cout << std::endl;
             ::close(fd);
@@ -0,0 +1,100 @@
+// UMA Serve - Admission queue (requests waiting for a sequence slot)
+#include "ipc/admission.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace uma::ipc {
+
+bool parse_request_class(const char* s, size_t n, RequestClass& out) {
+    auto is = [&](const char* name) { return n == std::strlen(name) && std::memcmp(s, name, n) == 0; };
+    if (is("interactive")) {
+        out = RequestClass::Interactive;
+        return true;
+    }
+    if (is("background")) {
+        out = RequestClass::Background;
+        return true;
+    }
+    return false;
+}
+
+void AdmissionQueue::set_limits(const AdmissionLimits& limits) {
+    limits_ = limits;
+    steps_ewma_ = std::max<double>(limits.initial_steps, 1.0);
+}
+
+void AdmissionQueue::on_finished(uint32_t steps) {
+    steps_ewma_ = 0.8 * steps_ewma_ + 0.2 * std::max<double>(steps, 1.0);
+}
+
+double AdmissionQueue::slot_interval_ms() const {
+    return steps_ewma_ * step_ms_ / std::max<uint32_t>(slots_, 1);
+}
+
+double AdmissionQueue::predict_wait_ms(size_t ahead) const {
+    return (double)(ahead + 1) * slot_interval_ms();
+}
+
+uint32_t AdmissionQueue::retry_hint_ms() const {
+    return (uint32_t)std::max(1.0, std::ceil(slot_interval_ms()));
+}
+
+AdmissionQueue::Verdict AdmissionQueue::check(RequestClass cls, uint32_t target_ttft_ms) const {
+    Verdict v;
+    v.predicted_wait_ms = predict_wait_ms(q_.size());
+    // a client retrying after one slot release finds the queue one shorter
+    const uint32_t one_slot = retry_hint_ms();
+    if (q_.size() >= limits_.max_depth) {
+        v.admit = false;
+        v.reason = "admission queue full";
+        v.retry_after_ms = one_slot;
+        return v;
+    }
+    if (cls == RequestClass::Background && depth(cls) >= limits_.max_background) {
+        v.admit = false;
+        v.reason = "background admission queue full";
+        v.retry_after_ms = one_slot;
+        return v;
+    }
+    const double max_wait_ms = limits_.ttft_slack * target_ttft_ms;
+    if (max_wait_ms > 0 && v.predicted_wait_ms > max_wait_ms) {
+        // shed now rather than miss the target later; retry once the queue has drained
+        // enough for a newcomer to make it
+        v.admit = false;
+        v.shed = true;
+        v.reason = "predicted queue wait exceeds the TTFT target";
+        v.retry_after_ms =
+                std::max(one_slot, (uint32_t)std::ceil(v.predicted_wait_ms - max_wait_ms));
+        return v;
+    }
+    return v;
+}
+
+void AdmissionQueue::push(int sid, RequestClass cls, uint64_t now_ns) {
+    q_.push_back(Entry{sid, cls, now_ns});
+    ++per_class_[(size_t)cls];
+}
+
+bool AdmissionQueue::pop(int& sid, uint64_t& enqueued_ns) {
+    if (q_.empty())
+        return false;
+    const Entry& e = q_.front();
+    sid = e.sid;
+    enqueued_ns = e.enqueued_ns;
+    --per_class_[(size_t)e.cls];
+    q_.pop_front();
+    return true;
+}
+
+bool AdmissionQueue::remove(int sid) {
+    auto it = std::find_if(q_.begin(), q_.end(), [sid](const Entry& e) { return e.sid == sid; });
+    if (it == q_.end())
+        return false;
+    --per_class_[(size_t)it->cls];
+    q_.erase(it);
+    return true;
+}
+
+} // namespace uma::ipc
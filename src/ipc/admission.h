@@ -0,0 +1,86 @@
+// UMA Serve - Admission queue (requests waiting for a sequence slot)
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+namespace uma::ipc {
+
+// Request classes share the sequence slots but have separate queue limits, so a flood of
+// background jobs cannot take every queue position from interactive clients.
+enum class RequestClass : uint8_t {
+    Interactive = 0,
+    Background = 1,
+};
+constexpr size_t kRequestClasses = 2;
+
+// Parses a request's "class" value; false for unknown names.
+bool parse_request_class(const char* s, size_t n, RequestClass& out);
+
+struct AdmissionLimits {
+    uint32_t max_depth = 64;      // queued requests, all classes (0 = never queue)
+    uint32_t max_background = 16; // queued background requests (counted in max_depth too)
+    // Shed a request whose predicted wait exceeds ttft_slack x its TTFT target (0 = never).
+    double ttft_slack = 4.0;
+    // Decode steps a request is assumed to hold its slot before any has finished.
+    uint32_t initial_steps = 64;
+};
+
+// FIFO of requests that arrived while every sequence slot was taken. It only holds sids and
+// decides; SessionManager owns the requests and hands out the slots.
+//
+// Waits are predicted from the queue position and the recent step time (the scheduler's
+// decode EWMA): a slot frees up every steps_per_request * step_ms / slots on average, and a
+// request with `ahead` requests in front of it needs ahead + 1 of them.
+class AdmissionQueue {
+  public:
+    struct Verdict {
+        bool admit = true;              // false: reject with E_OVERLOADED
+        bool shed = false;              // rejected on predicted wait rather than queue limits
+        const char* reason = nullptr;   // message for the error event
+        uint32_t retry_after_ms = 0;    // hint for the client
+        double predicted_wait_ms = 0.0; // wait a newcomer of this class would see
+    };
+
+    void set_limits(const AdmissionLimits& limits);
+    void set_slots(uint32_t slots) { slots_ = slots; }
+    void set_step_ms(double ms) { step_ms_ = ms > 0 ? ms : 0; }
+    // A request that held a slot finished after `steps` decode steps.
+    void on_finished(uint32_t steps);
+
+    double predict_wait_ms(size_t ahead) const;
+    // Retry hint when the next slot release is what a client needs (at least 1 ms).
+    uint32_t retry_hint_ms() const;
+    // Whether a request of class `cls` with the given TTFT target may join the queue now.
+    Verdict check(RequestClass cls, uint32_t target_ttft_ms) const;
+
+    void push(int sid, RequestClass cls, uint64_t now_ns);
+    // Oldest waiting request; false when empty.
+    bool pop(int& sid, uint64_t& enqueued_ns);
+    // Drop a request that went away while waiting; false if it was not queued.
+    bool remove(int sid);
+
+    bool empty() const { return q_.empty(); }
+    size_t depth() const { return q_.size(); }
+    size_t depth(RequestClass cls) const { return per_class_[(size_t)cls]; }
+    double steps_per_request() const { return steps_ewma_; }
+
+  private:
+    struct Entry {
+        int sid;
+        RequestClass cls;
+        uint64_t enqueued_ns;
+    };
+    // Mean time between slot releases with every slot busy.
+    double slot_interval_ms() const;
+
+    std::deque<Entry> q_;
+    size_t per_class_[kRequestClasses] = {};
+    AdmissionLimits limits_;
+    uint32_t slots_ = 1;
+    double step_ms_ = 0.0;
+    double steps_ewma_ = 64.0;
+};
+
+} // namespace uma::ipc
@@ -0,0 +1,82 @@
+// UMA Serve - Byte buffer for session rx/tx (consume-by-offset, lazy compaction)
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+namespace uma::ipc {
+
+// Contiguous byte FIFO. Readers consume from the front by advancing an offset, so
+// consume() is O(1) and never moves bytes; the dead prefix is reclaimed lazily when a
+// writer needs room (only once it is at least as large as the live data, which keeps
+// compaction amortized O(1) per byte).
+//
+// Pointer/view stability: data()/view() stay valid across consume(); they are
+// invalidated by append()/prepare()/clear().
+class ByteBuffer {
+  public:
+    ByteBuffer() = default;
+
+    const uint8_t* data() const { return buf_.data() + head_; }
+    uint8_t* mutable_data() { return buf_.data() + head_; }
+    size_t size() const { return tail_ - head_; }
+    bool empty() const { return head_ == tail_; }
+    size_t capacity() const { return buf_.size(); }
+
+    std::string_view view() const {
+        return {reinterpret_cast<const char*>(data()), size()};
+    }
+    std::string_view view(size_t off, size_t len) const {
+        return {reinterpret_cast<const char*>(data()) + off, len};
+    }
+
+    // Drop n bytes from the front (n is clamped to size()).
+    void consume(size_t n) {
+        head_ += std::min(n, size());
+        if (head_ == tail_)
+            head_ = tail_ = 0; // empty: rewind for free
+    }
+
+    void clear() { head_ = tail_ = 0; }
+
+    // Writable region of at least n bytes at the back; follow with commit(k), k <= n.
+    uint8_t* prepare(size_t n) {
+        reserve_back(n);
+        return buf_.data() + tail_;
+    }
+    void commit(size_t n) { tail_ = std::min(tail_ + n, buf_.size()); }
+
+    void append(const void* p, size_t n) {
+        if (n == 0)
+            return;
+        std::memcpy(prepare(n), p, n);
+        tail_ += n;
+    }
+    void append(std::string_view s) { append(s.data(), s.size()); }
+    void push_back(uint8_t b) { append(&b, 1); }
+
+  private:
+    void reserve_back(size_t n) {
+        if (buf_.size() - tail_ >= n)
+            return;
+        const size_t live = size();
+        if (head_ > 0 && head_ >= live && buf_.size() - live >= n) {
+            // enough dead prefix to make room: slide live bytes down
+            std::memmove(buf_.data(), buf_.data() + head_, live);
+            head_ = 0;
+            tail_ = live;
+            return;
+        }
+        buf_.resize(std::max(buf_.size() * 2, tail_ + n));
+    }
+
+    std::vector<uint8_t> buf_;
+    size_t head_ = 0;
+    size_t tail_ = 0;
+};
+
+} // namespace uma::ipc
@@ -0,0 +1,40 @@
+// UMA Serve - Per-request streaming detokenizer (UTF-8 boundary aware)
+#include "ipc/detokenizer.h"
+
+#include "ipc/protocol.h"
+#include "util/utf8.h"
+
+namespace uma::ipc {
+
+std::string_view StreamDetokenizer::push(const PieceTable& pieces, int32_t id, bool json) {
+    if (pending_.empty() && pieces.whole(id))
+        return json ? pieces.json(id) : pieces.piece(id);
+
+    joined_.assign(pending_);
+    joined_.append(pieces.piece(id));
+    const size_t tail = uma::util::utf8_incomplete_tail(joined_);
+    pending_.assign(joined_, joined_.size() - tail, tail);
+    if (tail != 0)
+        pending_id_ = id;
+    return render(std::string_view(joined_).substr(0, joined_.size() - tail), json);
+}
+
+std::string_view StreamDetokenizer::finish(bool json) {
+    if (pending_.empty())
+        return {};
+    joined_.swap(pending_);
+    pending_.clear();
+    return render(joined_, json);
+}
+
+std::string_view StreamDetokenizer::render(std::string_view raw, bool json) {
+    clean_.clear();
+    uma::util::append_utf8_sanitized(clean_, raw);
+    if (!json)
+        return clean_;
+    out_.resize(protocol::json_escape_bound(clean_.size()));
+    out_.resize(protocol::json_escape_to(&out_[0], clean_));
+    return out_;
+}
+
+} // namespace uma::ipc
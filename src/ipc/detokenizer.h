@@ -0,0 +1,42 @@
+// UMA Serve - Per-request streaming detokenizer (UTF-8 boundary aware)
+#pragma once
+
+#include "ipc/piece_table.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace uma::ipc {
+
+// Turns a request's token stream into text that never splits a UTF-8 character.
+// Byte-fallback tokens can carry one to three bytes of a multi-byte character. Their
+// incomplete tail is held and prepended to the next piece. Ill-formed bytes become
+// U+FFFD, so every frame carries valid UTF-8. Pieces that are whole on their own and
+// arrive with nothing held are returned straight from the PieceTable (no copy).
+class StreamDetokenizer {
+  public:
+    // Text to emit for `id`, JSON-escaped when `json` is set. An empty result with
+    // holding() == true means the token only extended a pending character. The view is
+    // valid until the next call.
+    std::string_view push(const PieceTable& pieces, int32_t id, bool json);
+
+    // End of stream: held bytes that never completed, as U+FFFD (empty if none).
+    std::string_view finish(bool json);
+
+    bool holding() const { return !pending_.empty(); }
+    // Last token that only extended the pending character (meaningful while holding()).
+    int32_t pending_id() const { return pending_id_; }
+    void reset() { pending_.clear(); }
+
+  private:
+    std::string_view render(std::string_view raw, bool json);
+
+    std::string pending_; // incomplete tail, at most 3 bytes
+    int32_t pending_id_ = -1;
+    std::string joined_;  // pending_ + piece
+    std::string clean_;   // sanitized text
+    std::string out_;     // escaped text
+};
+
+} // namespace uma::ipc
@@ -0,0 +1,50 @@
+// UMA Serve - TX I/O engines (batched per-tick socket writes)
+#include "ipc/io_engine.h"
+
+#include "util/logging.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace uma::ipc {
+
+#ifdef UMA_HAVE_IO_URING
+// defined in io_engine_uring.cpp; returns nullptr when a ring cannot be created
+std::unique_ptr<IoEngine> make_uring_engine(unsigned entries);
+#endif
+
+size_t WriteEngine::flush(std::vector<SendOp>& ops) {
+#ifdef MSG_NOSIGNAL
+    constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+    constexpr int kSendFlags = 0; // macOS: sockets carry SO_NOSIGPIPE instead
+#endif
+    for (auto& op : ops) {
+        struct msghdr msg;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = const_cast<struct iovec*>(op.iov);
+        msg.msg_iovlen = op.iovcnt;
+        ssize_t n = ::sendmsg(op.fd, &msg, kSendFlags);
+        op.result = n >= 0 ? n : -static_cast<ssize_t>(errno);
+    }
+    return ops.size();
+}
+
+std::unique_ptr<IoEngine> make_io_engine(const std::string& kind) {
+    if (kind == "uring" || kind == "io_uring") {
+#ifdef UMA_HAVE_IO_URING
+        if (auto eng = make_uring_engine(256))
+            return eng;
+        UMA_LOG_WARN() << "io_uring setup failed; falling back to write engine";
+#else
+        UMA_LOG_WARN() << "io_uring not available in this build; using write engine";
+#endif
+    } else if (kind != "write") {
+        UMA_LOG_WARN() << "unknown io engine '" << kind << "'; using write engine";
+    }
+    return std::make_unique<WriteEngine>();
+}
+
+} // namespace uma::ipc
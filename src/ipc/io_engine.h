@@ -0,0 +1,48 @@
+// UMA Serve - TX I/O engines (batched per-tick socket writes)
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <vector>
+
+namespace uma::ipc {
+
+// One pending gather-send for a client socket (typically TxQueue::fill_iov output; the
+// iovec array must outlive flush()). `result` is filled by IoEngine::flush(): bytes
+// written (>= 0) or -errno (e.g. -EAGAIN when the socket buffer is full).
+struct SendOp {
+    int fd = -1;
+    const struct iovec* iov = nullptr;
+    int iovcnt = 0;
+    ssize_t result = 0;
+};
+
+// Flushes the sessions that produced output during a scheduler tick. The default engine
+// issues one sendmsg() per session; the io_uring engine (Linux) submits every send of the
+// tick with a single io_uring_enter().
+class IoEngine {
+  public:
+    virtual ~IoEngine() = default;
+
+    // Attempt every op once (no retry on short writes). Returns the number of syscalls made.
+    virtual size_t flush(std::vector<SendOp>& ops) = 0;
+
+    virtual const char* name() const = 0;
+};
+
+// Plain sendmsg(2) per op.
+class WriteEngine : public IoEngine {
+  public:
+    size_t flush(std::vector<SendOp>& ops) override;
+    const char* name() const override { return "write"; }
+};
+
+// Create the engine named by `kind` ("write" or "uring"). Falls back to WriteEngine when
+// io_uring is not compiled in or the kernel refuses to set up a ring.
+std::unique_ptr<IoEngine> make_io_engine(const std::string& kind);
+
+} // namespace uma::ipc
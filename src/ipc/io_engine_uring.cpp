@@ -0,0 +1,196 @@
+// UMA Serve - io_uring TX engine (Linux only; raw syscalls, no liburing dependency)
+#include "ipc/io_engine.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace uma::ipc {
+
+namespace {
+
+int sys_io_uring_setup(unsigned entries, io_uring_params* p) {
+    return (int)::syscall(__NR_io_uring_setup, entries, p);
+}
+
+int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+template <typename T> T* at(void* base, uint32_t off) {
+    return reinterpret_cast<T*>(static_cast<uint8_t*>(base) + off);
+}
+
+// Minimal single-issuer ring: submit N sends, wait for N completions, return.
+// Only the event-loop thread touches it, so head/tail need acquire/release against the
+// kernel only.
+class UringEngine : public IoEngine {
+  public:
+    explicit UringEngine(unsigned entries) {
+        io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        ring_fd_ = sys_io_uring_setup(entries, &p);
+        if (ring_fd_ < 0)
+            return;
+
+        sq_sz_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_sz_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        const bool single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap) {
+            sq_sz_ = cq_sz_ = std::max(sq_sz_, cq_sz_);
+        }
+        sq_ptr_ = ::mmap(nullptr, sq_sz_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         ring_fd_, IORING_OFF_SQ_RING);
+        if (sq_ptr_ == MAP_FAILED)
+            return;
+        if (single_mmap) {
+            cq_ptr_ = sq_ptr_;
+        } else {
+            cq_ptr_ = ::mmap(nullptr, cq_sz_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                             ring_fd_, IORING_OFF_CQ_RING);
+            if (cq_ptr_ == MAP_FAILED)
+                return;
+        }
+        sqes_sz_ = p.sq_entries * sizeof(io_uring_sqe);
+        void* sq = ::mmap(nullptr, sqes_sz_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ring_fd_, IORING_OFF_SQES);
+        if (sq == MAP_FAILED)
+            return;
+        sqes_ = static_cast<io_uring_sqe*>(sq);
+
+        sq_entries_ = p.sq_entries;
+        msgs_.resize(sq_entries_);
+        sq_tail_ = at<unsigned>(sq_ptr_, p.sq_off.tail);
+        sq_mask_ = *at<unsigned>(sq_ptr_, p.sq_off.ring_mask);
+        sq_array_ = at<unsigned>(sq_ptr_, p.sq_off.array);
+        cq_head_ = at<unsigned>(cq_ptr_, p.cq_off.head);
+        cq_tail_ = at<unsigned>(cq_ptr_, p.cq_off.tail);
+        cq_mask_ = *at<unsigned>(cq_ptr_, p.cq_off.ring_mask);
+        cqes_ = at<io_uring_cqe>(cq_ptr_, p.cq_off.cqes);
+        ready_ = true;
+    }
+
+    ~UringEngine() override {
+        if (sqes_)
+            ::munmap(sqes_, sqes_sz_);
+        if (cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_)
+            ::munmap(cq_ptr_, cq_sz_);
+        if (sq_ptr_ != MAP_FAILED)
+            ::munmap(sq_ptr_, sq_sz_);
+        if (ring_fd_ >= 0)
+            ::close(ring_fd_);
+    }
+
+    bool ready() const { return ready_; }
+
+    size_t flush(std::vector<SendOp>& ops) override {
+        if (broken_)
+            return fallback_.flush(ops);
+        size_t syscalls = 0;
+        for (size_t base = 0; base < ops.size(); base += sq_entries_) {
+            const size_t n = std::min<size_t>(sq_entries_, ops.size() - base);
+            syscalls += submit_and_wait(ops, base, n);
+            if (broken_) {
+                // ring unusable: finish the remainder with plain writes
+                std::vector<SendOp> rest(ops.begin() + (ptrdiff_t)(base + n), ops.end());
+                syscalls += fallback_.flush(rest);
+                std::copy(rest.begin(), rest.end(), ops.begin() + (ptrdiff_t)(base + n));
+                break;
+            }
+        }
+        return syscalls;
+    }
+
+    const char* name() const override { return "io_uring"; }
+
+  private:
+    size_t submit_and_wait(std::vector<SendOp>& ops, size_t base, size_t n) {
+        unsigned tail = *sq_tail_; // only we write the SQ tail
+        for (size_t i = 0; i < n; ++i) {
+            const SendOp& op = ops[base + i];
+            const unsigned idx = tail & sq_mask_;
+            // the kernel reads the msghdr at submission; keep it alive until reaped
+            struct msghdr& msg = msgs_[i];
+            std::memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = const_cast<struct iovec*>(op.iov);
+            msg.msg_iovlen = op.iovcnt;
+            io_uring_sqe* sqe = &sqes_[idx];
+            std::memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_SENDMSG;
+            sqe->fd = op.fd;
+            sqe->addr = reinterpret_cast<uint64_t>(&msg);
+            sqe->len = 1;
+            sqe->msg_flags = MSG_DONTWAIT | MSG_NOSIGNAL;
+            sqe->user_data = base + i;
+            sq_array_[idx] = idx;
+            ++tail;
+        }
+        __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+
+        size_t syscalls = 0;
+        unsigned to_submit = (unsigned)n;
+        size_t reaped = 0;
+        while (reaped < n) {
+            ++syscalls;
+            int rc = sys_io_uring_enter(ring_fd_, to_submit, (unsigned)(n - reaped),
+                                        IORING_ENTER_GETEVENTS);
+            if (rc < 0) {
+                if (errno == EINTR)
+                    continue;
+                // SQEs may still reference caller buffers; never touch this ring again
+                broken_ = true;
+                for (size_t i = reaped; i < n; ++i)
+                    ops[base + i].result = -static_cast<ssize_t>(EIO);
+                return syscalls;
+            }
+            to_submit -= std::min<unsigned>(to_submit, (unsigned)rc);
+
+            unsigned head = *cq_head_;
+            const unsigned ctail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+            for (; head != ctail; ++head) {
+                const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+                if (cqe.user_data < ops.size())
+                    ops[cqe.user_data].result = cqe.res;
+                ++reaped;
+            }
+            __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        }
+        return syscalls;
+    }
+
+    int ring_fd_ = -1;
+    bool ready_ = false;
+    bool broken_ = false;
+    unsigned sq_entries_ = 0;
+    void* sq_ptr_ = MAP_FAILED;
+    size_t sq_sz_ = 0;
+    void* cq_ptr_ = MAP_FAILED;
+    size_t cq_sz_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqes_sz_ = 0;
+    unsigned* sq_tail_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned* sq_array_ = nullptr;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+    std::vector<struct msghdr> msgs_; // one per in-flight SQE
+    WriteEngine fallback_;
+};
+
+} // namespace
+
+std::unique_ptr<IoEngine> make_uring_engine(unsigned entries) {
+    auto eng = std::make_unique<UringEngine>(entries);
+    if (!eng->ready())
+        return nullptr;
+    return eng;
+}
+
+} // namespace uma::ipc
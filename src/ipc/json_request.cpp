@@ -0,0 +1,729 @@
+// UMA Serve - Single-pass JSON request parser (client -> server frames)
+#include "ipc/json_request.h"
+
+#include "util/utf8.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace uma::ipc {
+
+void JsonRequest::clear() {
+    type.clear();
+    event.clear();
+    id.clear();
+    prompt.clear();
+    has_prompt_tokens = false;
+    prompt_tokens.clear();
+    prompt_tokens_b64.clear();
+    return_prompt_tokens.reset();
+    stream_format.clear();
+    transport.clear();
+    text.reset();
+    shm_bytes.reset();
+    stream.reset();
+    temperature.reset();
+    top_p.reset();
+    top_k.reset();
+    flush_ms.reset();
+    min_tokens_per_frame.reset();
+    slo_ttft_ms.reset();
+    slo_tbt_ms.reset();
+    slo_priority.reset();
+    request_class.clear();
+}
+
+namespace {
+
+constexpr int kMaxDepth = 64; // nesting allowed inside skipped values
+
+// First byte in [p, end) that ends a run of plain string bytes: '"', '\\' or a control
+// character (< 0x20). Sets `high` if a byte >= 0x80 may have been passed over (a cheap
+// hint used to skip UTF-8 validation of pure-ASCII strings; false positives are fine).
+const char* scan_string_run(const char* p, const char* end, bool& high) {
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i bslash = _mm_set1_epi8('\\');
+    const __m128i ctl = _mm_set1_epi8(0x1f);
+    while (end - p >= 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        // unsigned v <= 0x1f  <=>  max(v, 0x1f) == 0x1f
+        const __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash)),
+                                       _mm_cmpeq_epi8(_mm_max_epu8(v, ctl), ctl));
+        high |= _mm_movemask_epi8(v) != 0;
+        const int mask = _mm_movemask_epi8(m);
+        if (mask != 0)
+            return p + __builtin_ctz((unsigned)mask);
+        p += 16;
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t bslash = vdupq_n_u8('\\');
+    const uint8x16_t ctl = vdupq_n_u8(0x1f);
+    while (end - p >= 16) {
+        const uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+        const uint8x16_t m =
+                vorrq_u8(vorrq_u8(vceqq_u8(v, quote), vceqq_u8(v, bslash)), vcleq_u8(v, ctl));
+        high |= vmaxvq_u8(v) >= 0x80;
+        if (vmaxvq_u8(m) != 0)
+            break; // the stop byte is in this block; the scalar tail finds it
+        p += 16;
+    }
+#endif
+    for (; p < end; ++p) {
+        const unsigned char c = static_cast<unsigned char>(*p);
+        if (c == '"' || c == '\\' || c < 0x20)
+            return p;
+        high |= c >= 0x80;
+    }
+    return end;
+}
+
+int hex_val(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+void put_utf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out.push_back((char)cp);
+    } else if (cp < 0x800) {
+        out.push_back((char)(0xC0 | (cp >> 6)));
+        out.push_back((char)(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back((char)(0xE0 | (cp >> 12)));
+        out.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back((char)(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back((char)(0xF0 | (cp >> 18)));
+        out.push_back((char)(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back((char)(0x80 | (cp & 0x3F)));
+    }
+}
+
+int base64_val(unsigned char c) {
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A';
+    if (c >= 'a' && c <= 'z')
+        return c - 'a' + 26;
+    if (c >= '0' && c <= '9')
+        return c - '0' + 52;
+    if (c == '+')
+        return 62;
+    if (c == '/')
+        return 63;
+    return -1;
+}
+
+// Standard padded base64 of packed little-endian int32 ids. false if malformed.
+bool decode_token_blob(std::string_view b64, std::vector<int32_t>& out) {
+    if (b64.size() % 4 != 0)
+        return false;
+    size_t pad = 0;
+    if (!b64.empty() && b64.back() == '=')
+        pad = (b64.size() >= 2 && b64[b64.size() - 2] == '=') ? 2 : 1;
+    const size_t nbytes = b64.size() / 4 * 3 - pad;
+    if (nbytes % 4 != 0)
+        return false;
+    out.reserve(out.size() + nbytes / 4);
+    uint32_t word = 0;
+    size_t have = 0; // bytes accumulated into word
+    for (size_t i = 0; i < b64.size(); i += 4) {
+        uint32_t quad = 0;
+        size_t n_out = 3;
+        for (size_t k = 0; k < 4; ++k) {
+            const unsigned char c = (unsigned char)b64[i + k];
+            int v;
+            if (c == '=' && i + 4 == b64.size() && k >= 4 - pad) {
+                v = 0;
+                n_out = std::min(n_out, k - 1);
+            } else if ((v = base64_val(c)) < 0) {
+                return false;
+            }
+            quad = (quad << 6) | (uint32_t)v;
+        }
+        for (size_t k = 0; k < n_out; ++k) {
+            const uint32_t byte = (quad >> (16 - 8 * k)) & 0xff;
+            word |= byte << (8 * have);
+            if (++have == 4) {
+                out.push_back((int32_t)word);
+                word = 0;
+                have = 0;
+            }
+        }
+    }
+    return have == 0;
+}
+
+// Keys the parser dispatches on (top level unless noted).
+enum class Key {
+    Unknown,
+    Type,
+    Event,
+    Id,
+    Prompt,
+    StreamFormat,
+    Transport,
+    Text,
+    ShmBytes,
+    Stream,
+    Temperature,
+    TopP,
+    TopK,
+    FlushMs,
+    MinTokensPerFrame,
+    Slo,
+    PromptTokens,
+    ReturnPromptTokens,
+    Class,
+};
+
+Key classify_key(std::string_view k) {
+    switch (k.size()) {
+        case 2:
+            if (k == "id")
+                return Key::Id;
+            break;
+        case 4:
+            if (k == "type")
+                return Key::Type;
+            if (k == "text")
+                return Key::Text;
+            break;
+        case 3:
+            if (k == "slo")
+                return Key::Slo;
+            break;
+        case 5:
+            if (k == "event")
+                return Key::Event;
+            if (k == "top_p")
+                return Key::TopP;
+            if (k == "top_k")
+                return Key::TopK;
+            if (k == "class")
+                return Key::Class;
+            break;
+        case 6:
+            if (k == "prompt")
+                return Key::Prompt;
+            if (k == "stream")
+                return Key::Stream;
+            break;
+        case 8:
+            if (k == "flush_ms")
+                return Key::FlushMs;
+            break;
+        case 9:
+            if (k == "transport")
+                return Key::Transport;
+            if (k == "shm_bytes")
+                return Key::ShmBytes;
+            break;
+        case 11:
+            if (k == "temperature")
+                return Key::Temperature;
+            break;
+        case 13:
+            if (k == "stream_format")
+                return Key::StreamFormat;
+            if (k == "prompt_tokens")
+                return Key::PromptTokens;
+            break;
+        case 20:
+            if (k == "min_tokens_per_frame")
+                return Key::MinTokensPerFrame;
+            if (k == "return_prompt_tokens")
+                return Key::ReturnPromptTokens;
+            break;
+        default:
+            break;
+    }
+    return Key::Unknown;
+}
+
+class Parser {
+  public:
+    Parser(std::string_view js, JsonRequest& out)
+        : p_(js.data()), end_(js.data() + js.size()), out_(out) {}
+
+    JsonParseStatus run() {
+        skip_ws();
+        if (!parse_object(/*top*/ true, 0))
+            return status_;
+        skip_ws();
+        return p_ == end_ ? JsonParseStatus::Ok : JsonParseStatus::Syntax;
+    }
+
+  private:
+    bool fail(JsonParseStatus st) {
+        status_ = st;
+        return false;
+    }
+
+    void skip_ws() {
+        while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r'))
+            ++p_;
+    }
+
+    bool consume(char c) {
+        skip_ws();
+        if (p_ >= end_ || *p_ != c)
+            return fail(JsonParseStatus::Syntax);
+        ++p_;
+        return true;
+    }
+
+    // p_ is just past the opening quote. Decodes into *out (nullptr = validate only).
+    bool parse_string(std::string* out) {
+        for (;;) {
+            bool high = false;
+            const char* stop = scan_string_run(p_, end_, high);
+            // raw bytes must be UTF-8; a run ends before any escape, so it is checked alone
+            // (escapes always decode to valid sequences)
+            if (high && !uma::util::is_valid_utf8(std::string_view(p_, (size_t)(stop - p_))))
+                return fail(JsonParseStatus::BadString);
+            if (out)
+                out->append(p_, (size_t)(stop - p_));
+            p_ = stop;
+            if (p_ >= end_)
+                return fail(JsonParseStatus::Syntax); // unterminated
+            const char c = *p_++;
+            if (c == '"')
+                break;
+            if (c != '\\')
+                return fail(JsonParseStatus::BadString); // raw control character
+            if (p_ >= end_)
+                return fail(JsonParseStatus::BadString);
+            const char e = *p_++;
+            char lit = 0;
+            switch (e) {
+                case '"':
+                case '\\':
+                case '/':
+                    lit = e;
+                    break;
+                case 'b':
+                    lit = '\b';
+                    break;
+                case 'f':
+                    lit = '\f';
+                    break;
+                case 'n':
+                    lit = '\n';
+                    break;
+                case 'r':
+                    lit = '\r';
+                    break;
+                case 't':
+                    lit = '\t';
+                    break;
+                case 'u': {
+                    uint32_t cp = 0;
+                    if (!parse_hex4(cp))
+                        return false;
+                    if (cp >= 0xD800 && cp <= 0xDBFF) {
+                        // high surrogate: must be followed by an escaped low surrogate
+                        uint32_t lo = 0;
+                        if (end_ - p_ < 2 || p_[0] != '\\' || p_[1] != 'u')
+                            return fail(JsonParseStatus::BadString);
+                        p_ += 2;
+                        if (!parse_hex4(lo))
+                            return false;
+                        if (lo < 0xDC00 || lo > 0xDFFF)
+                            return fail(JsonParseStatus::BadString);
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                    } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                        return fail(JsonParseStatus::BadString); // lone low surrogate
+                    }
+                    if (out)
+                        put_utf8(*out, cp);
+                    continue;
+                }
+                default:
+                    return fail(JsonParseStatus::BadString);
+            }
+            if (out)
+                out->push_back(lit);
+        }
+        return true;
+    }
+
+    bool parse_hex4(uint32_t& cp) {
+        if (end_ - p_ < 4)
+            return fail(JsonParseStatus::BadString);
+        cp = 0;
+        for (int i = 0; i < 4; ++i) {
+            const int h = hex_val(p_[i]);
+            if (h < 0)
+                return fail(JsonParseStatus::BadString);
+            cp = (cp << 4) | (uint32_t)h;
+        }
+        p_ += 4;
+        return true;
+    }
+
+    // Object key: the common escape-free case is compared in place; a key with escapes
+    // can never match a known name, so it is only validated.
+    bool parse_key(Key& key) {
+        if (!consume('"'))
+            return false;
+        bool high = false;
+        const char* start = p_;
+        const char* stop = scan_string_run(p_, end_, high);
+        if (stop < end_ && *stop == '"') {
+            key = classify_key(std::string_view(start, (size_t)(stop - start)));
+            p_ = stop + 1;
+            if (high && !uma::util::is_valid_utf8(std::string_view(start, (size_t)(stop - start))))
+                return fail(JsonParseStatus::BadString);
+            return true;
+        }
+        key = Key::Unknown;
+        return parse_string(nullptr);
+    }
+
+    // JSON number; stored only if the whole token parses.
+    bool parse_number(std::optional<double>* out) {
+        const char* start = p_;
+        if (p_ < end_ && *p_ == '-')
+            ++p_;
+        if (p_ >= end_ || *p_ < '0' || *p_ > '9')
+            return fail(JsonParseStatus::Syntax);
+        if (*p_ == '0') {
+            ++p_;
+        } else {
+            while (p_ < end_ && *p_ >= '0' && *p_ <= '9')
+                ++p_;
+        }
+        if (p_ < end_ && *p_ == '.') {
+            ++p_;
+            if (p_ >= end_ || *p_ < '0' || *p_ > '9')
+                return fail(JsonParseStatus::Syntax);
+            while (p_ < end_ && *p_ >= '0' && *p_ <= '9')
+                ++p_;
+        }
+        if (p_ < end_ && (*p_ == 'e' || *p_ == 'E')) {
+            ++p_;
+            if (p_ < end_ && (*p_ == '+' || *p_ == '-'))
+                ++p_;
+            if (p_ >= end_ || *p_ < '0' || *p_ > '9')
+                return fail(JsonParseStatus::Syntax);
+            while (p_ < end_ && *p_ >= '0' && *p_ <= '9')
+                ++p_;
+        }
+        if (out) {
+            // the payload is not NUL-terminated: strtod a stack copy (heap for long tokens,
+            // e.g. a literal with many digits, which is still valid JSON)
+            char buf[64];
+            const size_t n = (size_t)(p_ - start);
+            if (n < sizeof(buf)) {
+                std::memcpy(buf, start, n);
+                buf[n] = '\0';
+                *out = std::strtod(buf, nullptr);
+            } else {
+                *out = std::strtod(std::string(start, n).c_str(), nullptr);
+            }
+        }
+        return true;
+    }
+
+    bool parse_literal(const char* lit, size_t n) {
+        if ((size_t)(end_ - p_) < n || std::memcmp(p_, lit, n) != 0)
+            return fail(JsonParseStatus::Syntax);
+        p_ += n;
+        return true;
+    }
+
+    // Skip any value (validating it). Type mismatches on known keys land here too.
+    bool skip_value(int depth) {
+        skip_ws();
+        if (p_ >= end_)
+            return fail(JsonParseStatus::Syntax);
+        switch (*p_) {
+            case '"':
+                ++p_;
+                return parse_string(nullptr);
+            case '{':
+                return parse_object(/*top*/ false, depth + 1);
+            case '[':
+                return skip_array(depth + 1);
+            case 't':
+                return parse_literal("true", 4);
+            case 'f':
+                return parse_literal("false", 5);
+            case 'n':
+                return parse_literal("null", 4);
+            default:
+                return parse_number(nullptr);
+        }
+    }
+
+    bool skip_array(int depth) {
+        if (depth > kMaxDepth)
+            return fail(JsonParseStatus::Syntax);
+        ++p_; // '['
+        skip_ws();
+        if (p_ < end_ && *p_ == ']') {
+            ++p_;
+            return true;
+        }
+        for (;;) {
+            if (!skip_value(depth))
+                return false;
+            skip_ws();
+            if (p_ < end_ && *p_ == ',') {
+                ++p_;
+                continue;
+            }
+            return consume(']');
+        }
+    }
+
+    bool value_string(std::string& dst, int depth) {
+        skip_ws();
+        if (p_ < end_ && *p_ == '"') {
+            ++p_;
+            dst.clear();
+            return parse_string(&dst);
+        }
+        return skip_value(depth);
+    }
+
+    bool value_number(std::optional<double>& dst, int depth) {
+        skip_ws();
+        if (p_ < end_ && (*p_ == '-' || (*p_ >= '0' && *p_ <= '9')))
+            return parse_number(&dst);
+        return skip_value(depth);
+    }
+
+    bool value_bool(std::optional<bool>& dst, int depth) {
+        skip_ws();
+        if (p_ < end_ && *p_ == 't') {
+            dst = true;
+            return parse_literal("true", 4);
+        }
+        if (p_ < end_ && *p_ == 'f') {
+            dst = false;
+            return parse_literal("false", 5);
+        }
+        return skip_value(depth);
+    }
+
+    // One element of a prompt_tokens array. Plain integers take a strtod-free fast path;
+    // anything else that is valid JSON is recorded as -1.
+    bool token_element(int depth) {
+        skip_ws();
+        const char* start = p_;
+        bool neg = false;
+        if (p_ < end_ && *p_ == '-') {
+            neg = true;
+            ++p_;
+        }
+        int64_t v = 0;
+        int digits = 0;
+        while (p_ < end_ && *p_ >= '0' && *p_ <= '9') {
+            if (digits < 12)
+                v = v * 10 + (*p_ - '0');
+            ++digits;
+            ++p_;
+        }
+        const bool more = p_ < end_ && (*p_ == '.' || *p_ == 'e' || *p_ == 'E');
+        if (digits > 0 && !more) {
+            if (digits > 1 && *(start + neg) == '0')
+                return fail(JsonParseStatus::Syntax); // leading zero
+            if (neg)
+                v = -v;
+            out_.prompt_tokens.push_back((digits <= 10 && v >= INT32_MIN && v <= INT32_MAX) ? (int32_t)v
+                                                                                             : -1);
+            return true;
+        }
+        p_ = start;
+        if (!skip_value(depth))
+            return false;
+        out_.prompt_tokens.push_back(-1);
+        return true;
+    }
+
+    bool value_tokens(int depth) {
+        skip_ws();
+        if (p_ < end_ && *p_ == '"') {
+            ++p_;
+            out_.prompt_tokens_b64.clear();
+            if (!parse_string(&out_.prompt_tokens_b64))
+                return false;
+            out_.has_prompt_tokens = true;
+            out_.prompt_tokens.clear();
+            if (!decode_token_blob(out_.prompt_tokens_b64, out_.prompt_tokens)) {
+                out_.prompt_tokens.clear();
+                out_.prompt_tokens.push_back(-1);
+            }
+            return true;
+        }
+        if (p_ >= end_ || *p_ != '[')
+            return skip_value(depth);
+        ++p_;
+        out_.has_prompt_tokens = true;
+        out_.prompt_tokens.clear();
+        skip_ws();
+        if (p_ < end_ && *p_ == ']') {
+            ++p_;
+            return true;
+        }
+        for (;;) {
+            if (!token_element(depth + 1))
+                return false;
+            skip_ws();
+            if (p_ < end_ && *p_ == ',') {
+                ++p_;
+                continue;
+            }
+            return consume(']');
+        }
+    }
+
+    // Nested "slo" object: read its targets and priority, skip everything else.
+    bool value_slo(int depth) {
+        skip_ws();
+        if (p_ >= end_ || *p_ != '{')
+            return skip_value(depth);
+        ++p_;
+        skip_ws();
+        if (p_ < end_ && *p_ == '}') {
+            ++p_;
+            return true;
+        }
+        for (;;) {
+            if (!consume('"'))
+                return false;
+            bool high = false;
+            const char* start = p_;
+            const char* stop = scan_string_run(p_, end_, high);
+            std::string_view k;
+            if (stop < end_ && *stop == '"') {
+                k = std::string_view(start, (size_t)(stop - start));
+                p_ = stop + 1;
+                if (high && !uma::util::is_valid_utf8(k))
+                    return fail(JsonParseStatus::BadString);
+            } else if (!parse_string(nullptr)) {
+                return false;
+            }
+            if (!consume(':'))
+                return false;
+            bool ok;
+            if (k == "target_ttft_ms")
+                ok = value_number(out_.slo_ttft_ms, depth + 1);
+            else if (k == "target_tbt_ms")
+                ok = value_number(out_.slo_tbt_ms, depth + 1);
+            else if (k == "priority")
+                ok = value_number(out_.slo_priority, depth + 1);
+            else
+                ok = skip_value(depth + 1);
+            if (!ok)
+                return false;
+            skip_ws();
+            if (p_ < end_ && *p_ == ',') {
+                ++p_;
+                continue;
+            }
+            return consume('}');
+        }
+    }
+
+    bool parse_field(Key key, int depth) {
+        switch (key) {
+            case Key::Type:
+                return value_string(out_.type, depth);
+            case Key::Event:
+                return value_string(out_.event, depth);
+            case Key::Id:
+                return value_string(out_.id, depth);
+            case Key::Prompt:
+                return value_string(out_.prompt, depth);
+            case Key::StreamFormat:
+                return value_string(out_.stream_format, depth);
+            case Key::Transport:
+                return value_string(out_.transport, depth);
+            case Key::Text:
+                return value_bool(out_.text, depth);
+            case Key::ShmBytes:
+                return value_number(out_.shm_bytes, depth);
+            case Key::Stream:
+                return value_bool(out_.stream, depth);
+            case Key::Temperature:
+                return value_number(out_.temperature, depth);
+            case Key::TopP:
+                return value_number(out_.top_p, depth);
+            case Key::TopK:
+                return value_number(out_.top_k, depth);
+            case Key::FlushMs:
+                return value_number(out_.flush_ms, depth);
+            case Key::MinTokensPerFrame:
+                return value_number(out_.min_tokens_per_frame, depth);
+            case Key::Slo:
+                return value_slo(depth);
+            case Key::PromptTokens:
+                return value_tokens(depth);
+            case Key::ReturnPromptTokens:
+                return value_bool(out_.return_prompt_tokens, depth);
+            case Key::Class:
+                return value_string(out_.request_class, depth);
+            case Key::Unknown:
+                break;
+        }
+        return skip_value(depth);
+    }
+
+    // p_ is at '{'. Fields are only recorded for the top-level object.
+    bool parse_object(bool top, int depth) {
+        if (depth > kMaxDepth)
+            return fail(JsonParseStatus::Syntax);
+        if (!consume('{'))
+            return false;
+        skip_ws();
+        if (p_ < end_ && *p_ == '}') {
+            ++p_;
+            return true;
+        }
+        for (;;) {
+            Key key = Key::Unknown;
+            if (!parse_key(key) || !consume(':'))
+                return false;
+            if (!(top ? parse_field(key, depth) : skip_value(depth)))
+                return false;
+            skip_ws();
+            if (p_ < end_ && *p_ == ',') {
+                ++p_;
+                continue;
+            }
+            return consume('}');
+        }
+    }
+
+    const char* p_;
+    const char* end_;
+    JsonRequest& out_;
+    JsonParseStatus status_ = JsonParseStatus::Syntax;
+};
+
+} // namespace
+
+JsonParseStatus parse_json_request(std::string_view js, JsonRequest& out) {
+    out.clear();
+    return Parser(js, out).run();
+}
+
+} // namespace uma::ipc
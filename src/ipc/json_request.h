@@ -0,0 +1,65 @@
+// UMA Serve - Single-pass JSON request parser (client -> server frames)
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace uma::ipc {
+
+// Typed view of one client frame: requests, hello and admin commands share it. Only
+// top-level keys are recognized, except "slo", whose targets and priority are read from
+// the nested object. Unknown keys (and values of the wrong type) are validated and skipped.
+//
+// String members are decoded (escapes resolved, \uXXXX turned into UTF-8) and reused
+// between calls, so a long-lived JsonRequest makes parsing allocation-free once its
+// buffers have grown to the working size.
+struct JsonRequest {
+    std::string type;  // "metrics", "hello", ...
+    std::string event; // legacy admin spelling ({"event":"metrics"})
+    std::string id;
+    std::string prompt;
+
+    // Pre-tokenized prompt: a JSON integer array, or a base64 string of packed little-endian
+    // int32 ids. Elements that are not int32 integers (and undecodable blobs) are stored as
+    // -1 so the caller's vocab range check rejects them.
+    bool has_prompt_tokens = false;
+    std::vector<int32_t> prompt_tokens;
+    std::string prompt_tokens_b64; // scratch for the base64 form
+    std::optional<bool> return_prompt_tokens;
+
+    // hello
+    std::string stream_format;
+    std::string transport;
+    std::optional<bool> text;
+    std::optional<double> shm_bytes;
+
+    // request options
+    std::optional<bool> stream;
+    std::optional<double> temperature;
+    std::optional<double> top_p;
+    std::optional<double> top_k;
+    std::optional<double> flush_ms;
+    std::optional<double> min_tokens_per_frame;
+    std::optional<double> slo_ttft_ms;
+    std::optional<double> slo_tbt_ms;
+    std::optional<double> slo_priority;
+    std::string request_class; // "class": "interactive" | "background" (empty = default)
+
+    // Reset every field but keep string capacity.
+    void clear();
+};
+
+enum class JsonParseStatus {
+    Ok,
+    BadString, // invalid escape, raw control character or invalid UTF-8 inside a string
+    Syntax,    // anything else that is not a single well-formed JSON object
+};
+
+// Parse one frame payload in a single left-to-right pass. On failure `out` keeps the
+// fields decoded before the error (typically `id`, so the error can be attributed).
+JsonParseStatus parse_json_request(std::string_view js, JsonRequest& out);
+
+} // namespace uma::ipc
@@ -0,0 +1,53 @@
+// UMA Serve - Vocabulary piece table (raw + pre-escaped JSON text per token id)
+#include "ipc/piece_table.h"
+
+#include "ipc/protocol.h"
+#include "util/utf8.h"
+
+#include <string>
+
+namespace uma::ipc {
+
+void PieceTable::build(int32_t n_vocab, const PieceFn& piece_fn) {
+    entries_.assign(n_vocab > 0 ? (size_t)n_vocab : 0, Entry{});
+    arena_.clear();
+
+    // Pass 1: collect raw pieces (most fit the stack buffer; long ones get a retry).
+    std::vector<char> raw;
+    std::vector<uint32_t> raw_off(entries_.size() + 1, 0);
+    raw.reserve(entries_.size() * 8);
+    char tmp[256];
+    std::string big;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        raw_off[i] = (uint32_t)raw.size();
+        int n = piece_fn((int32_t)i, tmp, sizeof(tmp));
+        const char* src = tmp;
+        if (n < 0) {
+            big.resize((size_t)-n);
+            n = piece_fn((int32_t)i, &big[0], big.size());
+            src = big.data();
+        }
+        if (n > 0)
+            raw.insert(raw.end(), src, src + n);
+    }
+    raw_off[entries_.size()] = (uint32_t)raw.size();
+
+    // Pass 2: lay out [raw][escaped] pairs. Escaping rarely grows a piece, so reserve
+    // a little over twice the raw size and let the rare control-character pieces grow it.
+    arena_.reserve(raw.size() * 2 + raw.size() / 8 + 16);
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        std::string_view r(raw.data() + raw_off[i], raw_off[i + 1] - raw_off[i]);
+        Entry& e = entries_[i];
+        e.off = (uint32_t)arena_.size();
+        e.raw_len = (uint32_t)r.size();
+        e.whole = uma::util::is_valid_utf8(r);
+        arena_.insert(arena_.end(), r.begin(), r.end());
+        const size_t at = arena_.size();
+        arena_.resize(at + protocol::json_escape_bound(r.size()));
+        e.json_len = (uint32_t)protocol::json_escape_to(arena_.data() + at, r);
+        arena_.resize(at + e.json_len);
+    }
+    arena_.shrink_to_fit();
+}
+
+} // namespace uma::ipc
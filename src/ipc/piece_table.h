@@ -0,0 +1,65 @@
+// UMA Serve - Vocabulary piece table (raw + pre-escaped JSON text per token id)
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+namespace uma::ipc {
+
+// Detokenized text of every vocabulary entry, built once at startup so emitting a token
+// is a lookup plus memcpy instead of a llama_token_to_piece call and a JSON escape.
+//
+// Both forms of every piece live back to back in one contiguous arena:
+//   [raw piece][escaped piece][raw piece][escaped piece]...
+// Binary streams take the raw form; JSON token events take the escaped form verbatim.
+// Escaping is byte-wise and leaves bytes >= 0x80 alone, so the escaped pieces of
+// consecutive tokens concatenate to the escape of the concatenated text even when a
+// UTF-8 character is split across tokens.
+class PieceTable {
+  public:
+    // Writes the piece of `id` into buf (cap bytes) and returns its length; a negative
+    // return means the piece needs -n bytes (llama_token_to_piece convention).
+    using PieceFn = std::function<int(int32_t id, char* buf, size_t cap)>;
+
+    // Rebuild for ids [0, n_vocab).
+    void build(int32_t n_vocab, const PieceFn& piece_fn);
+
+    // Empty for ids outside the table and for tokens without text.
+    std::string_view piece(int32_t id) const {
+        if (!contains(id))
+            return {};
+        const Entry& e = entries_[(size_t)id];
+        return {arena_.data() + e.off, e.raw_len};
+    }
+    std::string_view json(int32_t id) const {
+        if (!contains(id))
+            return {};
+        const Entry& e = entries_[(size_t)id];
+        return {arena_.data() + e.off + e.raw_len, e.json_len};
+    }
+
+    // True when the piece is well-formed UTF-8 on its own. Byte-fallback tokens (pieces
+    // holding part of a multi-byte character) are not, and go through StreamDetokenizer.
+    bool whole(int32_t id) const { return contains(id) && entries_[(size_t)id].whole; }
+
+    int32_t size() const { return (int32_t)entries_.size(); }
+    size_t arena_bytes() const { return arena_.size(); }
+
+  private:
+    struct Entry {
+        uint32_t off = 0;      // raw piece at arena_[off], escaped piece right after it
+        uint32_t raw_len = 0;
+        uint32_t json_len = 0;
+        bool whole = true;
+    };
+
+    bool contains(int32_t id) const { return id >= 0 && (size_t)id < entries_.size(); }
+
+    std::vector<Entry> entries_;
+    std::vector<char> arena_;
+};
+
+} // namespace uma::ipc
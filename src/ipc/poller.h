@@ -11,14 +11,18 @@ enum class PollFlags : uint16_t {
     Read = 1u << 0,
     Write = 1u << 1,
     Hup = 1u << 2,
-    Err = 1u << 3
+    Err = 1u << 3,
+    // registration-only: request edge-triggered delivery (EPOLLET / EV_CLEAR) for the
+    // directions in the same add() call; other directions stay level-triggered. Callers must
+    // drain the fd until EAGAIN on every notification.
+    Edge = 1u << 4
 };
 
 // helpers for managing PollFlags
-inline PollFlags operator|(PollFlags a, PollFlags b) noexcept {
+constexpr PollFlags operator|(PollFlags a, PollFlags b) noexcept {
     return static_cast<PollFlags>(static_cast<uint16_t>(a) | static_cast<uint16_t>(b));
 }
-inline PollFlags operator&(PollFlags a, PollFlags b) noexcept {
+constexpr PollFlags operator&(PollFlags a, PollFlags b) noexcept {
     return static_cast<PollFlags>(static_cast<uint16_t>(a) & static_cast<uint16_t>(b));
 }
 inline PollFlags& operator|=(PollFlags& a, PollFlags b) noexcept {
@@ -54,9 +58,13 @@ struct PollEvent {
     }
 };
 
+// Readiness poller. Backends: kqueue (macOS/BSD, poller_kqueue.cpp) and epoll (Linux,
+// poller_epoll.cpp); the build selects exactly one.
 class Poller {
   private:
     int handle_ = -1;
+    int wake_fd_ = -1;               // epoll: eventfd doorbell (kqueue uses EVFILT_USER)
+    std::vector<uint16_t> interest_; // epoll: directions + their Edge bits per fd (fd-indexed)
 
   public:
     Poller();
@@ -66,11 +74,16 @@ class Poller {
     Poller(const Poller&) = delete;
     Poller& operator=(const Poller&) = delete;
 
+    // Register interest; re-adding an already registered direction re-arms it.
     bool add(int fd, PollFlags interest);
     bool remove(int fd, PollFlags interest);
 
-    // blocks up to timeout_ms and fill out events_out with events arrived during this period
+    // blocks up to timeout_ms and fill out events_out with events arrived during this period.
+    // At most one event is reported per fd. Wakeups are consumed internally and not reported.
     int wait(int timeout_ms, std::vector<PollEvent>& events_out);
+
+    // Interrupt a concurrent or subsequent wait() (async-signal-safe on both backends).
+    bool wake();
 };
 
 } // namespace uma::ipc
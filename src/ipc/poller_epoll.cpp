@@ -0,0 +1,181 @@
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "ipc/poller.h"
+
+namespace uma::ipc {
+
+// Edge is requested per direction (as kqueue's EV_CLEAR is per filter), but epoll has one
+// EPOLLET per fd. The registration keeps which directions asked for it in these bits, and
+// the fd is edge-triggered only while every registered direction did: level-triggered
+// delivery is always safe for a caller that drains to EAGAIN, while an edge-triggered
+// EPOLLOUT that nobody asked for loses wakeups.
+static constexpr uint16_t kReadEdge = 1u << 8;
+static constexpr uint16_t kWriteEdge = 1u << 9;
+static constexpr uint16_t kDirections =
+        static_cast<uint16_t>(PollFlags::Read) | static_cast<uint16_t>(PollFlags::Write);
+
+static uint32_t to_epoll_mask(uint16_t reg) {
+    uint32_t m = 0;
+    const bool read = reg & static_cast<uint16_t>(PollFlags::Read);
+    const bool write = reg & static_cast<uint16_t>(PollFlags::Write);
+    // Peer half-close is news only to a reader. On a level-triggered Write-only fd (a client
+    // whose EOF was already seen, with output still queued) EPOLLRDHUP would fire on every
+    // wait until the peer reads.
+    if (read)
+        m |= EPOLLIN | EPOLLRDHUP;
+    if (write)
+        m |= EPOLLOUT;
+    if ((!read || (reg & kReadEdge)) && (!write || (reg & kWriteEdge)))
+        m |= EPOLLET;
+    return m;
+}
+
+Poller::Poller() {
+    handle_ = ::epoll_create1(EPOLL_CLOEXEC);
+    if (handle_ < 0) {
+        throw std::runtime_error("failed to create epoll");
+    }
+    wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        ::close(handle_);
+        throw std::runtime_error("failed to create eventfd");
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = wake_fd_;
+    if (::epoll_ctl(handle_, EPOLL_CTL_ADD, wake_fd_, &ev) == -1) {
+        ::close(wake_fd_);
+        ::close(handle_);
+        throw std::runtime_error("failed to register eventfd");
+    }
+}
+
+Poller::~Poller() {
+    if (wake_fd_ >= 0)
+        ::close(wake_fd_);
+    if (handle_ > 0)
+        ::close(handle_);
+}
+
+// epoll keeps a single registration per fd, so Read/Write interest is tracked here and
+// add/remove translate into ADD/MOD/DEL of the combined mask. Adding to a registered fd
+// always issues the MOD, even when the interest is unchanged: that re-arms an
+// edge-triggered fd, so a caller that still has data to send is told when it can.
+bool Poller::add(int fd, PollFlags interest) {
+    if (fd < 0)
+        return false;
+    if (!any(interest & (PollFlags::Read | PollFlags::Write)))
+        return true; // nothing to add
+    if ((size_t)fd >= interest_.size())
+        interest_.resize((size_t)fd + 1, 0);
+
+    const uint16_t prev = interest_[(size_t)fd];
+    uint16_t next = prev | (static_cast<uint16_t>(interest) & kDirections);
+    // each direction added takes this call's Edge choice, as a kqueue filter would
+    const bool edge = has(interest, PollFlags::Edge);
+    if (has(interest, PollFlags::Read))
+        next = edge ? (next | kReadEdge) : (next & ~kReadEdge);
+    if (has(interest, PollFlags::Write))
+        next = edge ? (next | kWriteEdge) : (next & ~kWriteEdge);
+
+    epoll_event ev{};
+    ev.events = to_epoll_mask(next);
+    ev.data.fd = fd;
+    int op = prev ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (::epoll_ctl(handle_, op, fd, &ev) == -1) {
+        if (op == EPOLL_CTL_MOD && errno == ENOENT) {
+            // fd was closed and reused behind our back; register afresh
+            if (::epoll_ctl(handle_, EPOLL_CTL_ADD, fd, &ev) == -1)
+                return false;
+        } else {
+            return false;
+        }
+    }
+    interest_[(size_t)fd] = next;
+    return true;
+}
+
+bool Poller::remove(int fd, PollFlags interest) {
+    if (fd < 0 || (size_t)fd >= interest_.size())
+        return true; // never registered
+    const uint16_t prev = interest_[(size_t)fd];
+    if (!prev)
+        return true;
+    // drop the requested directions with their Edge bits; the registration goes with the last
+    uint16_t next = prev;
+    if (has(interest, PollFlags::Read))
+        next &= ~(static_cast<uint16_t>(PollFlags::Read) | kReadEdge);
+    if (has(interest, PollFlags::Write))
+        next &= ~(static_cast<uint16_t>(PollFlags::Write) | kWriteEdge);
+    if (!(next & kDirections))
+        next = 0;
+    if (next == prev)
+        return true;
+
+    interest_[(size_t)fd] = next;
+    if (!next) {
+        if (::epoll_ctl(handle_, EPOLL_CTL_DEL, fd, nullptr) == -1) {
+            if (errno == ENOENT || errno == EBADF)
+                return true; // benign
+            return false;
+        }
+        return true;
+    }
+    epoll_event ev{};
+    ev.events = to_epoll_mask(next);
+    ev.data.fd = fd;
+    if (::epoll_ctl(handle_, EPOLL_CTL_MOD, fd, &ev) == -1) {
+        if (errno == ENOENT || errno == EBADF)
+            return true; // benign
+        return false;
+    }
+    return true;
+}
+
+int Poller::wait(int timeout_ms, std::vector<PollEvent>& events_out) {
+    events_out.clear();
+
+    epoll_event evs[64];
+    int nev = ::epoll_wait(handle_, evs, 64, timeout_ms);
+    if (nev <= 0)
+        return nev;
+
+    // epoll reports at most one entry per fd, so no coalescing pass is needed
+    events_out.reserve((size_t)nev);
+    for (int i = 0; i < nev; ++i) {
+        const int fd = evs[i].data.fd;
+        const uint32_t e = evs[i].events;
+        if (fd == wake_fd_) {
+            uint64_t v;
+            while (::read(wake_fd_, &v, sizeof(v)) > 0) {
+            }
+            continue;
+        }
+        PollFlags f = PollFlags::None;
+        if (e & EPOLLIN)
+            f |= PollFlags::Read;
+        if (e & EPOLLOUT)
+            f |= PollFlags::Write;
+        if (e & EPOLLERR)
+            f |= PollFlags::Err;
+        if (e & (EPOLLHUP | EPOLLRDHUP))
+            f |= PollFlags::Hup;
+        events_out.push_back({fd, f});
+    }
+    return (int)events_out.size();
+}
+
+bool Poller::wake() {
+    uint64_t one = 1;
+    ssize_t n = ::write(wake_fd_, &one, sizeof(one));
+    // EAGAIN means the counter is saturated, i.e. a wakeup is already pending
+    return n == (ssize_t)sizeof(one) || errno == EAGAIN;
+}
+
+} // namespace uma::ipc
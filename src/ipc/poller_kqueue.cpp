@@ -1,18 +1,27 @@
+#include <cerrno>
 #include <cstddef>
 #include <stdexcept>
 #include <sys/event.h>
 #include <unistd.h>
-#include <unordered_map>
 
 #include "ipc/poller.h"
 
 namespace uma::ipc {
 
+// ident of the EVFILT_USER doorbell used by wake()
+static constexpr uintptr_t kWakeIdent = 0;
+
 Poller::Poller() {
     handle_ = ::kqueue();
     if (handle_ < 0) {
         throw std::runtime_error("failed to create kqueue");
     }
+    struct kevent ev;
+    EV_SET(&ev, kWakeIdent, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+    if (::kevent(handle_, &ev, 1, nullptr, 0, nullptr) == -1) {
+        ::close(handle_);
+        throw std::runtime_error("failed to register kqueue wakeup");
+    }
 }
 
 Poller::~Poller() {
@@ -23,12 +32,13 @@ Poller::~Poller() {
 bool Poller::add(int fd, PollFlags interest) {
     struct kevent evs[2];
     int n = 0;
+    const uint16_t flags = has(interest, PollFlags::Edge) ? (EV_ADD | EV_CLEAR) : EV_ADD;
 
     if (has(interest, PollFlags::Read)) {
-        EV_SET(&evs[n++], fd, EVFILT_READ, EV_ADD, 0, 0, nullptr);
+        EV_SET(&evs[n++], fd, EVFILT_READ, flags, 0, 0, nullptr);
     }
     if (has(interest, PollFlags::Write)) {
-        EV_SET(&evs[n++], fd, EVFILT_WRITE, EV_ADD, 0, 0, nullptr);
+        EV_SET(&evs[n++], fd, EVFILT_WRITE, flags, 0, 0, nullptr);
     }
     if (n == 0)
         return true; // nothing to add
@@ -75,11 +85,12 @@ int Poller::wait(int timeout_ms, std::vector<PollEvent>& events_out) {
     if (nev <= 0)
         return nev;
 
-    // coalesce by fd
-    std::unordered_map<int, PollFlags> acc;
-    acc.reserve((size_t)nev);
-
+    // coalesce READ/WRITE filters of the same fd into one event; nev <= 64, so a linear
+    // scan over what has been emitted so far beats hashing
+    events_out.reserve((size_t)nev);
     for (int i = 0; i < nev; ++i) {
+        if (kev[i].filter == EVFILT_USER)
+            continue; // wakeup doorbell (EV_CLEAR resets it)
         int fd = (int)kev[i].ident;
         PollFlags f = PollFlags::None;
         if (kev[i].filter == EVFILT_READ)
@@ -90,13 +101,24 @@ int Poller::wait(int timeout_ms, std::vector<PollEvent>& events_out) {
             f |= PollFlags::Err;
         if (kev[i].flags & EV_EOF)
             f |= PollFlags::Hup;
-        acc[fd] = acc.count(fd) ? (acc[fd] | f) : f;
+        bool merged = false;
+        for (auto& e : events_out) {
+            if (e.fd == fd) {
+                e.f |= f;
+                merged = true;
+                break;
+            }
+        }
+        if (!merged)
+            events_out.push_back({fd, f});
     }
-
-    events_out.reserve(acc.size());
-    for (auto& kv : acc)
-        events_out.push_back({kv.first, kv.second});
     return (int)events_out.size();
 }
 
+bool Poller::wake() {
+    struct kevent ev;
+    EV_SET(&ev, kWakeIdent, EVFILT_USER, 0, NOTE_TRIGGER, 0, nullptr);
+    return ::kevent(handle_, &ev, 1, nullptr, 0, nullptr) != -1;
+}
+
 } // namespace uma::ipc
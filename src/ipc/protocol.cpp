@@ -1,6 +1,9 @@
 // UMA Serve - Framed JSON protocol helpers (UDS)
 #include "ipc/protocol.h"
 
+#include <charconv>
+#include <climits>
+#include <cstdint>
 #include <cstring>
 
 namespace uma::ipc::protocol {
@@ -9,8 +12,8 @@ static inline uint32_t read_u32_le(const uint8_t* p) {
     return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
 }
 
-bool try_read_frame(std::vector<uint8_t>& rx, std::string& out_json, size_t max_frame_bytes,
-                    std::string* err_msg) {
+bool peek_frame(const ByteBuffer& rx, std::string_view& out_json, size_t& frame_bytes,
+                size_t max_frame_bytes, std::string* err_msg) {
     if (rx.size() < 4) return false;
     uint32_t len = read_u32_le(rx.data());
     if (len == 0) {
@@ -22,65 +25,338 @@ bool try_read_frame(std::vector<uint8_t>& rx, std::string& out_json, size_t max_
         return false;
     }
     if (rx.size() < 4u + (size_t)len) return false;
-    out_json.assign(reinterpret_cast<const char*>(rx.data() + 4), len);
-    rx.erase(rx.begin(), rx.begin() + 4 + len);
+    out_json = rx.view(4, len);
+    frame_bytes = 4u + (size_t)len;
+    return true;
+}
+
+bool try_read_frame(ByteBuffer& rx, std::string& out_json, size_t max_frame_bytes,
+                    std::string* err_msg) {
+    std::string_view js;
+    size_t frame_bytes = 0;
+    if (!peek_frame(rx, js, frame_bytes, max_frame_bytes, err_msg)) return false;
+    out_json.assign(js.data(), js.size());
+    rx.consume(frame_bytes);
     return true;
 }
 
+static inline void put_u32_le(uint8_t* hdr, uint32_t len) {
+    hdr[0] = (uint8_t)(len & 0xFF);
+    hdr[1] = (uint8_t)((len >> 8) & 0xFF);
+    hdr[2] = (uint8_t)((len >> 16) & 0xFF);
+    hdr[3] = (uint8_t)((len >> 24) & 0xFF);
+}
+
+void write_frame(ByteBuffer& tx, std::string_view json) {
+    // one reservation for header + payload
+    uint8_t* p = tx.prepare(4 + json.size());
+    put_u32_le(p, (uint32_t)json.size());
+    std::memcpy(p + 4, json.data(), json.size());
+    tx.commit(4 + json.size());
+}
+
+void write_frame(TxQueue& tx, std::string_view json) {
+    uint8_t* p = tx.prepare(4 + json.size());
+    put_u32_le(p, (uint32_t)json.size());
+    std::memcpy(p + 4, json.data(), json.size());
+    tx.commit(4 + json.size());
+}
+
 void write_frame(std::vector<uint8_t>& tx, const std::string& json) {
-    uint32_t len = (uint32_t)json.size();
-    uint8_t hdr[4] = { (uint8_t)(len & 0xFF), (uint8_t)((len >> 8) & 0xFF),
-                       (uint8_t)((len >> 16) & 0xFF), (uint8_t)((len >> 24) & 0xFF) };
+    uint8_t hdr[4];
+    put_u32_le(hdr, (uint32_t)json.size());
     tx.insert(tx.end(), hdr, hdr + 4);
     tx.insert(tx.end(), json.begin(), json.end());
 }
 
-std::string json_escape(const std::string& s) {
-    std::string out;
-    out.reserve(s.size() + 8);
+size_t json_escape_to(char* out, std::string_view s) {
+    static const char kHex[] = "0123456789abcdef";
+    char* o = out;
     for (unsigned char c : s) {
         switch (c) {
-            case '"': out += "\\\""; break;
-            case '\\': out += "\\\\"; break;
-            case '\n': out += "\\n"; break;
-            case '\r': out += "\\r"; break;
-            case '\t': out += "\\t"; break;
+            case '"': *o++ = '\\'; *o++ = '"'; break;
+            case '\\': *o++ = '\\'; *o++ = '\\'; break;
+            case '\n': *o++ = '\\'; *o++ = 'n'; break;
+            case '\r': *o++ = '\\'; *o++ = 'r'; break;
+            case '\t': *o++ = '\\'; *o++ = 't'; break;
             default:
                 if (c < 0x20) {
-                    char buf[7];
-                    std::snprintf(buf, sizeof(buf), "\\u%04x", (unsigned)c);
-                    out += buf;
+                    std::memcpy(o, "\\u00", 4);
+                    o[4] = kHex[c >> 4];
+                    o[5] = kHex[c & 0xF];
+                    o += 6;
                 } else {
-                    out.push_back((char)c);
+                    *o++ = (char)c;
                 }
         }
     }
+    return (size_t)(o - out);
+}
+
+std::string json_escape(const std::string& s) {
+    std::string out;
+    out.resize(json_escape_bound(s.size()));
+    out.resize(json_escape_to(&out[0], s));
     return out;
 }
 
-void append_token_event(std::vector<uint8_t>& tx, const std::string& id, const std::string& text,
+std::string render_token_prefix(const std::string& id) {
+    return "{\"id\":\"" + json_escape(id) + "\",\"event\":\"token\",\"text\":\"";
+}
+
+namespace {
+
+template <bool kEscape>
+void append_token_event_impl(TxQueue& tx, const std::string& prefix, std::string_view text,
+                             int token_id) {
+    static constexpr char kMid[] = "\",\"token_id\":";
+    // header placeholder (patched below), then the shared prefix, then the per-token tail
+    const size_t hdr_off = tx.owned_size();
+    const uint8_t zero[4] = {0, 0, 0, 0};
+    tx.append(zero, 4);
+    tx.append_shared(prefix.data(), prefix.size());
+
+    const size_t cap = (kEscape ? json_escape_bound(text.size()) : text.size()) + sizeof(kMid) + 16;
+    char* p = reinterpret_cast<char*>(tx.prepare(cap));
+    char* o = p;
+    if (kEscape) {
+        o += json_escape_to(p, text);
+    } else if (!text.empty()) {
+        std::memcpy(o, text.data(), text.size());
+        o += text.size();
+    }
+    std::memcpy(o, kMid, sizeof(kMid) - 1);
+    o += sizeof(kMid) - 1;
+    o = std::to_chars(o, p + cap, token_id).ptr;
+    *o++ = '}';
+    const size_t tail = (size_t)(o - p);
+    tx.commit(tail);
+    put_u32_le(tx.owned_at(hdr_off), (uint32_t)(prefix.size() + tail));
+}
+
+template <bool kEscape>
+void append_tokens_event_impl(TxQueue& tx, const std::string& id, const int32_t* ids,
+                              const uint32_t* lens, size_t n, std::string_view text) {
+    static constexpr char kHead[] = "{\"id\":\"";
+    static constexpr char kMid[] = "\",\"event\":\"tokens\",\"text\":[";
+    static constexpr char kIds[] = "],\"token_ids\":[";
+    const size_t cap = 4 + sizeof(kHead) + json_escape_bound(id.size()) + sizeof(kMid) +
+                       (kEscape ? json_escape_bound(text.size()) : text.size()) + 3 * n +
+                       sizeof(kIds) + 12 * n + 2;
+    uint8_t* base = tx.prepare(cap);
+    char* p = reinterpret_cast<char*>(base) + 4;
+    char* const end = reinterpret_cast<char*>(base) + cap;
+    std::memcpy(p, kHead, sizeof(kHead) - 1);
+    p += sizeof(kHead) - 1;
+    p += json_escape_to(p, id);
+    std::memcpy(p, kMid, sizeof(kMid) - 1);
+    p += sizeof(kMid) - 1;
+    size_t off = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (i) *p++ = ',';
+        *p++ = '"';
+        if (kEscape) {
+            p += json_escape_to(p, text.substr(off, lens[i]));
+        } else {
+            std::memcpy(p, text.data() + off, lens[i]);
+            p += lens[i];
+        }
+        off += lens[i];
+        *p++ = '"';
+    }
+    std::memcpy(p, kIds, sizeof(kIds) - 1);
+    p += sizeof(kIds) - 1;
+    for (size_t i = 0; i < n; ++i) {
+        if (i) *p++ = ',';
+        p = std::to_chars(p, end, ids[i]).ptr;
+    }
+    *p++ = ']';
+    *p++ = '}';
+    const size_t total = (size_t)(reinterpret_cast<uint8_t*>(p) - base);
+    put_u32_le(base, (uint32_t)(total - 4));
+    tx.commit(total);
+}
+
+} // namespace
+
+void append_token_event(TxQueue& tx, const std::string& prefix, std::string_view text,
                         int token_id) {
-    std::string payload;
-    payload.reserve(64 + text.size());
-    payload += "{\"id\":\"" + json_escape(id) + "\",";
-    payload += "\"event\":\"token\",";
-    payload += "\"text\":\"" + json_escape(text) + "\",";
-    payload += "\"token_id\":" + std::to_string(token_id) + "}";
-    write_frame(tx, payload);
+    append_token_event_impl<true>(tx, prefix, text, token_id);
+}
+
+void append_token_event_escaped(TxQueue& tx, const std::string& prefix,
+                                std::string_view escaped, int token_id) {
+    append_token_event_impl<false>(tx, prefix, escaped, token_id);
+}
+
+void append_tokens_event(TxQueue& tx, const std::string& id, const int32_t* ids,
+                         const uint32_t* lens, size_t n, std::string_view text) {
+    append_tokens_event_impl<true>(tx, id, ids, lens, n, text);
+}
+
+void append_tokens_event_escaped(TxQueue& tx, const std::string& id, const int32_t* ids,
+                                 const uint32_t* lens, size_t n, std::string_view escaped) {
+    append_tokens_event_impl<false>(tx, id, ids, lens, n, escaped);
 }
 
-void append_eos_event(std::vector<uint8_t>& tx, const std::string& id, const std::string& reason) {
+void append_eos_event(TxQueue& tx, const std::string& id, const std::string& reason) {
     std::string payload = "{\"id\":\"" + json_escape(id) +
                           "\",\"event\":\"eos\",\"reason\":\"" + json_escape(reason) + "\"}";
     write_frame(tx, payload);
 }
 
-void append_error_event(std::vector<uint8_t>& tx, const std::string& id, const std::string& code,
+void append_error_event(TxQueue& tx, const std::string& id, const std::string& code,
                         const std::string& message) {
     std::string payload = "{\"id\":\"" + json_escape(id) + "\",\"event\":\"error\",";
     payload += "\"code\":\"" + json_escape(code) + "\",\"message\":\"" + json_escape(message) + "\"}";
     write_frame(tx, payload);
 }
 
+void append_overloaded_event(TxQueue& tx, const std::string& id, const std::string& message,
+                             uint32_t retry_after_ms) {
+    std::string payload = "{\"id\":\"" + json_escape(id) + "\",\"event\":\"error\",";
+    payload += "\"code\":\"E_OVERLOADED\",\"message\":\"" + json_escape(message) + "\",";
+    payload += "\"retry_after_ms\":" + std::to_string(retry_after_ms) + "}";
+    write_frame(tx, payload);
+}
+
+void append_prompt_tokens_event(TxQueue& tx, const std::string& id, const int* ids, size_t n) {
+    std::string payload;
+    payload.reserve(48 + id.size() + n * 7);
+    payload += "{\"id\":\"";
+    payload += json_escape(id);
+    payload += "\",\"event\":\"prompt_tokens\",\"token_ids\":[";
+    for (size_t i = 0; i < n; ++i) {
+        if (i)
+            payload.push_back(',');
+        payload += std::to_string(ids[i]);
+    }
+    payload += "]}";
+    write_frame(tx, payload);
+}
+
+void append_start_event(TxQueue& tx, const std::string& id, uint32_t handle) {
+    std::string payload = "{\"id\":\"" + json_escape(id) +
+                          "\",\"event\":\"start\",\"handle\":" + std::to_string(handle) + "}";
+    write_frame(tx, payload);
+}
+
+std::string render_hello_event(bool binary, bool with_text, size_t shm_bytes) {
+    std::string payload = std::string("{\"event\":\"hello\",\"version\":1,\"stream_format\":\"") +
+                          (binary ? "binary" : "json") + "\",\"text\":" +
+                          (with_text ? "true" : "false");
+    if (shm_bytes > 0)
+        payload += ",\"transport\":\"shm\",\"shm_bytes\":" + std::to_string(shm_bytes);
+    else
+        payload += ",\"transport\":\"socket\"";
+    payload += "}";
+    return payload;
+}
+
+void append_hello_event(TxQueue& tx, bool binary, bool with_text) {
+    write_frame(tx, render_hello_event(binary, with_text, 0));
+}
+
+size_t put_varint(uint8_t* out, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+bool get_varint(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+    v = 0;
+    for (unsigned shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t b = *p++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if ((b & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+void append_token_event_bin(TxQueue& tx, uint32_t handle, int token_id, std::string_view text) {
+    const size_t cap = 4 + 1 + 2 * kMaxVarintBytes + text.size();
+    uint8_t* base = tx.prepare(cap);
+    uint8_t* o = base + 4;
+    *o++ = kBinTagToken;
+    o += put_varint(o, handle);
+    o += put_varint(o, (uint32_t)token_id);
+    if (!text.empty()) {
+        std::memcpy(o, text.data(), text.size());
+        o += text.size();
+    }
+    const size_t total = (size_t)(o - base);
+    put_u32_le(base, (uint32_t)(total - 4));
+    tx.commit(total);
+}
+
+void append_tokens_event_bin(TxQueue& tx, uint32_t handle, const int32_t* ids,
+                             const uint32_t* lens, size_t n, std::string_view text) {
+    const size_t cap = 4 + 1 + 2 * kMaxVarintBytes + n * 2 * kMaxVarintBytes + text.size();
+    uint8_t* base = tx.prepare(cap);
+    uint8_t* o = base + 4;
+    *o++ = kBinTagTokens;
+    o += put_varint(o, handle);
+    o += put_varint(o, n);
+    size_t off = 0;
+    for (size_t i = 0; i < n; ++i) {
+        o += put_varint(o, (uint32_t)ids[i]);
+        o += put_varint(o, lens[i]);
+        if (lens[i]) {
+            std::memcpy(o, text.data() + off, lens[i]);
+            o += lens[i];
+            off += lens[i];
+        }
+    }
+    const size_t total = (size_t)(o - base);
+    put_u32_le(base, (uint32_t)(total - 4));
+    tx.commit(total);
+}
+
+bool parse_token_event_bin(std::string_view payload, BinTokenEvent& out) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(payload.data());
+    const uint8_t* end = p + payload.size();
+    if (p == end || *p++ != kBinTagToken) return false;
+    uint64_t h = 0, t = 0;
+    if (!get_varint(p, end, h) || !get_varint(p, end, t)) return false;
+    if (h > UINT32_MAX || t > INT32_MAX) return false;
+    out.handle = (uint32_t)h;
+    out.token_id = (int32_t)t;
+    out.text = std::string_view(reinterpret_cast<const char*>(p), (size_t)(end - p));
+    return true;
+}
+
+bool parse_token_events_bin(std::string_view payload, std::vector<BinTokenEvent>& out) {
+    out.clear();
+    if (payload.empty()) return false;
+    if ((uint8_t)payload[0] == kBinTagToken) {
+        BinTokenEvent ev;
+        if (!parse_token_event_bin(payload, ev)) return false;
+        out.push_back(ev);
+        return true;
+    }
+    if ((uint8_t)payload[0] != kBinTagTokens) return false;
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(payload.data()) + 1;
+    const uint8_t* end = reinterpret_cast<const uint8_t*>(payload.data()) + payload.size();
+    uint64_t h = 0, n = 0;
+    if (!get_varint(p, end, h) || !get_varint(p, end, n)) return false;
+    if (h > UINT32_MAX || n > payload.size()) return false;
+    for (uint64_t i = 0; i < n; ++i) {
+        uint64_t t = 0, len = 0;
+        if (!get_varint(p, end, t) || !get_varint(p, end, len)) return false;
+        if (t > INT32_MAX || len > (uint64_t)(end - p)) return false;
+        BinTokenEvent ev;
+        ev.handle = (uint32_t)h;
+        ev.token_id = (int32_t)t;
+        ev.text = std::string_view(reinterpret_cast<const char*>(p), (size_t)len);
+        p += len;
+        out.push_back(ev);
+    }
+    return p == end;
+}
+
 } // namespace uma::ipc::protocol
 
@@ -1,9 +1,13 @@
 // UMA Serve - Framed JSON protocol helpers (UDS)
 #pragma once
 
+#include "ipc/byte_buffer.h"
+#include "ipc/tx_queue.h"
+
 #include <cstddef>
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace uma::ipc::protocol {
@@ -11,25 +15,102 @@ namespace uma::ipc::protocol {
 // Maximum allowed JSON frame payload size (bytes). Config may override.
 constexpr size_t kDefaultMaxFrameBytes = 1 * 1024 * 1024; // 1 MiB
 
+// Zero-copy variant: when a full frame is at the front of rx, points out_json at its
+// payload (inside rx) and sets frame_bytes to header + payload length; the caller
+// consumes it with rx.consume(frame_bytes). Errors as in try_read_frame.
+bool peek_frame(const ByteBuffer& rx, std::string_view& out_json, size_t& frame_bytes,
+                size_t max_frame_bytes, std::string* err_msg);
+
 // Attempt to parse one complete frame from rx buffer.
 // Returns true and assigns out_json when a full frame is available and removed from rx.
 // Returns false if more bytes are needed.
 // If an oversize frame is detected, sets err_msg and returns false; caller should close.
-bool try_read_frame(std::vector<uint8_t>& rx, std::string& out_json, size_t max_frame_bytes,
+bool try_read_frame(ByteBuffer& rx, std::string& out_json, size_t max_frame_bytes,
                     std::string* err_msg);
 
 // Append a length-prefixed JSON frame to tx buffer.
+void write_frame(ByteBuffer& tx, std::string_view json);
+void write_frame(TxQueue& tx, std::string_view json);
 void write_frame(std::vector<uint8_t>& tx, const std::string& json);
 
 // Minimal JSON escape for strings (UTF-8 safe; escapes quotes, backslash, control chars)
 std::string json_escape(const std::string& s);
 
-// Helpers to build common event frames and append to tx
-void append_token_event(std::vector<uint8_t>& tx, const std::string& id, const std::string& text,
+// Worst-case escaped size of n input bytes (every byte as \u00XX).
+constexpr size_t json_escape_bound(size_t n) { return n * 6; }
+
+// Escape s into out (at least json_escape_bound(s.size()) bytes); returns bytes written.
+size_t json_escape_to(char* out, std::string_view s);
+
+// Render the constant head of a request's token events, up to and including the opening
+// quote of "text": {"id":"<escaped id>","event":"token","text":"
+std::string render_token_prefix(const std::string& id);
+
+// Helpers to build common event frames and append to tx.
+// Token events are queued as [header][shared prefix][escaped text + token_id]; `prefix`
+// comes from render_token_prefix() and is referenced, not copied (see TxQueue).
+void append_token_event(TxQueue& tx, const std::string& prefix, std::string_view text,
                         int token_id);
-void append_eos_event(std::vector<uint8_t>& tx, const std::string& id, const std::string& reason);
-void append_error_event(std::vector<uint8_t>& tx, const std::string& id, const std::string& code,
+// Coalesced token event: {"id":"...","event":"tokens","text":["a","b"],"token_ids":[1,2]}.
+// `text` is the concatenation of the n pieces; lens[i] is the byte length of piece i.
+void append_tokens_event(TxQueue& tx, const std::string& id, const int32_t* ids,
+                         const uint32_t* lens, size_t n, std::string_view text);
+// As above, for text that is already JSON-escaped (PieceTable::json); copied verbatim.
+// For the coalesced form, lens[i] is the escaped length of piece i.
+void append_token_event_escaped(TxQueue& tx, const std::string& prefix,
+                                std::string_view escaped, int token_id);
+void append_tokens_event_escaped(TxQueue& tx, const std::string& id, const int32_t* ids,
+                                 const uint32_t* lens, size_t n, std::string_view escaped);
+void append_eos_event(TxQueue& tx, const std::string& id, const std::string& reason);
+// {"id":..,"event":"prompt_tokens","token_ids":[..]} (return_prompt_tokens echo)
+void append_prompt_tokens_event(TxQueue& tx, const std::string& id, const int* ids, size_t n);
+void append_start_event(TxQueue& tx, const std::string& id, uint32_t handle);
+// Hello reply. shm_bytes > 0 reports the shared-memory ring transport (its fds travel with
+// the frame via SCM_RIGHTS); 0 means events stay on the socket.
+std::string render_hello_event(bool binary, bool with_text, size_t shm_bytes);
+void append_hello_event(TxQueue& tx, bool binary, bool with_text);
+void append_error_event(TxQueue& tx, const std::string& id, const std::string& code,
                         const std::string& message);
+// E_OVERLOADED error event with a "retry_after_ms" hint (load shedding).
+void append_overloaded_event(TxQueue& tx, const std::string& id, const std::string& message,
+                             uint32_t retry_after_ms);
+
+// ---- Binary token stream (negotiated per connection via a hello frame) ----
+//
+// Frames keep the uint32_le length prefix. JSON payloads always start with '{'; binary
+// payloads start with a tag byte below 0x20. Only token events are binary; start, eos,
+// error and metrics events stay JSON.
+//
+// Token event payload: u8 kBinTagToken | varint handle | varint token_id | raw UTF-8 text
+// (text runs to the end of the frame and is empty when the connection chose ids only).
+constexpr uint8_t kBinTagToken = 0x01;
+
+// Unsigned LEB128. put_varint needs up to kMaxVarintBytes of room.
+constexpr size_t kMaxVarintBytes = 10;
+size_t put_varint(uint8_t* out, uint64_t v);
+// Decode at p, advancing p; false on truncation/overflow.
+bool get_varint(const uint8_t*& p, const uint8_t* end, uint64_t& v);
+
+inline bool is_binary_payload(std::string_view payload) {
+    return !payload.empty() && static_cast<uint8_t>(payload[0]) < 0x20;
+}
+
+void append_token_event_bin(TxQueue& tx, uint32_t handle, int token_id, std::string_view text);
+
+// Coalesced token events: u8 kBinTagTokens | varint handle | varint n |
+// n x (varint token_id | varint text_len | text bytes). Arguments as append_tokens_event.
+constexpr uint8_t kBinTagTokens = 0x02;
+void append_tokens_event_bin(TxQueue& tx, uint32_t handle, const int32_t* ids,
+                             const uint32_t* lens, size_t n, std::string_view text);
+
+struct BinTokenEvent {
+    uint32_t handle = 0;
+    int32_t token_id = 0;
+    std::string_view text; // points into the parsed payload
+};
+bool parse_token_event_bin(std::string_view payload, BinTokenEvent& out);
+// Decode either binary token frame (tag 0x01 or 0x02) into one event per token.
+bool parse_token_events_bin(std::string_view payload, std::vector<BinTokenEvent>& out);
 
 } // namespace uma::ipc::protocol
 
@@ -0,0 +1,147 @@
+// UMA Serve - Session pool (slab of requests, linked into per-state lists)
+#include "ipc/session.h"
+
+#include <cassert>
+#include <utility>
+
+namespace uma::ipc {
+
+SessionList& SessionList::operator=(SessionList&& o) noexcept {
+    head_ = std::exchange(o.head_, nullptr);
+    tail_ = std::exchange(o.tail_, nullptr);
+    n_ = std::exchange(o.n_, 0);
+    return *this;
+}
+
+void SessionList::push_back(SessionHot& h) {
+    h.list_prev = tail_;
+    h.list_next = nullptr;
+    if (tail_)
+        tail_->list_next = &h;
+    else
+        head_ = &h;
+    tail_ = &h;
+    ++n_;
+}
+
+void SessionList::remove(SessionHot& h) {
+    if (h.list_prev)
+        h.list_prev->list_next = h.list_next;
+    else
+        head_ = h.list_next;
+    if (h.list_next)
+        h.list_next->list_prev = h.list_prev;
+    else
+        tail_ = h.list_prev;
+    h.list_prev = h.list_next = nullptr;
+    --n_;
+}
+
+int8_t SessionPool::list_for(SessionState st) {
+    switch (st) {
+    case SessionState::PREFILL:
+        return kPrefill;
+    case SessionState::DECODE:
+        return kDecode;
+    case SessionState::STREAM:
+    case SessionState::ERRORED:
+    case SessionState::DONE:
+        return kFinished;
+    default:
+        return -1;
+    }
+}
+
+void SessionPool::link(SessionHot& h) {
+    h.list_id = list_for(h.state);
+    if (h.list_id >= 0)
+        lists_[h.list_id].push_back(h);
+}
+
+void SessionPool::unlink(SessionHot& h) {
+    if (h.list_id >= 0)
+        lists_[h.list_id].remove(h);
+    h.list_id = -1;
+}
+
+ClientSession& SessionPool::create(Connection* conn) {
+    uint32_t slot;
+    if (!free_slots_.empty()) {
+        slot = free_slots_.back();
+        free_slots_.pop_back();
+    } else {
+        slot = n_slots_++;
+        assert(slot < (1u << kSlotBits) && "session slots exhausted");
+        if (slot / kChunk == chunks_.size())
+            chunks_.push_back(std::make_unique<Chunk>());
+    }
+    Chunk& ch = *chunks_[slot / kChunk];
+    SessionHot& h = ch.hot[slot % kChunk];
+    ClientSession& s = ch.cold[slot % kChunk];
+    h.sid = (int)(((uint32_t)h.gen << kSlotBits) | slot);
+    h.conn = conn;
+    h.cold = &s;
+    s.sid = h.sid;
+    s.conn = conn;
+    s.hot = &h;
+    ++live_;
+    return s;
+}
+
+void SessionPool::erase(ClientSession& s) {
+    SessionHot& h = *s.hot;
+    assert(h.sid == s.sid && "erasing a request twice");
+    unlink(h);
+    const uint16_t gen = (uint16_t)(h.gen == kGenMask ? 1 : h.gen + 1);
+    const uint32_t slot = (uint32_t)h.sid & ((1u << kSlotBits) - 1);
+    // reset both halves for the next request; buffers are released with the old request
+    h = SessionHot{};
+    h.gen = gen;
+    s = ClientSession{};
+    free_slots_.push_back(slot);
+    --live_;
+}
+
+SessionHot* SessionPool::slot_of(int sid) const {
+    if (sid < 0)
+        return nullptr;
+    const uint32_t slot = (uint32_t)sid & ((1u << kSlotBits) - 1);
+    if (slot >= n_slots_)
+        return nullptr;
+    SessionHot& h = chunks_[slot / kChunk]->hot[slot % kChunk];
+    return h.sid == sid ? &h : nullptr;
+}
+
+ClientSession* SessionPool::find(int sid) {
+    SessionHot* h = slot_of(sid);
+    return h ? h->cold : nullptr;
+}
+
+const ClientSession* SessionPool::find(int sid) const {
+    const SessionHot* h = slot_of(sid);
+    return h ? h->cold : nullptr;
+}
+
+void SessionPool::set_state(ClientSession& s, SessionState st) {
+    SessionHot& h = *s.hot;
+    const int8_t to = list_for(st);
+    h.state = st;
+    if (to == h.list_id)
+        return;
+    unlink(h);
+    link(h);
+}
+
+bool SessionPool::has_ready_work() const {
+    for (const SessionHot* h = prefill_ready().front(); h; h = h->list_next) {
+        if (h->prefill_idx < h->cold->prompt_tokens.size())
+            return true;
+    }
+    for (const SessionHot* h = decode_ready().front(); h; h = h->list_next) {
+        if (h->has_pending_tok && !(h->conn && h->conn->tx_parked))
+            return true;
+    }
+    return false;
+}
+
+} // namespace uma::ipc
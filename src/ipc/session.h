@@ -1,6 +1,12 @@
 // UMA Serve - Session state (M2)
 #pragma once
 
+#include "ipc/admission.h"
+#include "ipc/byte_buffer.h"
+#include "ipc/detokenizer.h"
+#include "ipc/shm_ring.h"
+#include "ipc/tx_queue.h"
+
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -13,6 +19,8 @@ namespace uma::ipc {
 
 enum class SessionState {
     RECV_REQ,
+    TOKENIZING, // prompt handed to the tokenizer pool; not schedulable yet
+    QUEUED,     // tokenized, waiting in the admission queue for a sequence slot
     PREFILL,
     DECODE,
     STREAM,
@@ -23,26 +31,72 @@ enum class SessionState {
 struct UmaSlo {
     uint32_t target_ttft_ms = 150; // time-to-first-token target
     uint32_t target_tbt_ms = 80;   // target inter-token budget
-    uint8_t priority = 5;          // reserved for future QoS
+    // 0-9, higher is more urgent. Without an explicit "class", a priority below
+    // kBackgroundBelow puts the request in the background lane.
+    uint8_t priority = 5;
+    static constexpr uint8_t kBackgroundBelow = 5;
 };
 
-struct ClientSession {
+// One client socket. A connection carries any number of in-flight requests
+// (ClientSession); their events are interleaved on the shared tx queue and routed by id.
+struct Connection {
     int fd = -1;
-    std::vector<uint8_t> rx;
-    std::vector<uint8_t> tx;
+    ByteBuffer rx;
+    TxQueue tx;
+    bool read_closed = false;       // peer sent EOF on read side
+    bool close_after_flush = false; // one-shot admin reply or protocol error: close once drained
+    uint64_t last_activity_ns = 0;
+    std::vector<int> requests;      // sids of in-flight requests, in arrival order
+    // Backpressure: tx reached the high-water mark; its requests are left out of decode
+    // until the client drains tx to the low-water mark.
+    bool tx_parked = false;
 
-    llama_context* ctx = nullptr; // unused in M3 (global ctx); kept for compatibility
-    int32_t seq = -1;             // assigned on first request
+    // Stream format (negotiated by a hello frame; JSON by default)
+    bool binary_stream = false; // token events use the compact binary encoding
+    bool binary_text = true;    // include piece bytes in binary token events
+    uint32_t next_handle = 1;
+
+    // Shared-memory transport (hello "transport":"shm"): when set, every event frame queued
+    // in tx is drained into this ring instead of the socket, which then carries only
+    // client->server frames.
+    std::unique_ptr<ShmRingWriter> ring;
+};
+
+struct ClientSession;
+
+// The part of a request that planning and sampling touch every tick. SessionPool keeps
+// these packed together in its slab, apart from the buffers and strings of ClientSession,
+// so walking the ready lists stays within a few cache lines per request.
+struct SessionHot {
+    int sid = -1; // -1 while the slot is free
     SessionState state = SessionState::RECV_REQ;
+    int32_t seq = -1;             // -1 while waiting in the admission queue
+    int32_t n_past = 0;           // tokens already in the sequence (explicit pos tracking)
+    int32_t pending_tok = 0;      // last sampled token to feed
+    bool has_pending_tok = false; // if true, pending_tok will be appended next tick
+    int8_t list_id = -1;          // SessionPool list for the state, -1 = none
+    RequestClass cls = RequestClass::Interactive; // QoS lane
+    uint16_t gen = 1;             // slot generation, part of the sid
+    size_t prefill_idx = 0;       // next index into ClientSession::prompt_tokens
+    Connection* conn = nullptr;   // same as ClientSession::conn
+    ClientSession* cold = nullptr;
+    SessionHot* list_prev = nullptr;
+    SessionHot* list_next = nullptr;
+};
+
+// One in-flight generation request: its own sequence, KV and sampling state. Lives in a
+// SessionPool slot (sid); output goes to the owning connection's tx queue. The per-tick
+// fields (state, seq, n_past, pending token, prefill cursor, lane) are in *hot.
+struct ClientSession {
+    int sid = -1;               // SessionPool handle
+    int fd = -1;                // owning connection's socket
+    Connection* conn = nullptr; // owned by SessionManager; outlives its requests
+    SessionHot* hot = nullptr;  // this request's hot fields, in the same pool slot
+
+    llama_context* ctx = nullptr; // unused in M3 (global ctx); kept for compatibility
     std::vector<int> prompt_tokens; // tokenized prompt (llama_token ids)
-    size_t prefill_idx = 0;         // next index into prompt_tokens
-    bool has_pending_tok = false;   // if true, pending_tok will be appended next tick
-    int32_t pending_tok = 0;        // last sampled token to feed
-    int32_t n_past = 0; // number of tokens already in the sequence (explicit pos tracking)
     uint32_t generated_count = 0; // number of generated tokens so far
-    uint64_t last_activity_ns = 0;
     bool wants_stream = true;
-    bool read_closed = false; // peer sent EOF on read side
     std::string last_error;
 
     // SLO & timing fields
@@ -57,10 +111,103 @@ struct ClientSession {
     double top_p = 0.95;      // 1.0 => no nucleus truncation
     int32_t top_k = 0;        // 0 => disabled
 
-    // Protocol: JSON-only (no mode field required)
-    std::string request_id; // for JSON mode events
+    std::string request_id;   // routes events; unique among the connection's requests
+    // pre-rendered token-event head; referenced by queued frames, which may outlive the request
+    std::shared_ptr<const std::string> token_prefix;
+    uint32_t handle = 0;      // binary-mode handle announced by the start event
+    bool echo_prompt_tokens = false; // return_prompt_tokens: send ids once tokenized
+
+    // Token-event coalescing (per request). Held tokens leave as one "tokens" event.
+    uint32_t flush_ms = 0;             // hold tokens up to this long (0 = no time-based hold)
+    uint32_t min_tokens_per_frame = 1; // hold until this many tokens are pending
+    std::vector<int32_t> held_ids;     // pending token ids
+    std::vector<uint32_t> held_lens;   // byte length of each pending piece in held_text
+    std::string held_text;             // concatenated pending pieces (JSON-escaped unless binary)
+    uint64_t held_since_ns = 0;        // when the oldest pending token was produced
+    bool token_sent = false;           // a token event has been queued (the first goes alone)
+    StreamDetokenizer detok;           // holds partial UTF-8 characters between tokens
+};
+
+// Intrusive doubly linked list of requests (their hot parts), in link order. Iterate with
+// `for (auto* h = list.front(); h; h = h->list_next)`.
+class SessionList {
+  public:
+    SessionList() = default;
+    SessionList(SessionList&& o) noexcept { *this = std::move(o); }
+    SessionList& operator=(SessionList&& o) noexcept;
+
+    SessionHot* front() const { return head_; }
+    size_t size() const { return n_; }
+    bool empty() const { return n_ == 0; }
+
+    void push_back(SessionHot& h);
+    void remove(SessionHot& h);
+
+  private:
+    SessionHot* head_ = nullptr;
+    SessionHot* tail_ = nullptr;
+    size_t n_ = 0;
+};
+
+// In-flight requests. Storage is a slab of fixed-size chunks that is never shrunk, so a
+// request keeps its address for life and slots are reused. A sid is a handle: slot index
+// plus a generation that changes when the slot is freed, so a stale sid (a tokenizer result
+// or queue entry for a request that is gone) finds nothing.
+//
+// Each request is also linked into a list for its state, so the scheduler and the reaper
+// visit only the requests that have work:
+//   prefill_ready  PREFILL
+//   decode_ready   DECODE
+//   finished       STREAM, ERRORED, DONE (final event queued; waiting for reap_finished)
+// Change a request's state only through set_state(), which keeps the lists exact. Requests
+// in other states (TOKENIZING, QUEUED, ...) are in no list.
+class SessionPool {
+  public:
+    SessionPool() = default;
+    SessionPool(SessionPool&&) noexcept = default;
+    SessionPool& operator=(SessionPool&&) noexcept = default;
+
+    // A fresh request (RECV_REQ) in a free slot, with its sid assigned.
+    ClientSession& create(Connection* conn = nullptr);
+    // Frees the slot; the request's sid stops resolving.
+    void erase(ClientSession& s);
+    // nullptr when sid does not name a live request.
+    ClientSession* find(int sid);
+    const ClientSession* find(int sid) const;
+    size_t size() const { return live_; }
+    bool empty() const { return live_ == 0; }
+
+    void set_state(ClientSession& s, SessionState st);
+
+    const SessionList& prefill_ready() const { return lists_[kPrefill]; }
+    const SessionList& decode_ready() const { return lists_[kDecode]; }
+    const SessionList& finished() const { return lists_[kFinished]; }
+
+    // Whether a batch could start now: some request has prompt left to prefill, or a pending
+    // token on a connection that is not parked for backpressure.
+    bool has_ready_work() const;
+
+  private:
+    static constexpr uint32_t kSlotBits = 20; // up to 1M live requests
+    static constexpr uint32_t kGenMask = (1u << (31 - kSlotBits)) - 1;
+    static constexpr size_t kChunk = 64;
+    struct Chunk {
+        SessionHot hot[kChunk];
+        ClientSession cold[kChunk];
+    };
+    enum ListId : int8_t { kPrefill = 0, kDecode = 1, kFinished = 2, kLists = 3 };
+    static int8_t list_for(SessionState st);
+    SessionHot* slot_of(int sid) const;
+    void link(SessionHot& h);
+    void unlink(SessionHot& h);
+
+    std::vector<std::unique_ptr<Chunk>> chunks_;
+    std::vector<uint32_t> free_slots_;
+    uint32_t n_slots_ = 0;
+    size_t live_ = 0;
+    SessionList lists_[kLists];
 };
 
-using SessionPool = std::unordered_map<int, std::unique_ptr<ClientSession>>;
+using ConnectionMap = std::unordered_map<int, std::unique_ptr<Connection>>;
 
 } // namespace uma::ipc
@@ -1,7 +1,11 @@
-// UMA Serve - Session manager (RX parsing, state transitions to PREFILL, basic guards)
+// UMA Serve - Session manager (connections, request admission, RX parsing, basic guards)
 #include "ipc/session_manager.h"
 
+#include "ipc/json_request.h"
 #include "ipc/protocol.h"
+#include "ipc/uds_server.h"
+#include "metrics/metrics.h"
+#include "runtime/tokenizer_pool.h"
 #include "runtime/tokens.h"
 #include "util/logging.h"
 
@@ -11,19 +15,19 @@
 #include <cerrno>
 #include <cstdint>
 #include <cstring>
+#include <string_view>
 #include <sys/socket.h>
 #include <unistd.h>
 
 namespace uma::ipc {
 
-ClientSession& SessionManager::add_client(int fd, uint64_t now_ns) {
-    auto sess = std::make_unique<ClientSession>();
-    sess->fd = fd;
-    sess->ctx = nullptr; // global ctx used in M3 batching
-    sess->last_activity_ns = now_ns;
-    auto& ref = *sess;
-    sessions_[fd] = std::move(sess);
-    UMA_LOG_DEBUG() << "[accept] fd=" << fd << " sessions=" << sessions_.size();
+Connection& SessionManager::add_client(int fd, uint64_t now_ns) {
+    auto conn = std::make_unique<Connection>();
+    conn->fd = fd;
+    conn->last_activity_ns = now_ns;
+    auto& ref = *conn;
+    conns_[fd] = std::move(conn);
+    UMA_LOG_DEBUG() << "[accept] fd=" << fd << " connections=" << conns_.size();
     return ref;
 }
 
@@ -31,43 +35,228 @@ void SessionManager::close(int fd, Poller& poller, llama_context* ctx) {
     // deregister filters
     poller.remove(fd, PollFlags::Read | PollFlags::Write);
 
-    auto it = sessions_.find(fd);
-    if (it != sessions_.end()) {
-        if (it->second->seq >= 0 && ctx) {
-            llama_memory_seq_rm(llama_get_memory(ctx), it->second->seq, -1, -1);
+    auto it = conns_.find(fd);
+    if (it != conns_.end()) {
+        for (int sid : it->second->requests) {
+            ClientSession* sp = sessions_.find(sid);
+            if (!sp)
+                continue;
+            auto& s = *sp;
+            if (s.hot->seq < 0)
+                admission_.remove(s.sid);
+            retire_seq(s.hot->seq, ctx);
+            if (s.ctx)
+                llama_free(s.ctx);
+            sessions_.erase(s);
         }
-        if (it->second->ctx)
-            llama_free(it->second->ctx);
-        ::close(fd);
-        sessions_.erase(it);
-    } else {
-        ::close(fd);
+        conns_.erase(it);
     }
+    ::close(fd);
 }
 
-ClientSession* SessionManager::find(int fd) {
-    auto it = sessions_.find(fd);
-    if (it == sessions_.end())
+Connection* SessionManager::find_conn(int fd) {
+    auto it = conns_.find(fd);
+    if (it == conns_.end())
         return nullptr;
     return it->second.get();
 }
 
+int32_t SessionManager::acquire_seq() {
+    if (!free_seqs_.empty()) {
+        int32_t seq = free_seqs_.back();
+        free_seqs_.pop_back();
+        return seq;
+    }
+    return next_seq_id_++;
+}
+
+void SessionManager::release_seq(int32_t seq) { free_seqs_.push_back(seq); }
+
+void SessionManager::retire_seq(int32_t seq, llama_context* ctx) {
+    if (seq < 0)
+        return;
+    if (kv_busy_) {
+        // not reusable either until cleared: a new request must start from an empty sequence
+        stale_seqs_.push_back(seq);
+        return;
+    }
+    if (ctx)
+        llama_memory_seq_rm(llama_get_memory(ctx), seq, -1, -1);
+    release_seq(seq);
+}
+
+void SessionManager::flush_kv(llama_context* ctx) {
+    for (int32_t seq : stale_seqs_) {
+        if (ctx)
+            llama_memory_seq_rm(llama_get_memory(ctx), seq, -1, -1);
+        release_seq(seq);
+    }
+    stale_seqs_.clear();
+}
+
+void SessionManager::drop_connection(int fd, Poller& poller, llama_context* ctx,
+                                     uint32_t max_tokens) {
+    auto it = conns_.find(fd);
+    if (it == conns_.end())
+        return;
+    for (int sid : it->second->requests) {
+        if (ClientSession* sp = sessions_.find(sid))
+            cancel_request(*sp, max_tokens);
+    }
+    UMA_LOG_DEBUG() << "[hangup] fd=" << fd << " requests=" << it->second->requests.size();
+    close(fd, poller, ctx);
+}
+
+bool SessionManager::cancel_request(ClientSession& s, uint32_t max_tokens) {
+    if (s.hot->state == SessionState::STREAM || s.hot->state == SessionState::ERRORED ||
+        s.hot->state == SessionState::DONE)
+        return false;
+    // work it will not need: the rest of its prompt plus its remaining generation budget
+    uint64_t saved = s.prompt_tokens.size() - std::min(s.hot->prefill_idx, s.prompt_tokens.size());
+    if (s.generated_count < max_tokens)
+        saved += max_tokens - s.generated_count;
+    if (metrics_) {
+        metrics_->cancelled_requests_total.fetch_add(1, std::memory_order_relaxed);
+        metrics_->cancelled_tokens_saved.fetch_add(saved, std::memory_order_relaxed);
+    }
+    if (s.hot->seq < 0)
+        admission_.remove(s.sid);
+    // tokens held for coalescing or a partial character are dropped with the request
+    s.held_ids.clear();
+    s.held_lens.clear();
+    s.held_text.clear();
+    s.detok.reset();
+    s.hot->has_pending_tok = false;
+    sessions_.set_state(s, SessionState::DONE);
+    return true;
+}
+
+void SessionManager::configure_admission(const AdmissionLimits& limits, uint32_t slots) {
+    admission_.set_limits(limits);
+    admission_.set_slots(slots);
+    seq_slots_ = slots;
+}
+
+size_t SessionManager::admit_queued(uint64_t now_ns) {
+    size_t n = 0;
+    int sid = -1;
+    uint64_t enqueued_ns = 0;
+    while (seq_slot_free() && admission_.pop(sid, enqueued_ns)) {
+        ClientSession* sp = sessions_.find(sid);
+        if (!sp)
+            continue;
+        auto& s = *sp;
+        s.hot->seq = acquire_seq();
+        // a request still TOKENIZING keeps its slot and enters PREFILL from on_tokenized()
+        if (s.hot->state == SessionState::QUEUED)
+            sessions_.set_state(s, SessionState::PREFILL);
+        if (metrics_)
+            metrics_->admission_wait_ms.observe((now_ns - enqueued_ns) / 1000000ull);
+        UMA_LOG_DEBUG() << "[admit] fd=" << s.fd << " id=" << s.request_id << " seq=" << s.hot->seq
+                        << " waited_ms=" << (now_ns - enqueued_ns) / 1000000ull;
+        ++n;
+    }
+    return n;
+}
+
+void SessionManager::refuse_connection(Connection& c) {
+    uma::ipc::protocol::append_overloaded_event(c.tx, "", "too many connections",
+                                                admission_.retry_hint_ms());
+    c.close_after_flush = true;
+    c.read_closed = true;
+    if (metrics_)
+        metrics_->connections_rejected_total.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t SessionManager::reap_finished(llama_context* ctx) {
+    size_t n = 0;
+    while (SessionHot* h = sessions_.finished().front()) {
+        auto& s = *h->cold;
+        Connection& c = *s.conn;
+        // queued token frames may still reference this request's prefix
+        c.tx.retain(std::move(s.token_prefix));
+        c.requests.erase(std::remove(c.requests.begin(), c.requests.end(), s.sid),
+                         c.requests.end());
+        if (s.hot->seq < 0)
+            admission_.remove(s.sid); // finished without a slot (empty prompt)
+        else
+            admission_.on_finished(s.generated_count + 1);
+        retire_seq(s.hot->seq, ctx);
+        UMA_LOG_DEBUG() << "[retire] fd=" << s.fd << " id=" << s.request_id
+                        << " seq=" << s.hot->seq;
+        sessions_.erase(s);
+        ++n;
+    }
+    return n;
+}
+
+void SessionManager::fail_connection(Connection& c, const std::string& id, const char* code,
+                                     const std::string& msg, ReadResult& rr) {
+    uma::ipc::protocol::append_error_event(c.tx, id, code, msg);
+    c.close_after_flush = true;
+    c.read_closed = true;
+    rr.wants_write = true;
+    rr.removed_read = true;
+}
+
+bool SessionManager::setup_shm_ring(Connection& c, const JsonRequest& req,
+                                    const uma::runtime::RuntimeConfig& cfg, ReadResult& rr) {
+    constexpr size_t kMaxShmRingBytes = size_t(64) << 20;
+    size_t bytes = cfg.shm_ring_bytes;
+    if (req.shm_bytes && *req.shm_bytes > 0)
+        bytes = (size_t)std::min(*req.shm_bytes, (double)kMaxShmRingBytes);
+    bytes = std::min(bytes, kMaxShmRingBytes);
+
+    auto ring = ShmRingWriter::create(bytes);
+    if (!ring) {
+        UMA_LOG_WARN() << "shm ring setup failed for fd=" << c.fd << ": " << std::strerror(errno);
+        return false;
+    }
+    const std::string payload =
+            uma::ipc::protocol::render_hello_event(c.binary_stream, c.binary_text, ring->capacity());
+    std::string frame(4 + payload.size(), '\0');
+    const uint32_t len = (uint32_t)payload.size();
+    frame[0] = (char)(len & 0xff);
+    frame[1] = (char)((len >> 8) & 0xff);
+    frame[2] = (char)((len >> 16) & 0xff);
+    frame[3] = (char)((len >> 24) & 0xff);
+    std::memcpy(&frame[4], payload.data(), payload.size());
+
+    const int fds[2] = {ring->mem_fd(), ring->doorbell_fd()};
+    ssize_t n = UDSServer::send_with_fds(c.fd, frame.data(), frame.size(), fds, 2);
+    if (n <= 0) {
+        UMA_LOG_WARN() << "shm ring handoff failed for fd=" << c.fd << ": " << std::strerror(errno);
+        return false;
+    }
+    c.ring = std::move(ring);
+    if ((size_t)n < frame.size()) {
+        // a fresh connection's send buffer always takes the ~100-byte reply; if it did not,
+        // the reply is torn and the connection cannot continue
+        UMA_LOG_WARN() << "short shm hello write on fd=" << c.fd;
+        c.close_after_flush = true;
+        c.read_closed = true;
+        rr.removed_read = true;
+    }
+    return true;
+}
+
 SessionManager::ReadResult SessionManager::on_readable(int fd,
                                                        const uma::runtime::RuntimeConfig& cfg,
                                                        const llama_vocab* vocab, uint64_t now_ns) {
     ReadResult rr;
-    auto it = sessions_.find(fd);
-    if (it == sessions_.end())
+    auto it = conns_.find(fd);
+    if (it == conns_.end())
         return rr;
-    auto& s = *it->second;
+    auto& c = *it->second;
 
-    uint8_t buf[4096];
+    constexpr size_t kReadChunk = 4096;
     bool saw_eof = false;
     for (;;) {
-        ssize_t n = ::read(fd, buf, sizeof(buf));
+        // read straight into the rx tail (no bounce buffer)
+        ssize_t n = ::read(fd, c.rx.prepare(kReadChunk), kReadChunk);
         if (n > 0) {
-            s.rx.insert(s.rx.end(), buf, buf + n);
-            s.last_activity_ns = now_ns;
+            c.rx.commit((size_t)n);
+            c.last_activity_ns = now_ns;
             continue; // drain more
         }
         if (n == 0) {
@@ -76,239 +265,313 @@ SessionManager::ReadResult SessionManager::on_readable(int fd,
         }
         if (errno == EAGAIN || errno == EWOULDBLOCK)
             break;
-        // other error -> close by caller
+        // other error -> stop reading; closed once its requests finish and tx drains
+        c.read_closed = true;
         rr.removed_read = true;
         return rr;
     }
 
     if (saw_eof) {
-        s.read_closed = true;
+        c.read_closed = true;
         rr.removed_read = true;
-        s.last_activity_ns = now_ns;
-    }
-
-    // JSON-only protocol: attempt to parse one framed request
-    std::string js;
-    std::string err;
-    if (!uma::ipc::protocol::try_read_frame(s.rx, js, uma::ipc::protocol::kDefaultMaxFrameBytes,
-                                            &err)) {
-        if (!err.empty()) {
-            const char* code = (err.find("invalid frame length 0") != std::string::npos)
-                                       ? "E_PROTO_INVALID_LEN"
-                                       : "E_PROTO_FRAME_TOO_LARGE";
-            uma::ipc::protocol::append_error_event(s.tx, s.request_id, code, err);
-            s.state = SessionState::STREAM;
-            s.read_closed = true;
-            rr.wants_write = true;
-            rr.removed_read = true;
-        }
-        return rr; // need more
-    }
-    // Admin metrics handled below
-    // minimal field extraction with basic JSON string parsing (handles escapes; flags invalid
-    // escapes)
-    auto extract_json_string = [](const std::string& j, const char* key,
-                                  bool& invalid_escape) -> std::string {
-        invalid_escape = false;
-        size_t kpos = j.find("\"" + std::string(key) + "\"");
-        if (kpos == std::string::npos)
-            return {};
-        size_t colon = j.find(':', kpos);
-        if (colon == std::string::npos)
-            return {};
-        size_t q1 = j.find('"', colon);
-        if (q1 == std::string::npos)
-            return {};
-        size_t i = q1 + 1;
-        std::string out;
-        auto is_hex = [](char c) {
-            return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
-        };
-        while (i < j.size()) {
-            char c = j[i++];
-            if (c == '\\') {
-                if (i >= j.size()) {
-                    invalid_escape = true;
-                    break;
-                }
-                char e = j[i++];
-                switch (e) {
-                    case '"':
-                        out.push_back('"');
-                        break;
-                    case '\\':
-                        out.push_back('\\');
-                        break;
-                    case '/':
-                        out.push_back('/');
-                        break;
-                    case 'b':
-                        out.push_back('\b');
-                        break;
-                    case 'f':
-                        out.push_back('\f');
-                        break;
-                    case 'n':
-                        out.push_back('\n');
-                        break;
-                    case 'r':
-                        out.push_back('\r');
-                        break;
-                    case 't':
-                        out.push_back('\t');
-                        break;
-                    case 'u': {
-                        if (i + 4 > j.size() || !is_hex(j[i]) || !is_hex(j[i + 1]) ||
-                            !is_hex(j[i + 2]) || !is_hex(j[i + 3])) {
-                            invalid_escape = true;
-                            break;
-                        }
-                        // skip 4 hex digits; we won't decode here
-                        i += 4;
-                        // append placeholder; actual UTF-8 decoding not required for this test
-                        out.push_back('?');
-                        break;
-                    }
-                    default:
-                        // unsupported escape (e.g., \x) → invalid
-                        invalid_escape = true;
-                        break;
-                }
-                if (invalid_escape)
-                    break;
-            } else if (c == '"') {
-                // end of string
-                break;
-            } else {
-                // control chars are invalid in JSON strings
-                if (static_cast<unsigned char>(c) < 0x20) {
-                    invalid_escape = true;
-                    break;
-                }
-                out.push_back(c);
-            }
+        if (!c.requests.empty() && UDSServer::peer_closed(fd)) {
+            // nobody left to read the answers: stop generating for this client now
+            rr.peer_gone = true;
+            return rr;
         }
-        return out;
-    };
+        c.last_activity_ns = now_ns;
+    }
 
-    // Admin metrics (JSON): accept {"type":"metrics"} or {"event":"metrics"}
-    {
-        bool type_invalid = false, event_invalid = false;
-        std::string typ = extract_json_string(js, "type", type_invalid);
-        std::string evt = extract_json_string(js, "event", event_invalid);
-        if ((!type_invalid && typ == "metrics") || (!event_invalid && evt == "metrics")) {
-            rr.admin_request = true;
-            s.state = SessionState::STREAM;
-            s.read_closed = true;
-            rr.wants_write = true;
-            rr.removed_read = true;
-            return rr;
+    // Parse every complete frame (zero-copy views into rx): client reads are edge-triggered,
+    // so frames left behind would not raise another event.
+    while (!c.close_after_flush) {
+        std::string_view js;
+        size_t frame_bytes = 0;
+        std::string err;
+        if (!uma::ipc::protocol::peek_frame(c.rx, js, frame_bytes,
+                                            uma::ipc::protocol::kDefaultMaxFrameBytes, &err)) {
+            if (!err.empty()) {
+                const char* code = (err.find("invalid frame length 0") != std::string::npos)
+                                           ? "E_PROTO_INVALID_LEN"
+                                           : "E_PROTO_FRAME_TOO_LARGE";
+                fail_connection(c, "", code, err, rr);
+            }
+            break; // need more
         }
+        // consume() only advances the read offset, so js stays valid until rx is appended to
+        c.rx.consume(frame_bytes);
+        on_frame(c, js, cfg, vocab, now_ns, rr);
     }
+    return rr;
+}
 
-    bool id_invalid = false, prompt_invalid = false;
-    std::string req_id = extract_json_string(js, "id", id_invalid);
-    std::string prompt = extract_json_string(js, "prompt", prompt_invalid);
-    if (id_invalid || prompt_invalid) {
-        uma::ipc::protocol::append_error_event(s.tx, req_id, "E_PROTO_001", "invalid utf-8");
-        s.state = SessionState::STREAM;
-        s.read_closed = true;
-        rr.wants_write = true;
-        rr.removed_read = true;
-        return rr;
+void SessionManager::on_frame(Connection& c, std::string_view js,
+                              const uma::runtime::RuntimeConfig& cfg, const llama_vocab* vocab,
+                              uint64_t now_ns, ReadResult& rr) {
+    const int fd = c.fd;
+    // one pass over the payload; req_ keeps its buffers between frames
+    JsonRequest& req = req_;
+    const JsonParseStatus st = parse_json_request(js, req);
+    if (st == JsonParseStatus::BadString) {
+        fail_connection(c, req.id, "E_PROTO_001", "invalid utf-8", rr);
+        return;
+    }
+    if (st != JsonParseStatus::Ok) {
+        fail_connection(c, req.id, "E_PROTO_INVALID_JSON", "malformed JSON object", rr);
+        return;
     }
-    if (prompt.empty()) {
-        uma::ipc::protocol::append_error_event(s.tx, req_id, "E_PROTO_BAD_REQUEST",
-                                               "missing or invalid prompt");
-        s.state = SessionState::STREAM;
-        s.read_closed = true;
+
+    // Admin metrics (JSON): accept {"type":"metrics"} or {"event":"metrics"}
+    if (req.type == "metrics" || req.event == "metrics") {
+        rr.admin_request = true;
+        c.close_after_flush = true;
+        c.read_closed = true;
         rr.wants_write = true;
         rr.removed_read = true;
-        return rr;
+        return;
     }
-    s.request_id = req_id;
 
-    // Minimal numeric extractor: parses unquoted JSON numbers after key
-    auto extract_json_number = [](const std::string& j, const char* key,
-                                  bool& found, double& out_val) {
-        found = false;
-        out_val = 0.0;
-        std::string k = std::string("\"") + key + "\"";
-        size_t p = j.find(k);
-        if (p == std::string::npos) return;
-        size_t colon = j.find(':', p);
-        if (colon == std::string::npos) return;
-        // skip whitespace
-        size_t i = colon + 1;
-        while (i < j.size() && (j[i] == ' ' || j[i] == '\t' || j[i] == '\n' || j[i] == '\r')) ++i;
-        if (i >= j.size()) return;
-        // read until delimiter (comma or closing brace)
-        size_t start = i;
-        while (i < j.size()) {
-            char c = j[i];
-            if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == 'e' || c == 'E' || c == '.') {
-                ++i;
+    // Cancellation: {"type":"cancel","id":...} (or {"event":"cancel",...}). The request ends
+    // with eos "cancelled". An unknown id is ignored: the request may have just finished.
+    if (req.type == "cancel" || req.event == "cancel") {
+        for (int sid : c.requests) {
+            ClientSession* sp = sessions_.find(sid);
+            if (!sp || sp->request_id != req.id)
                 continue;
+            auto& s = *sp;
+            if (cancel_request(s, cfg.max_tokens)) {
+                uma::ipc::protocol::append_eos_event(c.tx, s.request_id, "cancelled");
+                rr.wants_write = true;
+                UMA_LOG_DEBUG() << "[cancel] fd=" << fd << " id=" << s.request_id;
             }
             break;
         }
-        if (i == start) return;
-        std::string num = j.substr(start, i - start);
-        char* endp = nullptr;
-        out_val = std::strtod(num.c_str(), &endp);
-        if (endp && endp != num.c_str()) {
-            found = true;
+        return;
+    }
+
+    // Stream-format negotiation: {"type":"hello","stream_format":"binary","text":false}
+    if (req.type == "hello") {
+        const std::string& fmt = req.stream_format;
+        if (!fmt.empty() && fmt != "json" && fmt != "binary") {
+            fail_connection(c, "", "E_PROTO_BAD_REQUEST", "unsupported stream_format", rr);
+            return;
+        }
+        const std::string& transport = req.transport;
+        if (!transport.empty() && transport != "socket" && transport != "shm") {
+            fail_connection(c, "", "E_PROTO_BAD_REQUEST", "unsupported transport", rr);
+            return;
+        }
+        c.binary_stream = fmt == "binary";
+        c.binary_text = req.text.value_or(true);
+        if (transport == "shm" && !c.ring) {
+            // The ring fds ride on the hello reply itself, so nothing may be queued ahead of it.
+            if (!c.tx.empty() || !c.requests.empty()) {
+                fail_connection(c, "", "E_PROTO_BAD_REQUEST",
+                                "shm transport must be negotiated before any request", rr);
+                return;
+            }
+            if (setup_shm_ring(c, req, cfg, rr))
+                return;
+            // could not create/pass a ring: answer on the socket, events stay there
+        }
+        uma::ipc::protocol::append_hello_event(c.tx, c.binary_stream, c.binary_text);
+        rr.wants_write = true;
+        return;
+    }
+
+    const std::string& req_id = req.id;
+    const std::string& prompt = req.prompt;
+    if (req.has_prompt_tokens) {
+        // pre-tokenized prompt: used as-is (no BOS is added), so every id must be in the vocab
+        if (!prompt.empty()) {
+            fail_connection(c, req_id, "E_PROTO_BAD_REQUEST",
+                            "prompt and prompt_tokens are mutually exclusive", rr);
+            return;
+        }
+        if (req.prompt_tokens.empty()) {
+            fail_connection(c, req_id, "E_PROTO_BAD_REQUEST", "missing or invalid prompt", rr);
+            return;
         }
+        const int32_t n_vocab = uma::runtime::tokens::n_vocab(vocab);
+        for (int32_t t : req.prompt_tokens) {
+            if (t < 0 || t >= n_vocab) {
+                fail_connection(c, req_id, "E_PROTO_BAD_REQUEST", "prompt token id out of range",
+                                rr);
+                return;
+            }
+        }
+    } else if (prompt.empty()) {
+        fail_connection(c, req_id, "E_PROTO_BAD_REQUEST", "missing or invalid prompt", rr);
+        return;
+    }
+
+    // QoS lane: "class" when given, else from "slo":{"priority":..}
+    const uint8_t priority =
+            req.slo_priority ? (uint8_t)std::clamp(*req.slo_priority, 0.0, 9.0) : UmaSlo{}.priority;
+    RequestClass cls = priority < UmaSlo::kBackgroundBelow ? RequestClass::Background
+                                                            : RequestClass::Interactive;
+    if (!req.request_class.empty() &&
+        !parse_request_class(req.request_class.data(), req.request_class.size(), cls)) {
+        fail_connection(c, req_id, "E_PROTO_BAD_REQUEST", "unknown request class", rr);
+        return;
+    }
+
+    // Request-level rejections below leave the connection (and its other requests) running.
+    auto reject = [&](const char* code, const char* msg) {
+        uma::ipc::protocol::append_error_event(c.tx, req_id, code, msg);
+        rr.wants_write = true;
     };
+    // size limit on prompt (bytes of text; a token prompt must fit the context)
+    if (prompt.size() > cfg.max_prompt_bytes || req.prompt_tokens.size() > cfg.n_ctx) {
+        reject("E_LIMIT_001", "prompt too large");
+        return;
+    }
+    if (c.requests.size() >= std::max<uint32_t>(cfg.max_inflight_per_conn, 1)) {
+        reject("E_LIMIT_INFLIGHT", "too many in-flight requests on this connection");
+        return;
+    }
+    for (int sid : c.requests) {
+        const ClientSession* sp = sessions_.find(sid);
+        if (sp && sp->request_id == req_id) {
+            reject("E_PROTO_DUPLICATE_ID", "request id already in flight");
+            return;
+        }
+    }
+    // per-request "slo": {"target_ttft_ms":..,"target_tbt_ms":..} overrides the defaults
+    uint32_t ttft_ms = cfg.slo_ttft_ms;
+    if (req.slo_ttft_ms && *req.slo_ttft_ms > 0)
+        ttft_ms = (uint32_t)std::min(*req.slo_ttft_ms, 3.6e6);
+    // Every sequence slot is taken (or others are already waiting for one): queue the
+    // request, unless the queue is full or it would wait past its TTFT target anyway.
+    const bool must_wait = !seq_slot_free() || !admission_.empty();
+    if (must_wait) {
+        const AdmissionQueue::Verdict v = admission_.check(cls, ttft_ms);
+        if (!v.admit) {
+            uma::ipc::protocol::append_overloaded_event(c.tx, req_id, v.reason, v.retry_after_ms);
+            rr.wants_write = true;
+            if (metrics_) {
+                (v.shed ? metrics_->admission_shed_total : metrics_->admission_rejected_total)
+                        .fetch_add(1, std::memory_order_relaxed);
+            }
+            UMA_LOG_DEBUG() << "[overloaded] fd=" << fd << " id=" << req_id << " " << v.reason
+                            << " predicted_wait_ms=" << v.predicted_wait_ms;
+            return;
+        }
+    }
+
+    // Tokenize inline (token prompts, short texts, no pool) or hand the prompt to the
+    // tokenizer pool and park the request in TOKENIZING until on_tokenized().
+    const bool async_tok = tokenizer_ && !req.has_prompt_tokens &&
+                           prompt.size() > cfg.tokenize_inline_bytes;
+    std::vector<int> toks;
+    if (req.has_prompt_tokens)
+        toks.assign(req.prompt_tokens.begin(), req.prompt_tokens.end());
+    else if (!async_tok)
+        toks = uma::runtime::tokens::tokenize(vocab, prompt, /*add_bos*/ true, /*special*/ true);
+    if (!async_tok && toks.empty()) {
+        // empty prompt -> eos event; nothing to schedule
+        uma::ipc::protocol::append_eos_event(c.tx, req_id, "stop");
+        rr.wants_write = true;
+        return;
+    }
+
+    auto& s = sessions_.create(&c);
+    s.fd = fd;
+    s.request_id = req_id;
+    s.token_prefix = std::make_shared<const std::string>(
+            uma::ipc::protocol::render_token_prefix(s.request_id));
+    if (c.binary_stream) {
+        // binary token events carry a small handle instead of the id; announce the mapping
+        s.handle = c.next_handle++;
+        uma::ipc::protocol::append_start_event(c.tx, s.request_id, s.handle);
+        rr.wants_write = true;
+    }
+    s.echo_prompt_tokens = req.return_prompt_tokens.value_or(false);
 
     // Optional sampling preferences (per-request). If not present, keep defaults in session.
+    if (req.temperature)
+        s.temperature = *req.temperature;
+    if (req.top_p)
+        s.top_p = *req.top_p;
+    if (req.top_k)
+        s.top_k = (int32_t)*req.top_k;
+    s.wants_stream = req.stream.value_or(true);
+
+    // Optional token-event coalescing (per request; absent => one frame per token)
     {
-        bool f = false; double v = 0.0;
-        extract_json_number(js, "temperature", f, v);
-        if (f) s.temperature = v;
-        extract_json_number(js, "top_p", f, v);
-        if (f) s.top_p = v;
-        extract_json_number(js, "top_k", f, v);
-        if (f) s.top_k = (int32_t) v;
-    }
-
-    // size limit (bytes) on prompt
-    if (prompt.size() > cfg.max_prompt_bytes) {
-        uma::ipc::protocol::append_error_event(s.tx, s.request_id, "E_LIMIT_001",
-                                               "prompt too large");
-        s.state = SessionState::STREAM;
-        s.read_closed = true;
-        rr.wants_write = true;
-        rr.removed_read = true;
-        return rr;
+        const double fm = req.flush_ms.value_or(0);
+        s.flush_ms = fm > 0 ? (uint32_t)std::min(fm, 10000.0) : 0;
+        const double mt = req.min_tokens_per_frame.value_or(1);
+        s.min_tokens_per_frame = mt > 1 ? (uint32_t)std::min(mt, 64.0) : 1;
     }
 
-    // tokenize prompt and transition to PREFILL (no immediate echo for JSON)
-    s.prompt_tokens.clear();
-    auto toks = uma::runtime::tokens::tokenize(vocab, prompt, /*add_bos*/ true, /*special*/ true);
-    if (!toks.empty()) {
-        s.prompt_tokens = std::move(toks);
-        s.prefill_idx = 0;
-        s.generated_count = 0;
-        s.has_pending_tok = false;
-        s.n_past = 0;
-        s.req_start_ns = now_ns;
-        s.first_emit_ns = 0;
-        s.last_emit_ns = 0;
-        s.slo.target_ttft_ms = cfg.slo_ttft_ms;
-        s.slo.target_tbt_ms = cfg.slo_tbt_ms;
-        if (s.seq < 0)
-            s.seq = next_seq_id_++;
-        s.state = SessionState::PREFILL;
-        UMA_LOG_DEBUG() << "[prompt-json] fd=" << fd << " seq=" << s.seq
-                        << " n_prompt=" << s.prompt_tokens.size();
+    s.req_start_ns = now_ns;
+    s.slo.target_ttft_ms = ttft_ms;
+    s.slo.target_tbt_ms = cfg.slo_tbt_ms;
+    if (req.slo_tbt_ms && *req.slo_tbt_ms > 0)
+        s.slo.target_tbt_ms = (uint32_t)std::min(*req.slo_tbt_ms, 3.6e6);
+    s.slo.priority = priority;
+    s.hot->cls = cls;
+    if (must_wait) {
+        if (metrics_) {
+            metrics_->admission_queued_total.fetch_add(1, std::memory_order_relaxed);
+            metrics_->admission_depth.observe(admission_.depth());
+        }
+        admission_.push(s.sid, cls, now_ns); // tokenization still starts right away
     } else {
-        // empty prompt -> eos event (keep connection open for reuse)
-        s.state = SessionState::STREAM;
-        uma::ipc::protocol::append_eos_event(s.tx, s.request_id, "stop");
-        rr.wants_write = true;
+        s.hot->seq = acquire_seq();
     }
-    return rr;
+    if (async_tok) {
+        sessions_.set_state(s, SessionState::TOKENIZING);
+        uma::runtime::TokenizeJob job;
+        job.sid = s.sid;
+        job.submit_ns = now_ns;
+        job.text = std::move(req.prompt); // req_ is re-filled by the next parse anyway
+        tokenizer_->submit(std::move(job));
+    } else {
+        begin_prefill(s, std::move(toks));
+    }
+    UMA_LOG_DEBUG() << "[prompt-json] fd=" << fd << " id=" << s.request_id << " seq=" << s.hot->seq
+                    << " n_prompt=" << s.prompt_tokens.size()
+                    << (async_tok ? " (tokenizing)" : "") << " inflight=" << c.requests.size() + 1;
+    c.requests.push_back(s.sid);
+}
+
+void SessionManager::begin_prefill(ClientSession& s, std::vector<int>&& toks) {
+    Connection& c = *s.conn;
+    if (toks.empty()) {
+        // nothing to prefill (empty or failed tokenization): finish like an empty prompt
+        uma::ipc::protocol::append_eos_event(c.tx, s.request_id, "stop");
+        sessions_.set_state(s, SessionState::DONE);
+        return;
+    }
+    if (s.echo_prompt_tokens) {
+        // lets clients cache the tokenization and send prompt_tokens next time
+        uma::ipc::protocol::append_prompt_tokens_event(c.tx, s.request_id, toks.data(),
+                                                       toks.size());
+    }
+    s.prompt_tokens = std::move(toks);
+    s.hot->prefill_idx = 0;
+    sessions_.set_state(s, s.hot->seq >= 0 ? SessionState::PREFILL : SessionState::QUEUED);
+}
+
+size_t SessionManager::on_tokenized(std::vector<uma::runtime::TokenizeResult>& results,
+                                    std::vector<int>& fds_with_output) {
+    size_t n = 0;
+    for (auto& r : results) {
+        ClientSession* sp = sessions_.find(r.sid);
+        if (!sp || sp->hot->state != SessionState::TOKENIZING)
+            continue; // connection closed while the prompt was being tokenized
+        auto& s = *sp;
+        const bool was_empty = s.conn->tx.empty();
+        begin_prefill(s, std::move(r.tokens));
+        if (was_empty && !s.conn->tx.empty())
+            fds_with_output.push_back(s.fd);
+        UMA_LOG_DEBUG() << "[tokenized] fd=" << s.fd << " id=" << s.request_id
+                        << " n_prompt=" << s.prompt_tokens.size();
+        ++n;
+    }
+    return n;
 }
 
 } // namespace uma::ipc
@@ -1,6 +1,8 @@
-// UMA Serve - Session manager (RX parsing, state transitions to PREFILL, basic guards)
+// UMA Serve - Session manager (connections, request admission, RX parsing, basic guards)
 #pragma once
 
+#include "ipc/admission.h"
+#include "ipc/json_request.h"
 #include "ipc/poller.h"
 #include "ipc/session.h"
 #include "runtime/config.h"
@@ -9,44 +11,130 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
 struct llama_context;
 struct llama_vocab;
 
+namespace uma::metrics {
+struct Metrics;
+} // namespace uma::metrics
+
+namespace uma::runtime {
+class TokenizerPool;
+struct TokenizeResult;
+} // namespace uma::runtime
+
 namespace uma::ipc {
 
 class SessionManager {
   public:
     SessionManager() = default;
 
-    // Create and register a new session for fd; returns reference.
-    ClientSession& add_client(int fd, uint64_t now_ns);
+    // Create and register a new connection for fd; returns reference.
+    Connection& add_client(int fd, uint64_t now_ns);
 
-    // Close and remove a session; clears KV memory and deregisters with poller.
+    // Close a connection and drop its in-flight requests (clears their KV memory);
+    // deregisters with poller.
     void close(int fd, Poller& poller, llama_context* ctx);
+    // Close a connection whose peer went away (ReadResult::peer_gone, or a hangup event for
+    // which UDSServer::peer_closed() holds). Its unfinished requests count as cancelled.
+    void drop_connection(int fd, Poller& poller, llama_context* ctx, uint32_t max_tokens);
+
+    // Tokenize prompts longer than cfg.tokenize_inline_bytes on this pool (nullptr = always
+    // inline). The pool must outlive the manager's use of it.
+    void set_tokenizer(uma::runtime::TokenizerPool* pool) { tokenizer_ = pool; }
+
+    // Admission: at most `slots` requests hold a sequence (llama_n_seq_max; 0 = unlimited).
+    // Later arrivals wait in the admission queue, or are shed with E_OVERLOADED when the
+    // queue is full or their predicted wait would miss their TTFT target.
+    void configure_admission(const AdmissionLimits& limits, uint32_t slots);
+    // Recent time per decode step (the scheduler's EWMA), for wait predictions.
+    void set_step_ms(double ms) { admission_.set_step_ms(ms); }
+    // Give free sequence slots to queued requests, oldest first. Returns how many started.
+    size_t admit_queued(uint64_t now_ns);
+    const AdmissionQueue& admission() const { return admission_; }
+    // Answer a connection over the connection cap with E_OVERLOADED; it closes once drained.
+    void refuse_connection(Connection& c);
+    void set_metrics(uma::metrics::Metrics* m) { metrics_ = m; }
+
+    // Move requests whose tokenization finished from TOKENIZING to PREFILL (or finish them
+    // when there is nothing to prefill). Results for requests that are gone are dropped.
+    // fds whose tx went from empty to non-empty are appended to fds_with_output.
+    size_t on_tokenized(std::vector<uma::runtime::TokenizeResult>& results,
+                        std::vector<int>& fds_with_output);
 
     // Lookup
-    ClientSession* find(int fd);
+    Connection* find_conn(int fd);
 
-    // Access underlying map (for scheduler and iteration)
+    // In-flight requests keyed by sid (for scheduler and iteration)
     SessionPool& map() { return sessions_; }
+    const ConnectionMap& connections() const { return conns_; }
+
+    // Retire requests whose final event (eos/error) has been queued: release their
+    // sequence ids for reuse. Returns the number of requests retired.
+    size_t reap_finished(llama_context* ctx);
+
+    // While a decode runs on the compute thread the KV cache must not be touched. Sequences
+    // retired in that window (closed connections, finished requests) are queued, and
+    // flush_kv() clears them and returns them to the free list afterwards.
+    void set_kv_busy(bool busy) { kv_busy_ = busy; }
+    void flush_kv(llama_context* ctx);
 
     struct ReadResult {
         bool wants_write = false;   // true if tx now has pending bytes
         bool removed_read = false;  // caller should remove Read interest
         bool admin_request = false; // true if line was an admin command (e.g., /metrics)
+        bool peer_gone = false;     // peer closed both directions: call drop_connection()
         std::string admin_line;     // the raw line parsed
     };
 
-    // Handle readable event: read bytes, parse framed JSON, validate and tokenize prompt.
-    // On prompt, transitions session to PREFILL.
+    // Handle readable event: read bytes, then parse every complete frame. Each valid
+    // request becomes a new in-flight ClientSession in PREFILL.
     // Returns what actions the caller should take.
     ReadResult on_readable(int fd, const uma::runtime::RuntimeConfig& cfg, const llama_vocab* vocab,
                            uint64_t now_ns);
 
   private:
+    // Handle one request/control frame on connection c.
+    void on_frame(Connection& c, std::string_view js, const uma::runtime::RuntimeConfig& cfg,
+                  const llama_vocab* vocab, uint64_t now_ns, ReadResult& rr);
+    // Create a shared-memory ring for c and pass it to the client with the hello reply.
+    // false if no ring could be set up (the caller answers on the socket instead).
+    bool setup_shm_ring(Connection& c, const JsonRequest& req,
+                        const uma::runtime::RuntimeConfig& cfg, ReadResult& rr);
+    // Queue a protocol error and stop reading; the connection closes once tx drains.
+    void fail_connection(Connection& c, const std::string& id, const char* code,
+                         const std::string& msg, ReadResult& rr);
+    // Stop an unfinished request now: it leaves the admission queue and the next plan, and
+    // its sequence is cleared by the next reap_finished(). Counts the tokens it would still
+    // have decoded. false if it had already finished.
+    bool cancel_request(ClientSession& s, uint32_t max_tokens);
+
+    // Install a request's prompt tokens and move it to PREFILL, or QUEUED while it has no
+    // sequence yet (DONE + eos if empty).
+    void begin_prefill(ClientSession& s, std::vector<int>&& toks);
+
+    bool seq_slot_free() const {
+        return seq_slots_ == 0 || (size_t)next_seq_id_ - free_seqs_.size() < seq_slots_;
+    }
+    int32_t acquire_seq();
+    void release_seq(int32_t seq);
+    // Clear a retired request's KV and free its sequence id (deferred while kv_busy_).
+    void retire_seq(int32_t seq, llama_context* ctx);
+
     SessionPool sessions_;
-    int32_t next_seq_id_ = 1;
+    ConnectionMap conns_;
+    JsonRequest req_; // parse scratch reused for every frame
+    uma::runtime::TokenizerPool* tokenizer_ = nullptr;
+    uma::metrics::Metrics* metrics_ = nullptr;
+    int32_t next_seq_id_ = 0;
+    std::vector<int32_t> free_seqs_; // sequence ids of retired requests
+    bool kv_busy_ = false;
+    std::vector<int32_t> stale_seqs_; // retired during a decode; cleared by flush_kv()
+    AdmissionQueue admission_;
+    uint32_t seq_slots_ = 0;
 };
 
 } // namespace uma::ipc
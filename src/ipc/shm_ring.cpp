@@ -0,0 +1,280 @@
+// UMA Serve - Shared-memory SPSC byte ring (same-host token transport)
+#include "ipc/shm_ring.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+namespace uma::ipc {
+
+namespace {
+
+#ifndef __linux__
+void set_cloexec_nonblock(int fd) {
+    int fl = ::fcntl(fd, F_GETFL, 0);
+    if (fl != -1)
+        ::fcntl(fd, F_SETFL, fl | O_NONBLOCK);
+    int fdfl = ::fcntl(fd, F_GETFD);
+    if (fdfl != -1)
+        ::fcntl(fd, F_SETFD, fdfl | FD_CLOEXEC);
+}
+#endif
+
+// Anonymous shared-memory file: memfd on Linux, an immediately unlinked POSIX shm object
+// elsewhere (macOS has no memfd_create).
+int make_shared_file() {
+#ifdef __linux__
+    return ::memfd_create("uma-ring", MFD_CLOEXEC);
+#else
+    static std::atomic<uint32_t> counter{0};
+    char name[64];
+    std::snprintf(name, sizeof(name), "/uma-ring-%d-%u", (int)::getpid(),
+                  counter.fetch_add(1, std::memory_order_relaxed));
+    int fd = ::shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0) {
+        ::shm_unlink(name);
+        int fdfl = ::fcntl(fd, F_GETFD);
+        if (fdfl != -1)
+            ::fcntl(fd, F_SETFD, fdfl | FD_CLOEXEC);
+    }
+    return fd;
+#endif
+}
+
+// Doorbell: one eventfd on Linux (both ends), a pipe elsewhere.
+bool make_doorbell(int& tx_fd, int& rx_fd) {
+#ifdef __linux__
+    int fd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (fd < 0)
+        return false;
+    tx_fd = rx_fd = fd;
+    return true;
+#else
+    int p[2];
+    if (::pipe(p) != 0)
+        return false;
+    set_cloexec_nonblock(p[0]);
+    set_cloexec_nonblock(p[1]);
+    rx_fd = p[0];
+    tx_fd = p[1];
+    return true;
+#endif
+}
+
+size_t round_pow2(size_t n) {
+    size_t c = 4096;
+    while (c < n)
+        c <<= 1;
+    return c;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------- writer
+
+std::unique_ptr<ShmRingWriter> ShmRingWriter::create(size_t capacity) {
+    std::unique_ptr<ShmRingWriter> w(new ShmRingWriter());
+    w->cap_ = round_pow2(capacity);
+    w->map_len_ = kShmDataOffset + w->cap_;
+    w->mem_fd_ = make_shared_file();
+    if (w->mem_fd_ < 0)
+        return nullptr;
+    if (::ftruncate(w->mem_fd_, (off_t)w->map_len_) != 0)
+        return nullptr;
+    void* p = ::mmap(nullptr, w->map_len_, PROT_READ | PROT_WRITE, MAP_SHARED, w->mem_fd_, 0);
+    if (p == MAP_FAILED)
+        return nullptr;
+    w->hdr_ = new (p) ShmRingHeader();
+    w->hdr_->capacity = w->cap_;
+    w->data_ = static_cast<uint8_t*>(p) + kShmDataOffset;
+    if (!make_doorbell(w->bell_tx_fd_, w->bell_rx_fd_))
+        return nullptr;
+    return w;
+}
+
+ShmRingWriter::~ShmRingWriter() {
+    if (hdr_) {
+        close();
+        ::munmap(hdr_, map_len_);
+    }
+    if (mem_fd_ >= 0)
+        ::close(mem_fd_);
+    if (bell_rx_fd_ >= 0 && bell_rx_fd_ != bell_tx_fd_)
+        ::close(bell_rx_fd_);
+    if (bell_tx_fd_ >= 0)
+        ::close(bell_tx_fd_);
+}
+
+// tail lives in memory the client maps read-write, so it is loaded once and checked before
+// it bounds a copy: a stale or forged value must not open more room than the ring has.
+bool ShmRingWriter::load_free(size_t& free) const {
+    const uint64_t tail = hdr_->tail.load(std::memory_order_acquire);
+    if (tail > head_ || head_ - tail > cap_)
+        return false;
+    free = cap_ - (size_t)(head_ - tail);
+    return true;
+}
+
+size_t ShmRingWriter::free_space() const {
+    size_t free = 0;
+    if (corrupt_ || !load_free(free))
+        return 0;
+    return free;
+}
+
+size_t ShmRingWriter::write(const void* p, size_t n) {
+    size_t free = 0;
+    if (corrupt_)
+        return 0;
+    if (!load_free(free)) {
+        corrupt_ = true;
+        return 0;
+    }
+    n = std::min(n, free);
+    if (n == 0)
+        return 0;
+    const size_t off = (size_t)head_ & (cap_ - 1);
+    const size_t first = std::min(n, cap_ - off);
+    std::memcpy(data_ + off, p, first);
+    if (n > first)
+        std::memcpy(data_, static_cast<const uint8_t*>(p) + first, n - first);
+    head_ += n;
+    hdr_->head.store(head_, std::memory_order_release);
+    return n;
+}
+
+size_t ShmRingWriter::drain(TxQueue& q) {
+    size_t moved = 0;
+    struct iovec iov[TxQueue::kMaxIov];
+    while (!q.empty()) {
+        const int cnt = q.fill_iov(iov, TxQueue::kMaxIov);
+        size_t w = 0;
+        bool full = false;
+        for (int i = 0; i < cnt && !full; ++i) {
+            const size_t k = write(iov[i].iov_base, iov[i].iov_len);
+            w += k;
+            full = k < iov[i].iov_len;
+        }
+        q.consume(w);
+        moved += w;
+        if (full || w == 0)
+            break;
+    }
+    return moved;
+}
+
+bool ShmRingWriter::notify() {
+    // pairs with the reader's fence between setting reader_waiting and re-checking head
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (hdr_->reader_waiting.load(std::memory_order_relaxed) == 0)
+        return false;
+    hdr_->reader_waiting.store(0, std::memory_order_relaxed);
+    const uint64_t one = 1;
+    ssize_t rc = ::write(bell_tx_fd_, &one, sizeof(one));
+    (void)rc; // EAGAIN: a wakeup is already pending
+    return true;
+}
+
+void ShmRingWriter::close() {
+    if (hdr_->writer_closed.exchange(1, std::memory_order_acq_rel) != 0)
+        return;
+    const uint64_t one = 1;
+    ssize_t rc = ::write(bell_tx_fd_, &one, sizeof(one));
+    (void)rc;
+}
+
+// ---------------------------------------------------------------- reader
+
+ShmRingReader::~ShmRingReader() {
+    if (hdr_)
+        ::munmap(hdr_, map_len_);
+    if (mem_fd_ >= 0)
+        ::close(mem_fd_);
+    if (bell_fd_ >= 0)
+        ::close(bell_fd_);
+}
+
+bool ShmRingReader::attach(int mem_fd, int doorbell_fd) {
+    mem_fd_ = mem_fd;
+    bell_fd_ = doorbell_fd;
+    struct stat st;
+    if (::fstat(mem_fd, &st) != 0 || (size_t)st.st_size <= kShmDataOffset)
+        return false;
+    map_len_ = (size_t)st.st_size;
+    void* p = ::mmap(nullptr, map_len_, PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, 0);
+    if (p == MAP_FAILED)
+        return false;
+    hdr_ = static_cast<ShmRingHeader*>(p);
+    cap_ = (size_t)hdr_->capacity;
+    if (hdr_->magic != ShmRingHeader::kMagic || hdr_->version != ShmRingHeader::kVersion ||
+        cap_ == 0 || (cap_ & (cap_ - 1)) != 0 || kShmDataOffset + cap_ > map_len_) {
+        ::munmap(p, map_len_);
+        hdr_ = nullptr;
+        return false;
+    }
+    data_ = static_cast<const uint8_t*>(p) + kShmDataOffset;
+    return true;
+}
+
+size_t ShmRingReader::available() const {
+    const uint64_t head = hdr_->head.load(std::memory_order_acquire);
+    const uint64_t tail = hdr_->tail.load(std::memory_order_relaxed);
+    return (size_t)(head - tail);
+}
+
+size_t ShmRingReader::read(void* p, size_t n) {
+    const uint64_t head = hdr_->head.load(std::memory_order_acquire);
+    const uint64_t tail = hdr_->tail.load(std::memory_order_relaxed);
+    n = std::min(n, (size_t)(head - tail));
+    if (n == 0)
+        return 0;
+    const size_t off = (size_t)tail & (cap_ - 1);
+    const size_t first = std::min(n, cap_ - off);
+    std::memcpy(p, data_ + off, first);
+    if (n > first)
+        std::memcpy(static_cast<uint8_t*>(p) + first, data_, n - first);
+    hdr_->tail.store(tail + n, std::memory_order_release);
+    return n;
+}
+
+bool ShmRingReader::writer_closed() const {
+    return hdr_->writer_closed.load(std::memory_order_acquire) != 0;
+}
+
+bool ShmRingReader::wait(int timeout_ms, int also_fd) {
+    if (available() > 0 || writer_closed())
+        return true;
+    hdr_->reader_waiting.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (available() > 0 || writer_closed()) {
+        hdr_->reader_waiting.store(0, std::memory_order_relaxed);
+        return true;
+    }
+    struct pollfd pfd[2];
+    pfd[0] = {bell_fd_, POLLIN, 0};
+    pfd[1] = {also_fd, POLLIN, 0};
+    int rc;
+    do {
+        rc = ::poll(pfd, also_fd >= 0 ? 2 : 1, timeout_ms);
+    } while (rc < 0 && errno == EINTR);
+    if (rc > 0 && (pfd[0].revents & POLLIN)) {
+        uint8_t drain[64];
+        while (::read(bell_fd_, drain, sizeof(drain)) > 0) {
+        }
+    }
+    hdr_->reader_waiting.store(0, std::memory_order_relaxed);
+    return rc > 0;
+}
+
+} // namespace uma::ipc
@@ -0,0 +1,118 @@
+// UMA Serve - Shared-memory SPSC byte ring (same-host token transport)
+#pragma once
+
+#include "ipc/tx_queue.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace uma::ipc {
+
+// Layout of the shared mapping: this header, then `capacity` data bytes at kShmDataOffset.
+// head/tail are monotonically increasing byte counts (position = count & (capacity - 1)),
+// so the ring is full when head - tail == capacity. Each counter is written by one side
+// only and sits on its own cache line.
+//
+// Wakeups: a reader that finds the ring empty sets reader_waiting, re-checks head and then
+// blocks on the doorbell fd. The writer publishes head, then rings the doorbell only if
+// reader_waiting was set, so a busy reader costs the writer no syscalls.
+struct ShmRingHeader {
+    static constexpr uint32_t kMagic = 0x554d4152; // "UMAR"
+    static constexpr uint32_t kVersion = 1;
+
+    uint32_t magic = kMagic;
+    uint32_t version = kVersion;
+    uint64_t capacity = 0; // power of two
+    alignas(64) std::atomic<uint64_t> head{0};           // bytes produced (writer)
+    alignas(64) std::atomic<uint64_t> tail{0};           // bytes consumed (reader)
+    alignas(64) std::atomic<uint32_t> reader_waiting{0}; // reader is (about to be) blocked
+    std::atomic<uint32_t> writer_closed{0};              // no more bytes will be produced
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared ring needs lock-free atomics");
+
+constexpr size_t kShmDataOffset = 256;
+static_assert(sizeof(ShmRingHeader) <= kShmDataOffset, "ring header too large");
+
+// Server side: owns the shared memory and the doorbell. mem_fd()/doorbell_fd() are the
+// descriptors handed to the client (SCM_RIGHTS); the ring carries the same length-prefixed
+// frames the socket would.
+class ShmRingWriter {
+  public:
+    // capacity is rounded up to a power of two (min 4 KiB). nullptr on failure (errno set).
+    static std::unique_ptr<ShmRingWriter> create(size_t capacity);
+    ~ShmRingWriter();
+
+    ShmRingWriter(const ShmRingWriter&) = delete;
+    ShmRingWriter& operator=(const ShmRingWriter&) = delete;
+
+    size_t capacity() const { return cap_; }
+    size_t free_space() const;
+
+    // Copy up to n bytes in (no syscalls); returns bytes written. Publishes them at once.
+    size_t write(const void* p, size_t n);
+    // Move as much of q as fits into the ring (consuming it from q); returns bytes moved.
+    size_t drain(TxQueue& q);
+
+    // The client stored a tail the writer cannot have produced. The ring accepts no more
+    // bytes; the connection must be dropped.
+    bool corrupt() const { return corrupt_; }
+
+    // Ring the doorbell if the reader is waiting. Returns true if a syscall was made.
+    bool notify();
+
+    // Mark the stream finished and wake the reader.
+    void close();
+
+    int mem_fd() const { return mem_fd_; }
+    int doorbell_fd() const { return bell_rx_fd_; }
+
+  private:
+    ShmRingWriter() = default;
+
+    // Free bytes given the client's tail; false if tail is outside [head - cap, head].
+    bool load_free(size_t& free) const;
+
+    ShmRingHeader* hdr_ = nullptr;
+    uint8_t* data_ = nullptr;
+    size_t cap_ = 0;
+    uint64_t head_ = 0; // private copy: the shared head is only ever stored, never trusted
+    bool corrupt_ = false;
+    size_t map_len_ = 0;
+    int mem_fd_ = -1;
+    int bell_tx_fd_ = -1; // written by the server
+    int bell_rx_fd_ = -1; // waited on by the client (same fd when backed by an eventfd)
+};
+
+// Client side: maps a ring received from the server.
+class ShmRingReader {
+  public:
+    ShmRingReader() = default;
+    ~ShmRingReader();
+
+    ShmRingReader(const ShmRingReader&) = delete;
+    ShmRingReader& operator=(const ShmRingReader&) = delete;
+
+    // Takes ownership of both fds. false if the mapping is not a valid ring.
+    bool attach(int mem_fd, int doorbell_fd);
+
+    size_t available() const;
+    // Copy out up to n bytes (no syscalls); returns bytes read.
+    size_t read(void* p, size_t n);
+    bool writer_closed() const;
+
+    // Block until data is available, the writer closed, `also_fd` is readable, or the
+    // timeout expires (-1 = forever). Returns false on timeout.
+    bool wait(int timeout_ms, int also_fd = -1);
+
+  private:
+    ShmRingHeader* hdr_ = nullptr;
+    const uint8_t* data_ = nullptr;
+    size_t cap_ = 0;
+    size_t map_len_ = 0;
+    int mem_fd_ = -1;
+    int bell_fd_ = -1;
+};
+
+} // namespace uma::ipc
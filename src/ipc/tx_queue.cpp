@@ -0,0 +1,146 @@
+// UMA Serve - Per-session TX frame queue (scatter-gather output)
+#include "ipc/tx_queue.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+
+namespace uma::ipc {
+
+void TxQueue::push_owned(size_t n) {
+    if (n == 0)
+        return;
+    // extend a trailing owned segment instead of starting a new one
+    if (segs_.size() > seg_head_ && segs_.back().ext == nullptr) {
+        segs_.back().len += n;
+    } else {
+        segs_.push_back({nullptr, n});
+    }
+    pending_ += n;
+}
+
+void TxQueue::append(const void* p, size_t n) {
+    bytes_.append(p, n);
+    push_owned(n);
+}
+
+void TxQueue::commit(size_t n) {
+    bytes_.commit(n);
+    push_owned(n);
+}
+
+void TxQueue::append_shared(const void* p, size_t n) {
+    if (n == 0)
+        return;
+    segs_.push_back({static_cast<const uint8_t*>(p), n});
+    pending_ += n;
+}
+
+int TxQueue::fill_iov(struct iovec* iov, int max_iov) const {
+    int cnt = 0;
+    const uint8_t* owned = bytes_.data();
+    for (size_t i = seg_head_; i < segs_.size() && cnt < max_iov; ++i) {
+        const Seg& sg = segs_[i];
+        if (sg.ext) {
+            iov[cnt].iov_base = const_cast<uint8_t*>(sg.ext);
+        } else {
+            iov[cnt].iov_base = const_cast<uint8_t*>(owned);
+            owned += sg.len;
+        }
+        iov[cnt].iov_len = sg.len;
+        ++cnt;
+    }
+    return cnt;
+}
+
+void TxQueue::consume(size_t n) {
+    n = std::min(n, pending_);
+    pending_ -= n;
+    consumed_ += n;
+    if (!retained_.empty()) {
+        size_t done = 0;
+        while (done < retained_.size() && retained_[done].until <= consumed_)
+            ++done;
+        retained_.erase(retained_.begin(), retained_.begin() + (ptrdiff_t)done);
+    }
+    while (n > 0 && seg_head_ < segs_.size()) {
+        Seg& sg = segs_[seg_head_];
+        const size_t take = std::min(n, sg.len);
+        if (sg.ext) {
+            sg.ext += take;
+        } else {
+            bytes_.consume(take);
+        }
+        sg.len -= take;
+        n -= take;
+        if (sg.len == 0)
+            ++seg_head_;
+    }
+    if (seg_head_ == segs_.size()) {
+        segs_.clear(); // keeps capacity
+        seg_head_ = 0;
+    } else if (seg_head_ >= 64 && seg_head_ * 2 >= segs_.size()) {
+        segs_.erase(segs_.begin(), segs_.begin() + (ptrdiff_t)seg_head_);
+        seg_head_ = 0;
+    }
+}
+
+ssize_t TxQueue::write_to(int fd) {
+    struct iovec iov[kMaxIov];
+    const int cnt = fill_iov(iov, kMaxIov);
+    if (cnt == 0)
+        return 0;
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = cnt;
+#ifdef MSG_NOSIGNAL
+    ssize_t w = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+#else
+    ssize_t w = ::sendmsg(fd, &msg, 0); // macOS: sockets carry SO_NOSIGPIPE instead
+#endif
+    if (w > 0)
+        consume((size_t)w);
+    return w;
+}
+
+void TxQueue::own_all() {
+    bool any_shared = false;
+    for (size_t i = seg_head_; i < segs_.size(); ++i)
+        any_shared |= segs_[i].ext != nullptr;
+    if (!any_shared)
+        return;
+    ByteBuffer flat;
+    const uint8_t* owned = bytes_.data();
+    for (size_t i = seg_head_; i < segs_.size(); ++i) {
+        const Seg& sg = segs_[i];
+        if (sg.ext) {
+            flat.append(sg.ext, sg.len);
+        } else {
+            flat.append(owned, sg.len);
+            owned += sg.len;
+        }
+    }
+    bytes_ = std::move(flat);
+    segs_.clear();
+    seg_head_ = 0;
+    segs_.push_back({nullptr, pending_});
+    retained_.clear();
+}
+
+void TxQueue::retain(std::shared_ptr<const std::string> buf) {
+    if (pending_ == 0 || !buf)
+        return;
+    retained_.push_back({consumed_ + pending_, std::move(buf)});
+}
+
+void TxQueue::clear() {
+    bytes_.clear();
+    segs_.clear();
+    seg_head_ = 0;
+    pending_ = 0;
+    retained_.clear();
+}
+
+} // namespace uma::ipc
@@ -0,0 +1,90 @@
+// UMA Serve - Per-session TX frame queue (scatter-gather output)
+#pragma once
+
+#include "ipc/byte_buffer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <vector>
+
+namespace uma::ipc {
+
+// Ordered queue of output segments for one client. A segment is either owned (its bytes
+// live in the queue's ByteBuffer, in FIFO order) or shared (points at caller-owned bytes,
+// e.g. a request's pre-rendered token-event prefix). fill_iov() exposes the pending
+// segments as an iovec array so a flush is a single writev/sendmsg.
+//
+// Shared segments are not copied: the referenced bytes must stay alive and unchanged
+// until the queue has been drained past them.
+class TxQueue {
+  public:
+    // Max segments exposed per fill_iov() call (well under IOV_MAX on Linux/macOS).
+    static constexpr int kMaxIov = 64;
+
+    bool empty() const { return pending_ == 0; }
+    size_t size() const { return pending_; }
+
+    // Copy bytes into the queue.
+    void append(const void* p, size_t n);
+    void append(std::string_view s) { append(s.data(), s.size()); }
+
+    // Reserve/commit owned bytes in place (see ByteBuffer::prepare/commit).
+    uint8_t* prepare(size_t n) { return bytes_.prepare(n); }
+    void commit(size_t n);
+
+    // Patch already-queued owned bytes: `off` counts from the start of the owned bytes
+    // still pending (owned_size() before the bytes were appended).
+    uint8_t* owned_at(size_t off) { return bytes_.mutable_data() + off; }
+    size_t owned_size() const { return bytes_.size(); }
+
+    // Reference bytes owned by the caller (no copy).
+    void append_shared(const void* p, size_t n);
+
+    // Fill up to max_iov entries describing the front of the queue; returns the count.
+    int fill_iov(struct iovec* iov, int max_iov) const;
+
+    // Drop n bytes from the front (after a successful write of n bytes).
+    void consume(size_t n);
+
+    // Copy every pending shared segment into owned storage, releasing all references to
+    // caller-owned bytes (used before such bytes are replaced while output is pending).
+    void own_all();
+
+    // Keep `buf` alive until every byte queued so far has been consumed. For shared bytes
+    // whose owner goes away first (a request retired with its token events still queued):
+    // no copy, and released as soon as the queue drains past them.
+    void retain(std::shared_ptr<const std::string> buf);
+
+    // One writev-style flush attempt (sendmsg with MSG_NOSIGNAL where available).
+    // Returns bytes written and consumes them, or -1 with errno set.
+    ssize_t write_to(int fd);
+
+    void clear();
+
+  private:
+    struct Seg {
+        const uint8_t* ext = nullptr; // nullptr => owned bytes in bytes_
+        size_t len = 0;
+    };
+
+    void push_owned(size_t n);
+
+    struct Retained {
+        uint64_t until = 0; // consumed_ at which the last byte referencing buf is gone
+        std::shared_ptr<const std::string> buf;
+    };
+
+    ByteBuffer bytes_;
+    std::vector<Seg> segs_;
+    size_t seg_head_ = 0;
+    size_t pending_ = 0;
+    uint64_t consumed_ = 0; // bytes consumed over the queue's lifetime
+    std::vector<Retained> retained_; // in `until` order
+};
+
+} // namespace uma::ipc
@@ -6,6 +6,7 @@
 #include <cstring>
 #include <fcntl.h>
 #include <iostream>
+#include <poll.h>
 #include <string>
 #include <sys/socket.h>
 #include <sys/stat.h>
@@ -119,4 +120,69 @@ void UDSServer::close_listen() {
     close_socket_();
 }
 
+ssize_t UDSServer::send_with_fds(int sock, const void* data, size_t len, const int* fds,
+                                 int nfds) {
+    if (nfds < 0 || nfds > kMaxPassFds) {
+        errno = EINVAL;
+        return -1;
+    }
+    iovec iov{const_cast<void*>(data), len};
+    alignas(cmsghdr) char ctrl[CMSG_SPACE(sizeof(int) * kMaxPassFds)];
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (nfds > 0) {
+        std::memset(ctrl, 0, sizeof(ctrl));
+        msg.msg_control = ctrl;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+        cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_RIGHTS;
+        cm->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+        std::memcpy(CMSG_DATA(cm), fds, sizeof(int) * nfds);
+    }
+#ifdef MSG_NOSIGNAL
+    return ::sendmsg(sock, &msg, MSG_NOSIGNAL);
+#else
+    return ::sendmsg(sock, &msg, 0);
+#endif
+}
+
+ssize_t UDSServer::recv_with_fds(int sock, void* data, size_t len, int* fds, int max_fds,
+                                 int* nfds) {
+    *nfds = 0;
+    iovec iov{data, len};
+    alignas(cmsghdr) char ctrl[CMSG_SPACE(sizeof(int) * kMaxPassFds)];
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+    ssize_t n = ::recvmsg(sock, &msg, 0);
+    if (n < 0)
+        return n;
+    for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+        if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS)
+            continue;
+        const int cnt = (int)((cm->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        const int* in = reinterpret_cast<const int*>(CMSG_DATA(cm));
+        for (int i = 0; i < cnt; ++i) {
+            int fd;
+            std::memcpy(&fd, in + i, sizeof(int));
+            if (*nfds < max_fds)
+                fds[(*nfds)++] = fd;
+            else
+                ::close(fd); // caller did not ask for this many
+        }
+    }
+    return n;
+}
+
+bool UDSServer::peer_closed(int sock) {
+    // stream sockets raise POLLHUP only when both directions are shut (peer gone); a
+    // half-close shows up as EOF on read alone
+    pollfd p{sock, POLLOUT, 0};
+    return ::poll(&p, 1, 0) == 1 && (p.revents & (POLLHUP | POLLERR)) != 0;
+}
+
 } // namespace uma::ipc
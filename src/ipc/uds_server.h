@@ -2,8 +2,10 @@
 #pragma once
 
 #include <atomic>
+#include <cstddef>
 #include <functional>
 #include <string>
+#include <sys/types.h>
 
 namespace uma::ipc {
 
@@ -22,6 +24,20 @@ public:
     int  fd() const { return listen_fd_; }
     void close_listen();
 
+    // Send bytes with descriptors attached (SCM_RIGHTS, at most kMaxPassFds). Returns bytes
+    // sent or -1 with errno set. The descriptors travel with the first byte.
+    static ssize_t send_with_fds(int sock, const void* data, size_t len, const int* fds,
+                                 int nfds);
+    // Receive up to len bytes plus any attached descriptors (stored in fds, count in
+    // *nfds). Returns bytes received, 0 on EOF, or -1 with errno set.
+    static ssize_t recv_with_fds(int sock, void* data, size_t len, int* fds, int max_fds,
+                                 int* nfds);
+    static constexpr int kMaxPassFds = 4;
+
+    // True once the peer has closed its end entirely and can no longer read. A peer that
+    // only shut down its write side (sent its requests, still reading) is not closed.
+    static bool peer_closed(int sock);
+
 private:
     std::string path_;
     unsigned mode_;
@@ -16,6 +16,28 @@ double Metrics::get_decode_ms_ewma() const {
     return decode_ms_ewma_x1000.load(std::memory_order_relaxed) / 1000.0;
 }
 
+void Metrics::set_cost_model(double fixed_ms, double decode_ms, double prefill_ms,
+                             double kv_ms_per_k, double error_ms, uint64_t samples) {
+    cost_fixed_ns.store((int64_t)(fixed_ms * 1.0e6), std::memory_order_relaxed);
+    cost_decode_ns.store((int64_t)(decode_ms * 1.0e6), std::memory_order_relaxed);
+    cost_prefill_ns.store((int64_t)(prefill_ms * 1.0e6), std::memory_order_relaxed);
+    cost_kv_ns.store((int64_t)(kv_ms_per_k * 1.0e6), std::memory_order_relaxed);
+    cost_error_ns.store((uint64_t)(error_ms > 0 ? error_ms * 1.0e6 : 0), std::memory_order_relaxed);
+    cost_samples.store(samples, std::memory_order_relaxed);
+}
+
+std::string Histogram::to_json() const {
+    std::ostringstream oss;
+    oss << "{\"le\":[";
+    for (size_t i = 0; i + 1 < kBuckets; ++i)
+        oss << (i ? "," : "") << ((uint64_t(1) << i) - 1);
+    oss << "],\"counts\":[";
+    for (size_t i = 0; i < kBuckets; ++i)
+        oss << (i ? "," : "") << counts[i].load(std::memory_order_relaxed);
+    oss << "]}";
+    return oss.str();
+}
+
 static void json_escape(std::ostringstream &oss, const std::string &s) {
     for (unsigned char c : s) {
         switch (c) {
@@ -34,6 +56,21 @@ static void json_escape(std::ostringstream &oss, const std::string &s) {
     }
 }
 
+std::string LaneMetrics::to_json() const {
+    std::ostringstream oss;
+    oss << "{\"tokens_total\":" << tokens_total.load(std::memory_order_relaxed)
+        << ",\"tbt_ms_mean\":";
+    const uint64_t n = tbt_samples.load(std::memory_order_relaxed);
+    if (n == 0) {
+        oss << 0.0;
+    } else {
+        long double ns = static_cast<long double>(tbt_ns_total.load(std::memory_order_relaxed));
+        oss << std::fixed << std::setprecision(3) << static_cast<double>((ns / n) / 1.0e6L);
+    }
+    oss << ",\"tbt_ms_hist\":" << tbt_ms.to_json() << '}';
+    return oss.str();
+}
+
 std::string Metrics::to_json(uint32_t active_sessions, bool debug) const {
     std::ostringstream oss;
     oss << '{'
@@ -137,6 +174,85 @@ std::string Metrics::to_json(uint32_t active_sessions, bool debug) const {
         }
     }
     oss << ','
+        << "\"tx_syscalls_total\":" << tx_syscalls_total.load(std::memory_order_relaxed) << ','
+        << "\"tx_bytes_total\":" << tx_bytes_total.load(std::memory_order_relaxed) << ','
+        << "\"tx_flush_batches_total\":" << tx_flush_batches_total.load(std::memory_order_relaxed) << ','
+        << "\"shm_bytes_total\":" << shm_bytes_total.load(std::memory_order_relaxed) << ','
+        << "\"shm_doorbells_total\":" << shm_doorbells_total.load(std::memory_order_relaxed) << ','
+        << "\"coalesced_frames_total\":" << coalesced_frames_total.load(std::memory_order_relaxed) << ','
+        << "\"coalesced_tokens_total\":" << coalesced_tokens_total.load(std::memory_order_relaxed) << ','
+        << "\"tx_parks_total\":" << tx_parks_total.load(std::memory_order_relaxed) << ','
+        << "\"parked_sessions\":" << parked_sessions.load(std::memory_order_relaxed) << ','
+        << "\"tx_buffered_bytes\":" << tx_buffered_bytes.load(std::memory_order_relaxed) << ','
+        << "\"tokens_per_tx_syscall\":";
+    {
+        uint64_t sc = tx_syscalls_total.load(std::memory_order_relaxed);
+        if (sc == 0) {
+            oss << 0.0;
+        } else {
+            long double toks = static_cast<long double>(tokens_generated_total.load(std::memory_order_relaxed));
+            oss << std::fixed << std::setprecision(3) << static_cast<double>(toks / static_cast<long double>(sc));
+        }
+    }
+    oss << ','
+        << "\"tokenize_jobs_total\":" << tokenize_jobs_total.load(std::memory_order_relaxed) << ','
+        << "\"tokenize_queue_depth\":" << tokenize_queue_depth.load(std::memory_order_relaxed) << ','
+        << "\"tokenize_ms_max\":" << tokenize_ms_max.load(std::memory_order_relaxed) << ','
+        << "\"tokenize_ms_mean\":";
+    {
+        uint64_t jobs = tokenize_jobs_total.load(std::memory_order_relaxed);
+        if (jobs == 0) {
+            oss << 0.0;
+        } else {
+            long double ns = static_cast<long double>(tokenize_ns_total.load(std::memory_order_relaxed));
+            oss << std::fixed << std::setprecision(3) << static_cast<double>((ns / jobs) / 1.0e6L);
+        }
+    }
+    oss << ','
+        << "\"admission_queue_depth\":" << admission_queue_depth.load(std::memory_order_relaxed) << ','
+        << "\"admission_queue_depth_background\":" << admission_queue_depth_background.load(std::memory_order_relaxed) << ','
+        << "\"admission_queued_total\":" << admission_queued_total.load(std::memory_order_relaxed) << ','
+        << "\"admission_rejected_total\":" << admission_rejected_total.load(std::memory_order_relaxed) << ','
+        << "\"admission_shed_total\":" << admission_shed_total.load(std::memory_order_relaxed) << ','
+        << "\"connections_rejected_total\":" << connections_rejected_total.load(std::memory_order_relaxed) << ','
+        << "\"cancelled_requests_total\":" << cancelled_requests_total.load(std::memory_order_relaxed) << ','
+        << "\"cancelled_tokens_saved\":" << cancelled_tokens_saved.load(std::memory_order_relaxed) << ','
+        << "\"prefill_guard_active\":" << (int) prefill_guard_active.load(std::memory_order_relaxed) << ','
+        << "\"ticks_over_budget\":" << ticks_over_budget.load(std::memory_order_relaxed) << ','
+        << "\"skipped_prefill_due_to_latency_total\":" << skipped_prefill_due_to_latency_total.load(std::memory_order_relaxed) << ','
+        << "\"prefill_guard_trimmed_tokens\":" << prefill_guard_trimmed_tokens.load(std::memory_order_relaxed) << ','
+        << "\"background_decode_throttled_total\":" << background_decode_throttled_total.load(std::memory_order_relaxed) << ','
+        << "\"slo_ttft_total\":" << slo_ttft_total.load(std::memory_order_relaxed) << ','
+        << "\"slo_violations_ttft_total\":" << slo_violations_ttft_total.load(std::memory_order_relaxed) << ','
+        << "\"slo_tbt_total\":" << slo_tbt_total.load(std::memory_order_relaxed) << ','
+        << "\"slo_violations_tbt_total\":" << slo_violations_tbt_total.load(std::memory_order_relaxed) << ','
+        << "\"slo_requests_total\":" << slo_requests_total.load(std::memory_order_relaxed) << ','
+        << "\"slo_requests_met\":" << slo_requests_met.load(std::memory_order_relaxed) << ','
+        << "\"slo_attainment_pct\":";
+    {
+        // share of finished requests that met their SLO (0 before any finished)
+        const uint64_t n = slo_requests_total.load(std::memory_order_relaxed);
+        const uint64_t met = slo_requests_met.load(std::memory_order_relaxed);
+        oss << std::fixed << std::setprecision(3) << (n == 0 ? 0.0 : 100.0 * (double)met / (double)n);
+    }
+    {
+        // step-time model coefficients (ms) and its prediction error
+        auto ms = [](const std::atomic<int64_t>& ns) {
+            return (double)ns.load(std::memory_order_relaxed) / 1.0e6;
+        };
+        oss << ",\"target_batch\":" << target_batch.load(std::memory_order_relaxed)
+            << ",\"cost_model\":{" << std::fixed << std::setprecision(6)
+            << "\"fixed_ms\":" << ms(cost_fixed_ns)
+            << ",\"decode_ms_per_token\":" << ms(cost_decode_ns)
+            << ",\"prefill_ms_per_token\":" << ms(cost_prefill_ns)
+            << ",\"kv_ms_per_1k_positions\":" << ms(cost_kv_ns)
+            << ",\"error_ms\":" << (double)cost_error_ns.load(std::memory_order_relaxed) / 1.0e6
+            << ",\"samples\":" << cost_samples.load(std::memory_order_relaxed) << '}';
+    }
+    oss << ','
+        << "\"lanes\":{\"interactive\":" << lanes[0].to_json() << ",\"background\":" << lanes[1].to_json() << "},"
+        << "\"admission_wait_ms_hist\":" << admission_wait_ms.to_json() << ','
+        << "\"admission_depth_hist\":" << admission_depth.to_json() << ','
         << "\"active_sessions\":" << active_sessions;
     if (debug) {
         oss << ','
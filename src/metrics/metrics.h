@@ -2,11 +2,46 @@
 #pragma once
 
 #include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <string>
 
 namespace uma::metrics {
 
+// Lock-free histogram with power-of-two buckets: bucket 0 counts 0, bucket i counts values in
+// [2^(i-1), 2^i), and the last bucket counts everything from 2^(kBuckets-2) up.
+struct Histogram {
+    static constexpr size_t kBuckets = 16;
+    std::atomic<uint64_t> counts[kBuckets] = {};
+
+    void observe(uint64_t v) {
+        size_t b = 0;
+        while (v != 0 && b + 1 < kBuckets) {
+            v >>= 1;
+            ++b;
+        }
+        counts[b].fetch_add(1, std::memory_order_relaxed);
+    }
+    // {"le":[0,1,3,...],"counts":[...]}: inclusive upper bounds of all but the last bucket
+    std::string to_json() const;
+};
+
+// Generation in one QoS lane: tokens out and the gaps between a request's tokens.
+struct LaneMetrics {
+    std::atomic<uint64_t> tokens_total{0};
+    std::atomic<uint64_t> tbt_ns_total{0};
+    std::atomic<uint64_t> tbt_samples{0};
+    Histogram tbt_ms;
+
+    void observe_tbt(uint64_t gap_ns) {
+        tbt_ns_total.fetch_add(gap_ns, std::memory_order_relaxed);
+        tbt_samples.fetch_add(1, std::memory_order_relaxed);
+        tbt_ms.observe(gap_ns / 1000000);
+    }
+    // {"tokens_total":..,"tbt_ms_mean":..,"tbt_ms_hist":{...}}
+    std::string to_json() const;
+};
+
 struct Metrics {
     // counters
     std::atomic<uint64_t> tokens_generated_total{0};
@@ -47,6 +82,67 @@ struct Metrics {
     std::atomic<uint64_t> eval_calls{0};
     std::atomic<uint64_t> p_eval_calls{0};
 
+    // TX path: socket write syscalls vs. flushed bytes (per-token syscall cost)
+    std::atomic<uint64_t> tx_syscalls_total{0};
+    std::atomic<uint64_t> tx_bytes_total{0};
+    std::atomic<uint64_t> tx_flush_batches_total{0}; // post-tick flushes that sent anything
+    std::atomic<uint64_t> shm_bytes_total{0};        // event bytes delivered via shm rings
+    std::atomic<uint64_t> shm_doorbells_total{0};    // doorbell syscalls (reader was waiting)
+    std::atomic<uint64_t> coalesced_frames_total{0}; // "tokens" events (>1 token per frame)
+    std::atomic<uint64_t> coalesced_tokens_total{0}; // tokens carried by those events
+    // Backpressure: parks counted when they happen; gauges refreshed at snapshot time
+    std::atomic<uint64_t> tx_parks_total{0};
+    std::atomic<uint32_t> parked_sessions{0};
+    std::atomic<uint64_t> tx_buffered_bytes{0};
+
+    // Off-loop tokenization (latency is submit -> picked up by the event loop)
+    std::atomic<uint64_t> tokenize_jobs_total{0};
+    std::atomic<uint64_t> tokenize_ns_total{0};
+    std::atomic<uint32_t> tokenize_ms_max{0};
+    std::atomic<uint32_t> tokenize_queue_depth{0}; // jobs submitted but not yet completed
+
+    // Admission queue (requests waiting for a sequence slot) and load shedding
+    std::atomic<uint64_t> admission_queued_total{0};   // requests that had to wait
+    std::atomic<uint64_t> admission_rejected_total{0}; // E_OVERLOADED: queue (or class) full
+    std::atomic<uint64_t> admission_shed_total{0};     // E_OVERLOADED: predicted wait too long
+    std::atomic<uint64_t> connections_rejected_total{0}; // E_OVERLOADED: over --max-sessions
+    std::atomic<uint32_t> admission_queue_depth{0};    // gauges, refreshed at snapshot time
+    std::atomic<uint32_t> admission_queue_depth_background{0};
+    Histogram admission_wait_ms;  // time queued before getting a slot
+    Histogram admission_depth;    // queue depth found by each request that had to wait
+
+    // Cancellation (cancel frames and clients that hung up mid-request)
+    std::atomic<uint64_t> cancelled_requests_total{0};
+    std::atomic<uint64_t> cancelled_tokens_saved{0}; // prompt + generation budget not decoded
+
+    // Prefill guard (LatencyGuard): ticks over the step budget and prefill it held back
+    std::atomic<uint64_t> ticks_over_budget{0};
+    std::atomic<uint64_t> skipped_prefill_due_to_latency_total{0}; // ticks with prefill trimmed
+    std::atomic<uint64_t> prefill_guard_trimmed_tokens{0};
+    std::atomic<uint8_t> prefill_guard_active{0}; // holding or ramping prefill back up
+    std::atomic<uint64_t> background_decode_throttled_total{0}; // decode tokens held back
+
+    // SLO attainment against each request's own targets (slo.target_ttft_ms / target_tbt_ms)
+    std::atomic<uint64_t> slo_ttft_total{0};            // first tokens
+    std::atomic<uint64_t> slo_violations_ttft_total{0}; // ... later than the TTFT target
+    std::atomic<uint64_t> slo_tbt_total{0};             // gaps between tokens
+    std::atomic<uint64_t> slo_violations_tbt_total{0};  // ... longer than the TBT target
+    std::atomic<uint64_t> slo_requests_total{0};        // requests that ran to EOS
+    std::atomic<uint64_t> slo_requests_met{0};          // ... within TTFT and mean TBT
+
+    // Step-time model (sched::StepCost) after the last tick, in ns fixed point; signed,
+    // since a coefficient can dip below zero while the fit settles
+    std::atomic<int64_t> cost_fixed_ns{0};     // per tick
+    std::atomic<int64_t> cost_decode_ns{0};    // per decode token
+    std::atomic<int64_t> cost_prefill_ns{0};   // per prompt token
+    std::atomic<int64_t> cost_kv_ns{0};        // per 1000 attended KV positions
+    std::atomic<uint64_t> cost_error_ns{0};    // mean absolute prediction error (EWMA)
+    std::atomic<uint64_t> cost_samples{0};     // ticks observed
+    std::atomic<uint32_t> target_batch{0};     // token budget the model sized for the tick
+
+    // QoS lanes, indexed by ipc::RequestClass (0 = interactive, 1 = background)
+    LaneMetrics lanes[2];
+
     // ΣBMT guard observability (experimental)
     std::atomic<uint64_t> bmt_units_last{0};
     std::atomic<uint64_t> bmt_budget_units{0};
@@ -56,6 +152,9 @@ struct Metrics {
     // Write EWMA (ms) in fixed-point x1000
     void set_decode_ms_ewma(double ms);
     double get_decode_ms_ewma() const;
+    // Publish the step-time model (ms in, ns fixed point stored)
+    void set_cost_model(double fixed_ms, double decode_ms, double prefill_ms, double kv_ms_per_k,
+                        double error_ms, uint64_t samples);
 
     // Snapshot to compact JSON string
     // active_sessions is provided by caller at snapshot time
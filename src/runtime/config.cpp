@@ -37,16 +37,52 @@ RuntimeConfig RuntimeConfig::from_args(int argc, char** argv) {
         cfg.n_ubatch = static_cast<uint32_t>(std::strtoul(ub, nullptr, 10));
     if (auto* sp = get_env("UMA_SOCK"))
         cfg.socket_path = sp;
+    if (auto* v = get_env("UMA_IO_ENGINE"))
+        cfg.io_engine = v;
+    if (auto* v = get_env("UMA_TOKENIZER_THREADS"))
+        cfg.tokenizer_threads = (uint32_t)std::strtoul(v, nullptr, 10);
+    if (auto* v = get_env("UMA_TOKENIZE_INLINE_BYTES"))
+        cfg.tokenize_inline_bytes = (uint32_t)std::strtoul(v, nullptr, 10);
+    if (auto* v = get_env("UMA_MAX_INFLIGHT_PER_CONN"))
+        cfg.max_inflight_per_conn = (uint32_t)std::strtoul(v, nullptr, 10);
+    if (auto* v = get_env("UMA_SHM_RING_BYTES"))
+        cfg.shm_ring_bytes = (uint32_t)std::strtoul(v, nullptr, 10);
+    if (auto* v = get_env("UMA_COALESCE_BACKLOG_BYTES"))
+        cfg.coalesce_backlog_bytes = (uint32_t)std::strtoul(v, nullptr, 10);
+    if (auto* v = get_env("UMA_TX_HIGH_WATER_BYTES"))
+        cfg.tx_high_water_bytes = (uint32_t)std::strtoul(v, nullptr, 10);
+    if (auto* v = get_env("UMA_TX_LOW_WATER_BYTES"))
+        cfg.tx_low_water_bytes = (uint32_t)std::strtoul(v, nullptr, 10);
+    if (auto* v = get_env("UMA_ADMISSION_QUEUE_DEPTH"))
+        cfg.admission_queue_depth = (uint32_t)std::strtoul(v, nullptr, 10);
+    if (auto* v = get_env("UMA_ADMISSION_QUEUE_BACKGROUND"))
+        cfg.admission_queue_background = (uint32_t)std::strtoul(v, nullptr, 10);
+    if (auto* v = get_env("UMA_ADMISSION_TTFT_SLACK"))
+        cfg.admission_ttft_slack = std::strtod(v, nullptr);
     if (auto* v = get_env("UMA_N_SEQ"))
         cfg.n_seq_max = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
     if (auto* v = get_env("UMA_USE_MMAP"))
         cfg.use_mmap = parse_bool_flag(v);
+    if (auto* v = get_env("UMA_COMPUTE_THREAD"))
+        cfg.compute_thread = parse_bool_flag(v);
     if (auto* v = get_env("UMA_USE_MLOCK"))
         cfg.use_mlock = parse_bool_flag(v);
     if (auto* v = get_env("UMA_SLO_TTFT_MS"))
         cfg.slo_ttft_ms = (uint32_t)std::strtoul(v, nullptr, 10);
     if (auto* v = get_env("UMA_SLO_TBT_MS"))
         cfg.slo_tbt_ms = (uint32_t)std::strtoul(v, nullptr, 10);
+    if (auto* v = get_env("UMA_PREFILL_GUARD"))
+        cfg.prefill_guard = parse_bool_flag(v);
+    if (auto* v = get_env("UMA_GUARD_HOLD_TICKS"))
+        cfg.guard_hold_ticks = (uint32_t)std::strtoul(v, nullptr, 10);
+    if (auto* v = get_env("UMA_GUARD_RAMP_TICKS"))
+        cfg.guard_ramp_ticks = (uint32_t)std::strtoul(v, nullptr, 10);
+    if (auto* v = get_env("UMA_POLICY"))
+        cfg.sched_policy = v;
+    if (auto* v = get_env("UMA_SRPT_AGING"))
+        cfg.srpt_aging_tok_per_s = std::strtod(v, nullptr);
+    if (auto* v = get_env("UMA_INTERACTIVE_SHARE"))
+        cfg.interactive_share = std::strtod(v, nullptr);
     if (auto* v = get_env("UMA_BMT_BUDGET")) {
         // dimensionless token-attention units (uint64)
         cfg.bmt_budget_units = (uint64_t) std::strtoull(v, nullptr, 10);
@@ -85,19 +121,75 @@ RuntimeConfig RuntimeConfig::from_args(int argc, char** argv) {
             cfg.use_mlock = true;
         } else if (arg == "--no-mlock") {
             cfg.use_mlock = false;
+        } else if (arg == "--no-compute-thread") {
+            cfg.compute_thread = false;
+        } else if (arg == "--compute-thread") {
+            cfg.compute_thread = true;
         } else if (arg == "--no-mmap") {
             cfg.use_mmap = false;
         } else if (arg == "--mmap") {
             cfg.use_mmap = true;
         } else if (arg == "--sock" || arg == "--socket") {
             cfg.socket_path = need("--socket");
+        } else if (arg == "--io-engine") {
+            cfg.io_engine = need("--io-engine");
+        } else if (arg == "--shm-ring-bytes") {
+            cfg.shm_ring_bytes =
+                    static_cast<uint32_t>(std::strtoul(need("--shm-ring-bytes"), nullptr, 10));
+        } else if (arg == "--coalesce-backlog-bytes") {
+            cfg.coalesce_backlog_bytes = static_cast<uint32_t>(
+                    std::strtoul(need("--coalesce-backlog-bytes"), nullptr, 10));
+        } else if (arg == "--tx-high-water-bytes") {
+            cfg.tx_high_water_bytes = static_cast<uint32_t>(
+                    std::strtoul(need("--tx-high-water-bytes"), nullptr, 10));
+        } else if (arg == "--tx-low-water-bytes") {
+            cfg.tx_low_water_bytes = static_cast<uint32_t>(
+                    std::strtoul(need("--tx-low-water-bytes"), nullptr, 10));
+        } else if (arg == "--max-inflight-per-conn") {
+            cfg.max_inflight_per_conn = static_cast<uint32_t>(
+                    std::strtoul(need("--max-inflight-per-conn"), nullptr, 10));
+        } else if (arg == "--tokenizer-threads") {
+            cfg.tokenizer_threads = static_cast<uint32_t>(
+                    std::strtoul(need("--tokenizer-threads"), nullptr, 10));
+        } else if (arg == "--tokenize-inline-bytes") {
+            cfg.tokenize_inline_bytes = static_cast<uint32_t>(
+                    std::strtoul(need("--tokenize-inline-bytes"), nullptr, 10));
         } else if (arg == "--max-sessions") {
             cfg.max_sessions =
                     static_cast<uint32_t>(std::strtoul(need("--max-sessions"), nullptr, 10));
+        } else if (arg == "--admission-queue-depth") {
+            cfg.admission_queue_depth = static_cast<uint32_t>(
+                    std::strtoul(need("--admission-queue-depth"), nullptr, 10));
+        } else if (arg == "--admission-queue-background") {
+            cfg.admission_queue_background = static_cast<uint32_t>(
+                    std::strtoul(need("--admission-queue-background"), nullptr, 10));
+        } else if (arg == "--admission-ttft-slack") {
+            cfg.admission_ttft_slack = std::strtod(need("--admission-ttft-slack"), nullptr);
         } else if (arg == "--parallel" || arg == "--n-seq-max") {
             cfg.n_seq_max = static_cast<uint32_t>(std::strtoul(need("--parallel"), nullptr, 10));
         } else if (arg == "--max-tokens") {
             cfg.max_tokens = static_cast<uint32_t>(std::strtoul(need("--max-tokens"), nullptr, 10));
+        } else if (arg == "--slo-ttft-ms") {
+            cfg.slo_ttft_ms =
+                    static_cast<uint32_t>(std::strtoul(need("--slo-ttft-ms"), nullptr, 10));
+        } else if (arg == "--slo-tbt-ms") {
+            cfg.slo_tbt_ms = static_cast<uint32_t>(std::strtoul(need("--slo-tbt-ms"), nullptr, 10));
+        } else if (arg == "--prefill-guard") {
+            cfg.prefill_guard = true;
+        } else if (arg == "--no-prefill-guard") {
+            cfg.prefill_guard = false;
+        } else if (arg == "--guard-hold-ticks") {
+            cfg.guard_hold_ticks =
+                    static_cast<uint32_t>(std::strtoul(need("--guard-hold-ticks"), nullptr, 10));
+        } else if (arg == "--guard-ramp-ticks") {
+            cfg.guard_ramp_ticks =
+                    static_cast<uint32_t>(std::strtoul(need("--guard-ramp-ticks"), nullptr, 10));
+        } else if (arg == "--policy") {
+            cfg.sched_policy = need("--policy");
+        } else if (arg == "--srpt-aging") {
+            cfg.srpt_aging_tok_per_s = std::strtod(need("--srpt-aging"), nullptr);
+        } else if (arg == "--interactive-share") {
+            cfg.interactive_share = std::strtod(need("--interactive-share"), nullptr);
         } else if (arg == "--bmt-budget") {
             // experimental: dimensionless token-attention units
             cfg.bmt_budget_units = (uint64_t) std::strtoull(need("--bmt-budget"), nullptr, 10);
@@ -109,6 +201,24 @@ RuntimeConfig RuntimeConfig::from_args(int argc, char** argv) {
         }
     }
 
+    // parking needs a gap between the marks, or a session would flap every tick
+    if (cfg.tx_high_water_bytes > 0 && cfg.tx_low_water_bytes >= cfg.tx_high_water_bytes)
+        cfg.tx_low_water_bytes = cfg.tx_high_water_bytes / 2;
+
+    if (!(cfg.admission_ttft_slack >= 0))
+        cfg.admission_ttft_slack = 0;
+
+    if (!(cfg.interactive_share >= 0))
+        cfg.interactive_share = 0;
+    if (cfg.interactive_share > 1)
+        cfg.interactive_share = 1;
+    if (!(cfg.srpt_aging_tok_per_s >= 0))
+        cfg.srpt_aging_tok_per_s = 0;
+
+    // a zero budget would hold prefill off forever
+    if (cfg.slo_tbt_ms == 0)
+        cfg.prefill_guard = false;
+
     return cfg;
 }
 
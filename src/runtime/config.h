@@ -19,21 +19,66 @@ struct RuntimeConfig {
     // IPC (UDS)
     std::string socket_path = "/tmp/uma.sock"; // UDS path
     uint16_t socket_mode = 0600;               // file mode for socket
+    std::string io_engine = "write";           // TX engine: "write" | "uring" (Linux)
+    // Coalesce token events into "tokens" frames while a session has at least this many
+    // unsent bytes queued (slow reader). 0 disables automatic coalescing.
+    uint32_t coalesce_backlog_bytes = 4096;
+    // Backpressure: a connection whose unsent output reaches tx_high_water_bytes is parked.
+    // Its requests get no decode slots until the client drains the output to
+    // tx_low_water_bytes. A high-water mark of 0 disables parking.
+    uint32_t tx_high_water_bytes = 4u << 20;
+    uint32_t tx_low_water_bytes = 1u << 20;
+    // Default size of a per-connection shared-memory token ring (hello "transport":"shm").
+    uint32_t shm_ring_bytes = 1u << 20;
 
     // Limits (M2)
-    uint32_t max_sessions = 16;
+    uint32_t max_sessions = 16;         // connections
+    uint32_t max_inflight_per_conn = 8; // concurrent requests multiplexed on one connection
     uint32_t max_prompt_bytes = 8192; // per request
     uint32_t max_tokens = 64;         // per request (default small for responsiveness)
     uint32_t idle_timeout_sec = 300;  // close idle sessions
 
+    // Admission: requests beyond the n_seq_max sequence slots wait in a bounded queue.
+    uint32_t admission_queue_depth = 64;      // all classes (0 = reject once slots are full)
+    uint32_t admission_queue_background = 16; // "class":"background" share of the queue
+    // Shed a request whose predicted queue wait exceeds this multiple of its TTFT target
+    // (0 = shed on the depth limits only).
+    double admission_ttft_slack = 4.0;
+
+    // Prompts longer than tokenize_inline_bytes are tokenized on a pool of
+    // tokenizer_threads workers (0 = always tokenize on the event loop).
+    uint32_t tokenizer_threads = 2;
+    uint32_t tokenize_inline_bytes = 1024;
+
     // Scheduling (M3)
+    // Run llama_decode on a dedicated compute thread so the event loop keeps serving sockets
+    // during a decode (false = decode inline on the loop, as before).
+    bool compute_thread = true;
     uint32_t max_merge = 4; // max sessions to merge per tick
     // Max concurrent sequences in llama context (align with llama-server's --parallel)
     uint32_t n_seq_max = 4; // default 4 to match server behavior
 
-    // SLO instrumentation (for future policy)
-    uint32_t slo_ttft_ms = 150; // target TTFT in ms (unused by executor)
-    uint32_t slo_tbt_ms = 80;   // target inter-token budget in ms (unused by executor)
+    // SLO targets
+    uint32_t slo_ttft_ms = 150; // target TTFT in ms (admission shedding)
+    uint32_t slo_tbt_ms = 80;   // target inter-token budget in ms (prefill guard step budget)
+
+    // Prefill guard: trim prefill from ticks predicted to exceed slo_tbt_ms; after a tick
+    // that did exceed it, hold prefill off for guard_hold_ticks and ramp it back over
+    // guard_ramp_ticks.
+    bool prefill_guard = true;
+    uint32_t guard_hold_ticks = 8;
+    uint32_t guard_ramp_ticks = 8;
+
+    // Planning policy: "baseline" (decode-first, TTFT-first prefill, QoS lanes), "srpt"
+    // (baseline with shortest-remaining-prefill-first ordering and an adaptive first-token
+    // burst) or "edf" (earliest deadline first against each request's SLO targets).
+    std::string sched_policy = "baseline";
+    // srpt: remaining-token credit a prompt earns per second of waiting (0 = pure SRPT).
+    double srpt_aging_tok_per_s = 1000.0;
+
+    // QoS lanes: share of each tick's token budget kept for interactive requests while they
+    // have work for it; background requests get the rest (0-1).
+    double interactive_share = 0.5;
 
     // Bandwidth guard (ΣBMT) experimental budget in dimensionless "token-attention units".
     // 0 disables the guard.
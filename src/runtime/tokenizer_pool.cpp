@@ -0,0 +1,92 @@
+// UMA Serve - Off-loop tokenization worker pool
+#include "runtime/tokenizer_pool.h"
+
+#include <utility>
+
+namespace uma::runtime {
+
+TokenizerPool::TokenizerPool(unsigned n_threads, TokenizeFn fn, NotifyFn notify)
+    : fn_(std::move(fn)), notify_(std::move(notify)) {
+    if (n_threads == 0)
+        n_threads = 1;
+    workers_.reserve(n_threads);
+    for (unsigned i = 0; i < n_threads; ++i)
+        workers_.emplace_back([this] { worker(); });
+}
+
+TokenizerPool::~TokenizerPool() {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& t : workers_)
+        t.join();
+    Done* d = done_.exchange(nullptr, std::memory_order_acquire);
+    while (d) {
+        Done* next = d->next;
+        delete d;
+        d = next;
+    }
+}
+
+void TokenizerPool::submit(TokenizeJob job) {
+    depth_.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        jobs_.push_back(std::move(job));
+    }
+    cv_.notify_one();
+}
+
+void TokenizerPool::worker() {
+    for (;;) {
+        TokenizeJob job;
+        {
+            std::unique_lock<std::mutex> lk(mu_);
+            cv_.wait(lk, [this] { return stop_ || !jobs_.empty(); });
+            if (stop_)
+                return;
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+        auto* d = new Done();
+        d->r.sid = job.sid;
+        d->r.submit_ns = job.submit_ns;
+        d->r.tokens = fn_(job.text, job.add_bos, job.special);
+        // Treiber push: the loop takes the whole list at once, so there is no ABA on pop
+        Done* head = done_.load(std::memory_order_relaxed);
+        do {
+            d->next = head;
+        } while (!done_.compare_exchange_weak(head, d, std::memory_order_release,
+                                              std::memory_order_relaxed));
+        if (notify_)
+            notify_();
+    }
+}
+
+size_t TokenizerPool::drain(std::vector<TokenizeResult>& out) {
+    Done* d = done_.exchange(nullptr, std::memory_order_acquire);
+    if (!d)
+        return 0;
+    // the list is newest-first; reverse it to hand results out in completion order
+    Done* prev = nullptr;
+    while (d) {
+        Done* next = d->next;
+        d->next = prev;
+        prev = d;
+        d = next;
+    }
+    size_t n = 0;
+    for (d = prev; d;) {
+        out.push_back(std::move(d->r));
+        Done* next = d->next;
+        delete d;
+        d = next;
+        ++n;
+    }
+    depth_.fetch_sub(n, std::memory_order_relaxed);
+    return n;
+}
+
+} // namespace uma::runtime
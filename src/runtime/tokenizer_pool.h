@@ -0,0 +1,77 @@
+// UMA Serve - Off-loop tokenization worker pool
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace uma::runtime {
+
+struct TokenizeJob {
+    int sid = -1;           // request the tokens belong to
+    uint64_t submit_ns = 0; // event-loop clock at submission
+    bool add_bos = true;
+    bool special = true;
+    std::string text;
+};
+
+struct TokenizeResult {
+    int sid = -1;
+    uint64_t submit_ns = 0;
+    std::vector<int> tokens; // empty if tokenization failed or produced nothing
+};
+
+// Tokenizes prompts on worker threads so large prompts do not stall the event loop.
+// Jobs go to the workers through a mutex/condvar queue (workers block there). Results
+// come back through a lock-free completion list that only the event loop drains. Each
+// publication calls `notify` (e.g. Poller::wake) so a sleeping loop picks it up promptly.
+class TokenizerPool {
+  public:
+    using TokenizeFn = std::function<std::vector<int>(const std::string& text, bool add_bos,
+                                                      bool special)>;
+    using NotifyFn = std::function<void()>;
+
+    TokenizerPool(unsigned n_threads, TokenizeFn fn, NotifyFn notify);
+    ~TokenizerPool(); // stops and joins the workers; unfinished jobs are dropped
+
+    TokenizerPool(const TokenizerPool&) = delete;
+    TokenizerPool& operator=(const TokenizerPool&) = delete;
+
+    void submit(TokenizeJob job);
+
+    // Append every finished result to `out` in completion order; returns how many.
+    // Event-loop thread only.
+    size_t drain(std::vector<TokenizeResult>& out);
+
+    // Submitted but not yet drained.
+    size_t depth() const { return depth_.load(std::memory_order_relaxed); }
+
+  private:
+    struct Done {
+        TokenizeResult r;
+        Done* next = nullptr;
+    };
+
+    void worker();
+
+    TokenizeFn fn_;
+    NotifyFn notify_;
+
+    std::mutex mu_;
+    std::condition_variable cv_;
+    std::deque<TokenizeJob> jobs_;
+    bool stop_ = false;
+    std::vector<std::thread> workers_;
+
+    std::atomic<Done*> done_{nullptr}; // LIFO push by workers, whole-list take by drain()
+    std::atomic<size_t> depth_{0};
+};
+
+} // namespace uma::runtime
@@ -21,6 +21,10 @@ std::vector<int> tokenize(const llama_vocab* vocab, const std::string& text,
     return out;
 }
 
+int32_t n_vocab(const llama_vocab* vocab) {
+    return vocab ? llama_vocab_n_tokens(vocab) : 0;
+}
+
 int token_to_piece(const llama_vocab* vocab, int token_id, char* buf, size_t buf_size,
                    bool special) {
     if (!vocab || !buf || buf_size == 0) return 0;
@@ -1,6 +1,8 @@
 // UMA Serve - Tokenization helpers
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -13,6 +15,9 @@ namespace uma::runtime::tokens {
 std::vector<int> tokenize(const llama_vocab* vocab, const std::string& text,
                           bool add_bos, bool special);
 
+// Vocabulary size (valid ids are [0, n_vocab)); 0 without a vocab.
+int32_t n_vocab(const llama_vocab* vocab);
+
 // Convert token id to UTF-8 piece; returns number of bytes written (0 on none).
 int token_to_piece(const llama_vocab* vocab, int token_id, char* buf, size_t buf_size,
                    bool special = true);
@@ -5,29 +5,37 @@
 
 namespace uma::sched::bmt {
 
-static inline uint64_t sum_arith(uint64_t a0, uint64_t d, uint64_t n) {
-    // Sum of arithmetic progression: n/2 * (2a0 + (n-1)d)
-    return (n * (2 * a0 + (n - 1) * d)) / 2;
-}
-
 uint64_t estimate_units(const uma::ipc::SessionPool& sessions, const Plan& plan) {
     uint64_t total = 0;
     for (const auto& it : plan.items) {
-        auto fnd = sessions.find(it.fd);
-        if (fnd == sessions.end()) continue;
-        const auto& s = *fnd->second;
-        if (it.phase == Phase::DECODE) {
-            // one token; cost ~ (n_past + 1)
-            total += (uint64_t)(s.n_past + 1);
-        } else {
-            // prefill chunk of m tokens at base n_past; sum (base+1 .. base+m)
-            uint64_t base = (uint64_t) s.n_past;
-            uint64_t m = (uint64_t) (it.n_tokens > 0 ? it.n_tokens : 0);
-            total += sum_arith(base + 1, 1, m);
-        }
+        const auto* sp = sessions.find(it.sid);
+        if (!sp) continue;
+        // DECODE: one token, (n_past + 1); PREFILL: sum (n_past+1 .. n_past+m)
+        total += kv_units(sp->hot->n_past, it.phase == Phase::DECODE ? 1 : it.n_tokens);
     }
     return total;
 }
 
+uint64_t trim_to_budget(const uma::ipc::SessionPool& sessions, Plan& plan, uint64_t est,
+                        uint64_t budget, bool& trimmed) {
+    trimmed = false;
+    for (size_t idx = plan.items.size(); idx > 0 && est > budget; --idx) {
+        auto& it = plan.items[idx - 1];
+        if (it.phase != Phase::PREFILL || it.n_tokens <= 0) continue;
+        const auto* sp = sessions.find(it.sid);
+        if (!sp) continue;
+        const uint64_t base = (uint64_t) sp->hot->n_past;
+        // remove tokens from the end of the chunk until under budget
+        while (it.n_tokens > 0 && est > budget) {
+            // cost of last token in chunk m: base + m
+            est -= base + (uint64_t) it.n_tokens;
+            it.n_tokens -= 1;
+            plan.prefill_tok_count -= 1;
+            trimmed = true;
+        }
+    }
+    return est;
+}
+
 } // namespace uma::sched::bmt
 
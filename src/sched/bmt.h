@@ -14,5 +14,12 @@ namespace uma::sched::bmt {
 // - PREFILL chunk cost: sum_{j=0..m-1} (n_past + j + 1)
 uint64_t estimate_units(const uma::ipc::SessionPool& sessions, const Plan& plan);
 
+// Trim PREFILL chunks, last item first, until the plan's estimate is within `budget`.
+// `est` is estimate_units() for the plan as given; returns the estimate after trimming and
+// sets `trimmed` when any token was dropped. Reads n_past straight from the pool, so it
+// must run before the plan is enacted.
+uint64_t trim_to_budget(const uma::ipc::SessionPool& sessions, Plan& plan, uint64_t est,
+                        uint64_t budget, bool& trimmed);
+
 } // namespace uma::sched::bmt
 
@@ -0,0 +1,58 @@
+// UMA Serve - Compute thread (runs llama_decode off the event loop)
+#include "sched/compute_worker.h"
+
+#include <chrono>
+#include <utility>
+
+namespace uma::sched {
+
+ComputeWorker::ComputeWorker(DecodeFn decode, NotifyFn notify)
+    : decode_(std::move(decode)), notify_(std::move(notify)) {
+    thread_ = std::thread([this] { run(); });
+}
+
+ComputeWorker::~ComputeWorker() {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+uint64_t ComputeWorker::submit() {
+    const uint64_t ticket = next_ticket_++;
+    // the scheduler keeps at most one batch in flight, so the ring never fills
+    jobs_.push(ticket);
+    {
+        // taking the lock orders the push before a sleeping worker's re-check
+        std::lock_guard<std::mutex> lk(mu_);
+    }
+    cv_.notify_one();
+    return ticket;
+}
+
+void ComputeWorker::run() {
+    for (;;) {
+        uint64_t ticket = 0;
+        if (!jobs_.pop(ticket)) {
+            std::unique_lock<std::mutex> lk(mu_);
+            cv_.wait(lk, [this] { return stop_ || !jobs_.empty(); });
+            if (stop_)
+                return;
+            continue;
+        }
+        DecodeOutcome out;
+        out.ticket = ticket;
+        auto t0 = std::chrono::steady_clock::now();
+        out.rc = decode_();
+        auto t1 = std::chrono::steady_clock::now();
+        out.dur_ns =
+                (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+        done_.push(std::move(out));
+        if (notify_)
+            notify_();
+    }
+}
+
+} // namespace uma::sched
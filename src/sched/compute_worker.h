@@ -0,0 +1,58 @@
+// UMA Serve - Compute thread (runs llama_decode off the event loop)
+#pragma once
+
+#include "util/spsc_queue.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace uma::sched {
+
+struct DecodeOutcome {
+    uint64_t ticket = 0; // submit() order
+    int rc = 0;          // llama_decode return code
+    uint64_t dur_ns = 0; // decode + synchronize wall time
+};
+
+// Owns the thread that drives the llama_context, so a long decode never blocks accepts,
+// reads or writes on the event loop. The loop submits a ticket once a batch is prepared
+// (Scheduler::begin_tick). The worker runs `decode` (Scheduler::decode_batch), pushes the
+// outcome and calls `notify` (Poller::wake) so the loop picks it up with its socket events.
+//
+// Tickets and outcomes travel over lock-free SPSC queues. The mutex/condvar only puts the
+// worker to sleep while it has nothing to do.
+class ComputeWorker {
+  public:
+    using DecodeFn = std::function<int()>;
+    using NotifyFn = std::function<void()>;
+
+    ComputeWorker(DecodeFn decode, NotifyFn notify);
+    ~ComputeWorker(); // finishes the running decode, then joins
+
+    ComputeWorker(const ComputeWorker&) = delete;
+    ComputeWorker& operator=(const ComputeWorker&) = delete;
+
+    // Event-loop thread only. Returns the ticket of the queued decode.
+    uint64_t submit();
+    // Event-loop thread only. Takes the next finished decode, if any.
+    bool poll(DecodeOutcome& out) { return done_.pop(out); }
+
+  private:
+    void run();
+
+    DecodeFn decode_;
+    NotifyFn notify_;
+    uma::util::SpscQueue<uint64_t> jobs_{8};
+    uma::util::SpscQueue<DecodeOutcome> done_{8};
+    uint64_t next_ticket_ = 1;
+
+    std::mutex mu_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+} // namespace uma::sched
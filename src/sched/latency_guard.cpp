@@ -0,0 +1,113 @@
+// UMA Serve - LatencyGuard: prefill throttle with hysteresis over another policy
+#include "sched/latency_guard.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace uma::sched {
+
+namespace {
+int32_t n_past_of(const uma::ipc::SessionPool& sessions, int sid) {
+    const auto* s = sessions.find(sid);
+    return s ? s->hot->n_past : 0;
+}
+} // namespace
+
+LatencyGuard::LatencyGuard(IBatchPolicy& inner, const StepCost& cost, const Params& params)
+    : inner_(inner), cost_(cost), params_(params) {}
+
+void LatencyGuard::schedule_tick(const uma::ipc::SessionPool& sessions, int32_t batch_cap,
+                                 int32_t target_batch, size_t rr_decode_idx,
+                                 size_t rr_prefill_idx, Plan& out) {
+    inner_.schedule_tick(sessions, batch_cap, target_batch, rr_decode_idx, rr_prefill_idx, out);
+    last_trimmed_ = last_trimmed_decode_ = 0;
+    const int32_t interactive_decode = out.decode_tok_count - out.background_decode_count;
+    if (out.decode_tok_count == 0 || (out.prefill_tok_count == 0 && hold_left_ == 0))
+        return;
+
+    // KV positions the decoders attend, and their mean context, for the step-time model
+    uint64_t decode_kv = 0;
+    for (const auto& it : out.items) {
+        if (it.phase == Phase::DECODE)
+            decode_kv += kv_units(n_past_of(sessions, it.sid), 1);
+    }
+
+    int32_t allowed = 0;
+    if (hold_left_ == 0) {
+        int32_t fit = out.prefill_tok_count;
+        if (cost_.prefill_known()) {
+            // walk the chunks in plan order, each priced at its own context depth
+            double spare = params_.budget_ms - cost_.predict_ms(out.decode_tok_count, 0, decode_kv);
+            fit = 0;
+            for (const auto& it : out.items) {
+                if (it.phase != Phase::PREFILL)
+                    continue;
+                const int32_t n_past = n_past_of(sessions, it.sid);
+                const int32_t k = std::min(it.n_tokens, cost_.prefill_within(spare, n_past));
+                fit += k;
+                spare -= cost_.prefill_chunk_ms(k, n_past);
+            }
+        }
+        allowed = std::max((int32_t)std::floor(level_ * fit), params_.min_prefill);
+    }
+    int32_t excess = std::max(0, out.prefill_tok_count - allowed);
+    // held with interactive streams in the batch: background decoders go too
+    int32_t decode_excess = 0;
+    if (hold_left_ > 0 && interactive_decode > 0 && out.background_decode_count > 0 &&
+        cost_.decode_known()) {
+        const double mean_ctx = (double)decode_kv / out.decode_tok_count - 1.0;
+        const int32_t fit = cost_.decode_within(params_.budget_ms, mean_ctx);
+        decode_excess = std::clamp(out.decode_tok_count - fit, 0, out.background_decode_count);
+    }
+    if (excess == 0 && decode_excess == 0)
+        return;
+
+    // last items first: the policy puts first-token (TTFT) chunks and interactive work in front
+    for (auto it = out.items.rbegin(); it != out.items.rend(); ++it) {
+        if (it->phase == Phase::PREFILL && excess > 0) {
+            const int32_t cut = std::min(it->n_tokens, excess);
+            it->n_tokens -= cut;
+            excess -= cut;
+            out.prefill_tok_count -= cut;
+            last_trimmed_ += cut;
+        } else if (it->phase == Phase::DECODE && decode_excess > 0 &&
+                   it->cls == uma::ipc::RequestClass::Background) {
+            it->n_tokens = 0;
+            --decode_excess;
+            --out.decode_tok_count;
+            --out.background_decode_count;
+            ++last_trimmed_decode_;
+        }
+    }
+    out.items.erase(std::remove_if(out.items.begin(), out.items.end(),
+                                   [](const BatchItem& b) { return b.n_tokens == 0; }),
+                    out.items.end());
+}
+
+void LatencyGuard::observe(int32_t decode_toks, int32_t prefill_toks, double ms,
+                           int32_t background_decode_toks) {
+    if (decode_toks + prefill_toks <= 0)
+        return;
+    if (ms > params_.budget_ms) {
+        ++ticks_over_budget_;
+        // only prefill and background decoders can be taken back; an overshoot by interactive
+        // decode alone does not extend the hold, or waiting prompts would never be admitted
+        // on a slow device
+        const bool interactive = decode_toks > background_decode_toks;
+        if ((prefill_toks > 0 && decode_toks > 0) ||
+            (background_decode_toks > 0 && interactive)) {
+            hold_left_ = params_.hold_ticks;
+            level_ = 0.0;
+            return;
+        }
+    }
+    if (hold_left_ > 0) {
+        --hold_left_;
+        if (hold_left_ > 0)
+            return;
+    }
+    if (level_ < 1.0)
+        level_ = params_.ramp_ticks == 0 ? 1.0 : std::min(1.0, level_ + 1.0 / params_.ramp_ticks);
+}
+
+} // namespace uma::sched
@@ -0,0 +1,69 @@
+// UMA Serve - LatencyGuard: prefill throttle with hysteresis over another policy
+#pragma once
+
+#include "sched/policy.h"
+#include "sched/step_cost.h"
+
+#include <cstdint>
+
+namespace uma::sched {
+
+// Wraps a policy and trims the PREFILL part of its plans so that decoding streams keep
+// their inter-token budget.
+//
+// Step time is predicted with a StepCost that the owner keeps learning from observed
+// ticks; before the costs are known the guard trims nothing. While the plan is predicted
+// to overshoot, prefill is cut down to what fits, each chunk priced at the context depth
+// of its request (the n_past read from `sessions`). A tick that actually overshoots while
+// carrying prefill closes prefill entirely for hold_ticks ticks; it then reopens at
+// 1/ramp_ticks of what fits and widens by that step every tick under budget. Plans without
+// decode tokens pass through untouched (no stream to protect), and a reopened guard always
+// lets min_prefill tokens through so that waiting requests keep making progress.
+//
+// Lanes: background prefill sits at the back of the plan and is trimmed first. Background
+// decoders also trip the guard when they share an overshooting tick with interactive
+// streams; during the hold they are cut until the predicted step fits. Interactive decode
+// tokens are never removed.
+class LatencyGuard : public IBatchPolicy {
+  public:
+    struct Params {
+        double budget_ms = 80.0;
+        uint32_t hold_ticks = 8;
+        uint32_t ramp_ticks = 8; // 0 = reopen fully after the hold
+        int32_t min_prefill = 16;
+    };
+
+    LatencyGuard(IBatchPolicy& inner, const StepCost& cost, const Params& params);
+
+    using IBatchPolicy::schedule_tick;
+    void schedule_tick(const uma::ipc::SessionPool& sessions, int32_t batch_cap,
+                       int32_t target_batch, size_t rr_decode_idx, size_t rr_prefill_idx,
+                       Plan& out) override;
+
+    // Report the tick that was decoded: its final token counts (background_decode_toks is
+    // part of decode_toks) and wall-clock time. Only moves the hold and ramp; the cost
+    // model is fed by its owner.
+    void observe(int32_t decode_toks, int32_t prefill_toks, double ms,
+                 int32_t background_decode_toks = 0);
+
+    // Holding prefill or still ramping it back up.
+    bool active() const { return hold_left_ > 0 || level_ < 1.0; }
+    double level() const { return level_; }
+    // Prefill tokens removed from the last plan.
+    int32_t last_trimmed() const { return last_trimmed_; }
+    // Background decode tokens removed from the last plan.
+    int32_t last_trimmed_decode() const { return last_trimmed_decode_; }
+    uint64_t ticks_over_budget() const { return ticks_over_budget_; }
+
+  private:
+    IBatchPolicy& inner_;
+    const StepCost& cost_;
+    Params params_;
+    double level_ = 1.0; // share of the fitting prefill let through
+    uint32_t hold_left_ = 0;
+    int32_t last_trimmed_ = 0;
+    int32_t last_trimmed_decode_ = 0;
+    uint64_t ticks_over_budget_ = 0;
+};
+
+} // namespace uma::sched
@@ -1,95 +1,260 @@
-// UMA Serve - Scheduling policy (baseline)
+// UMA Serve - Scheduling policies (baseline, EDF)
 #include "sched/policy.h"
 
 #include <algorithm>
 #include <climits>
+#include <limits>
 
 namespace uma::sched {
 
-Plan BaselinePolicy::schedule_tick(const uma::ipc::SessionPool& sessions, int32_t batch_cap,
+namespace {
+constexpr int32_t kBurst = 16; // prefill chunk for a request still waiting for its first token
+constexpr size_t kInteractive = (size_t)uma::ipc::RequestClass::Interactive;
+constexpr size_t kBackground = (size_t)uma::ipc::RequestClass::Background;
+
+int32_t prefill_remaining(const uma::ipc::SessionHot& h) {
+    const size_t remain_sz = h.cold->prompt_tokens.size() - h.prefill_idx;
+    return static_cast<int32_t>(std::min<size_t>(remain_sz, static_cast<size_t>(INT_MAX)));
+}
+} // namespace
+
+BaselinePolicy::BaselinePolicy(double interactive_share, PrefillOrder order,
+                               double aging_tok_per_s)
+    : interactive_share_(std::clamp(interactive_share, 0.0, 1.0)), order_(order),
+      aging_tok_per_s_(std::max(0.0, aging_tok_per_s)) {}
+
+void BaselinePolicy::plan_prefill(const HotList& lane, size_t rr_prefill_idx, int32_t& budget,
+                                  int32_t& lane_budget, Plan& plan) {
+    ttft_pool_.clear();
+    rest_pool_.clear();
+    const size_t N = lane.size();
+    for (size_t i = 0; i < N; ++i) {
+        const auto* h = lane[(rr_prefill_idx + i) % N];
+        if (h->cold->first_emit_ns == 0)
+            ttft_pool_.push_back(h);
+        else
+            rest_pool_.push_back(h);
+    }
+
+    auto schedule_pool = [&](const HotList& pool) {
+        for (const auto* h : pool) {
+            if (budget <= 0 || lane_budget <= 0) break;
+            const auto& s = *h->cold;
+            int32_t chunk = std::min({prefill_remaining(*h), budget, lane_budget});
+            if (s.first_emit_ns == 0) {
+                chunk = std::min<int32_t>(chunk, kBurst);
+            }
+            if (chunk <= 0) continue;
+            plan.items.push_back({s.sid, Phase::PREFILL, chunk, h->cls});
+            budget -= chunk;
+            lane_budget -= chunk;
+            plan.prefill_tok_count += chunk;
+        }
+    };
+    schedule_pool(ttft_pool_);
+    schedule_pool(rest_pool_);
+}
+
+void BaselinePolicy::plan_prefill_srpt(const HotList& lane, int32_t& budget,
+                                       int32_t& lane_budget, Plan& plan) {
+    ranked_.clear();
+    size_t n_first = 0;
+    for (const auto* h : lane) {
+        const auto& s = *h->cold;
+        const double waited_s =
+                now_ns_ > s.req_start_ns ? (double)(now_ns_ - s.req_start_ns) / 1.0e9 : 0.0;
+        const bool first = s.first_emit_ns == 0;
+        ranked_.push_back({first, prefill_remaining(*h) - aging_tok_per_s_ * waited_s, h});
+        n_first += first;
+    }
+    std::sort(ranked_.begin(), ranked_.end(), [](const Ranked& a, const Ranked& b) {
+        if (a.first_token != b.first_token)
+            return a.first_token;
+        if (a.key != b.key)
+            return a.key < b.key;
+        return a.h->sid < b.h->sid;
+    });
+
+    for (const auto& r : ranked_) {
+        const int32_t avail = std::min(budget, lane_budget);
+        if (avail <= 0)
+            break;
+        int32_t chunk = std::min(prefill_remaining(*r.h), avail);
+        if (r.first_token) {
+            // equal share of what is left among the first-token prompts not yet served
+            chunk = std::min(chunk, std::max(kBurst, avail / (int32_t)n_first));
+            --n_first;
+        }
+        if (chunk <= 0)
+            continue;
+        plan.items.push_back({r.h->sid, Phase::PREFILL, chunk, r.h->cls});
+        budget -= chunk;
+        lane_budget -= chunk;
+        plan.prefill_tok_count += chunk;
+    }
+}
+
+void BaselinePolicy::schedule_tick(const uma::ipc::SessionPool& sessions, int32_t batch_cap,
                                    int32_t target_batch, size_t rr_decode_idx,
-                                   size_t rr_prefill_idx) {
-    Plan plan{};
+                                   size_t rr_prefill_idx, Plan& plan) {
+    plan.clear();
     const int32_t budget0 = std::min<int32_t>(target_batch, batch_cap);
     int32_t budget = budget0;
 
-    // Build lists of session fds for decode and prefill pools
-    std::vector<int> decode_pool;
-    std::vector<int> prefill_pool;
-    decode_pool.reserve(sessions.size());
-    prefill_pool.reserve(sessions.size());
-    for (auto& kv : sessions) {
-        const auto& s = *kv.second;
-        if (s.state == uma::ipc::SessionState::DECODE && s.has_pending_tok) {
-            decode_pool.push_back(s.fd);
-        } else if (s.state == uma::ipc::SessionState::PREFILL &&
-                   s.prefill_idx < s.prompt_tokens.size()) {
-            prefill_pool.push_back(s.fd);
-        }
+    // Candidates from the pool's ready lists, split by lane (member storage, reused)
+    for (size_t c = 0; c < uma::ipc::kRequestClasses; ++c) {
+        decode_pool_[c].clear();
+        prefill_pool_[c].clear();
+    }
+    for (const auto* h = sessions.decode_ready().front(); h; h = h->list_next) {
+        if (!h->has_pending_tok)
+            continue;
+        if (h->conn && h->conn->tx_parked)
+            continue; // client not reading: no point generating more output for it
+        decode_pool_[(size_t)h->cls].push_back(h);
+    }
+    for (const auto* h = sessions.prefill_ready().front(); h; h = h->list_next) {
+        if (h->prefill_idx < h->cold->prompt_tokens.size())
+            prefill_pool_[(size_t)h->cls].push_back(h);
     }
 
-    // Phase A: round-robin decode (1 token per ready DECODE session)
-    if (!decode_pool.empty() && budget > 0) {
-        const size_t N = decode_pool.size();
-        for (size_t i = 0; i < N && budget > 0; ++i) {
-            int fd = decode_pool[(rr_decode_idx + i) % N];
-            plan.items.push_back({fd, Phase::DECODE, 1});
+    // Lane budgets: background work may use what interactive requests cannot, but never the
+    // reserved interactive share while they have work for it.
+    int32_t interactive_demand = (int32_t)decode_pool_[kInteractive].size();
+    for (const auto* h : prefill_pool_[kInteractive]) {
+        if (interactive_demand >= budget0)
+            break;
+        const int32_t remain = prefill_remaining(*h);
+        const bool capped = order_ == PrefillOrder::RoundRobin && h->cold->first_emit_ns == 0;
+        interactive_demand += capped ? std::min(remain, kBurst) : remain;
+    }
+    const int32_t reserved =
+            std::min<int32_t>((int32_t)(interactive_share_ * budget0), interactive_demand);
+    int32_t lane_budget[uma::ipc::kRequestClasses];
+    lane_budget[kInteractive] = budget0;
+    lane_budget[kBackground] = budget0 - reserved;
+
+    // Phase A: round-robin decode (1 token per ready DECODE session), interactive first
+    const size_t n_decode = decode_pool_[kInteractive].size() + decode_pool_[kBackground].size();
+    for (size_t c : {kInteractive, kBackground}) {
+        const auto& pool = decode_pool_[c];
+        const size_t N = pool.size();
+        for (size_t i = 0; i < N && budget > 0 && lane_budget[c] > 0; ++i) {
+            const auto* h = pool[(rr_decode_idx + i) % N];
+            plan.items.push_back({h->sid, Phase::DECODE, 1, h->cls});
             budget -= 1;
+            lane_budget[c] -= 1;
             plan.decode_tok_count += 1;
+            if (c == kBackground)
+                plan.background_decode_count += 1;
         }
-        // rotate cursor by one position (legacy behavior)
-        plan.next_rr_decode_idx = (N > 0) ? (rr_decode_idx + 1) % N : 0;
-    } else {
-        plan.next_rr_decode_idx = 0;
     }
+    // rotate cursor by one position (legacy behavior)
+    plan.next_rr_decode_idx = (n_decode > 0) ? (rr_decode_idx + 1) % n_decode : 0;
 
-    // Phase B: budgeted prefill (TTFT-first, small burst for first-token sessions)
-    if (!prefill_pool.empty() && budget > 0) {
-        std::vector<int> ttft_pool;
-        std::vector<int> rest_pool;
-        ttft_pool.reserve(prefill_pool.size());
-        rest_pool.reserve(prefill_pool.size());
-        const size_t N = prefill_pool.size();
-        for (size_t i = 0; i < N; ++i) {
-            int fd = prefill_pool[(rr_prefill_idx + i) % N];
-            const auto it = sessions.find(fd);
-            if (it == sessions.end()) continue;
-            const auto& s = *it->second;
-            if (s.first_emit_ns == 0)
-                ttft_pool.push_back(fd);
-            else
-                rest_pool.push_back(fd);
-        }
+    // Phase B: budgeted prefill (TTFT-first, burst-limited for first-token sessions),
+    // interactive first
+    const size_t n_prefill =
+            prefill_pool_[kInteractive].size() + prefill_pool_[kBackground].size();
+    for (size_t c : {kInteractive, kBackground}) {
+        if (budget <= 0)
+            break;
+        if (prefill_pool_[c].empty())
+            continue;
+        if (order_ == PrefillOrder::ShortestFirst)
+            plan_prefill_srpt(prefill_pool_[c], budget, lane_budget[c], plan);
+        else
+            plan_prefill(prefill_pool_[c], rr_prefill_idx, budget, lane_budget[c], plan);
+    }
+    plan.next_rr_prefill_idx = (n_prefill > 0) ? (rr_prefill_idx + 1) % n_prefill : 0;
+}
 
-        auto schedule_pool = [&](const std::vector<int>& pool) {
-            for (int fd : pool) {
-                if (budget <= 0) break;
-                const auto it = sessions.find(fd);
-                if (it == sessions.end()) continue;
-                const auto& s = *it->second;
-                const size_t remain_sz = s.prompt_tokens.size() - s.prefill_idx;
-                int32_t remain = static_cast<int32_t>(
-                        std::min<size_t>(remain_sz, static_cast<size_t>(INT_MAX)));
-                int32_t chunk = std::min<int32_t>(remain, budget);
-                if (s.first_emit_ns == 0) {
-                    const int32_t kBurst = 16;
-                    chunk = std::min<int32_t>(chunk, kBurst);
-                }
-                if (chunk <= 0) continue;
-                plan.items.push_back({fd, Phase::PREFILL, chunk});
-                budget -= chunk;
-                plan.prefill_tok_count += chunk;
-            }
-        };
-        schedule_pool(ttft_pool);
-        if (budget > 0) schedule_pool(rest_pool);
-        plan.next_rr_prefill_idx = (N > 0) ? (rr_prefill_idx + 1) % N : 0;
-    } else {
-        plan.next_rr_prefill_idx = 0;
+EdfPolicy::EdfPolicy(const StepCost& cost, int32_t min_chunk)
+    : cost_(cost), min_chunk_(min_chunk) {}
+
+uint64_t EdfPolicy::deadline_ns(const uma::ipc::ClientSession& s, Phase phase) {
+    if (phase == Phase::PREFILL && s.first_emit_ns == 0)
+        return s.req_start_ns + (uint64_t)s.slo.target_ttft_ms * 1000000ull;
+    const uint64_t last = s.last_emit_ns ? s.last_emit_ns : s.first_emit_ns;
+    return last + (uint64_t)s.slo.target_tbt_ms * 1000000ull;
+}
+
+void EdfPolicy::schedule_tick(const uma::ipc::SessionPool& sessions, int32_t batch_cap,
+                              int32_t target_batch, size_t, size_t, Plan& plan) {
+    plan.clear();
+    const int32_t budget0 = std::min<int32_t>(target_batch, batch_cap);
+
+    cands_.clear();
+    size_t n_decode = 0;
+    for (const auto* h = sessions.decode_ready().front(); h; h = h->list_next) {
+        if (!h->has_pending_tok || (h->conn && h->conn->tx_parked))
+            continue;
+        cands_.push_back({deadline_ns(*h->cold, Phase::DECODE), h, Phase::DECODE});
+        ++n_decode;
     }
+    for (const auto* h = sessions.prefill_ready().front(); h; h = h->list_next) {
+        if (h->prefill_idx < h->cold->prompt_tokens.size())
+            cands_.push_back({deadline_ns(*h->cold, Phase::PREFILL), h, Phase::PREFILL});
+    }
+    std::sort(cands_.begin(), cands_.end(), [](const Candidate& a, const Candidate& b) {
+        if (a.deadline_ns != b.deadline_ns)
+            return a.deadline_ns < b.deadline_ns;
+        return a.h->sid < b.h->sid;
+    });
 
-    return plan;
+    // Decoders come first in token terms; the tick may then run until the earliest decoder
+    // deadline, and whatever decode does not use of that is prefill time.
+    const int32_t n_dec = std::min<int32_t>((int32_t)n_decode, std::max(budget0, 0));
+    int32_t prefill_tokens = budget0 - n_dec;
+    uint64_t first_decode_deadline = std::numeric_limits<uint64_t>::max();
+    uint64_t decode_kv = 0; // KV positions the n_dec decoders that run will attend
+    int32_t seen = 0;
+    for (const auto& c : cands_) {
+        if (c.phase != Phase::DECODE || seen == n_dec)
+            continue;
+        if (seen++ == 0)
+            first_decode_deadline = c.deadline_ns;
+        decode_kv += kv_units(c.h->n_past, 1);
+    }
+    const bool timed = n_dec > 0 && cost_.prefill_known();
+    double time_left_ms = 0.0;
+    if (timed) {
+        const double until_ms = first_decode_deadline > now_ns_
+                                        ? (double)(first_decode_deadline - now_ns_) / 1.0e6
+                                        : 0.0;
+        time_left_ms = until_ms - cost_.predict_ms(n_dec, 0, decode_kv);
+    }
+
+    int32_t decode_left = n_dec;
+    for (const auto& c : cands_) {
+        const auto* h = c.h;
+        if (c.phase == Phase::DECODE) {
+            if (decode_left <= 0)
+                continue;
+            plan.items.push_back({h->sid, Phase::DECODE, 1, h->cls});
+            --decode_left;
+            plan.decode_tok_count += 1;
+            if (h->cls == uma::ipc::RequestClass::Background)
+                plan.background_decode_count += 1;
+            continue;
+        }
+        if (prefill_tokens <= 0)
+            continue;
+        int32_t chunk = std::min(prefill_remaining(*h), prefill_tokens);
+        if (timed) {
+            int32_t fit = cost_.prefill_within(time_left_ms, h->n_past);
+            if (c.deadline_ns <= first_decode_deadline)
+                fit = std::max(fit, min_chunk_);
+            chunk = std::min(chunk, fit);
+        }
+        if (chunk <= 0)
+            continue;
+        plan.items.push_back({h->sid, Phase::PREFILL, chunk, h->cls});
+        prefill_tokens -= chunk;
+        plan.prefill_tok_count += chunk;
+        if (timed)
+            time_left_ms -= cost_.prefill_chunk_ms(chunk, h->n_past);
+    }
 }
 
 } // namespace uma::sched
-
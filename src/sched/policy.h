@@ -2,6 +2,7 @@
 #pragma once
 
 #include "ipc/session.h"
+#include "sched/step_cost.h"
 
 #include <cstddef>
 #include <vector>
@@ -11,9 +12,10 @@ namespace uma::sched {
 enum class Phase { PREFILL, DECODE };
 
 struct BatchItem {
-    int fd = -1;
+    int sid = -1; // SessionPool key of the request
     Phase phase = Phase::DECODE;
     int32_t n_tokens = 1; // for PREFILL chunks; DECODE is always 1
+    uma::ipc::RequestClass cls = uma::ipc::RequestClass::Interactive; // the request's lane
 };
 
 struct Plan {
@@ -24,25 +26,133 @@ struct Plan {
     // Accounting helpers
     int32_t decode_tok_count = 0;
     int32_t prefill_tok_count = 0;
+    int32_t background_decode_count = 0; // of decode_tok_count
+
+    // Reset for the next tick; items keeps its capacity.
+    void clear() {
+        items.clear();
+        next_rr_decode_idx = next_rr_prefill_idx = 0;
+        decode_tok_count = prefill_tok_count = background_decode_count = 0;
+    }
 };
 
 class IBatchPolicy {
   public:
     virtual ~IBatchPolicy() = default;
     // Build a plan for a single tick given the current sessions and scheduler cursors/budget.
-    virtual Plan schedule_tick(const uma::ipc::SessionPool& sessions, int32_t batch_cap,
+    // The plan goes into `out`, which is cleared first; the scheduler passes the same Plan
+    // every tick so its storage is reused.
+    virtual void schedule_tick(const uma::ipc::SessionPool& sessions, int32_t batch_cap,
                                int32_t target_batch, size_t rr_decode_idx,
-                               size_t rr_prefill_idx) = 0;
+                               size_t rr_prefill_idx, Plan& out) = 0;
+
+    // Convenience overload returning a fresh plan (tests, tools).
+    Plan schedule_tick(const uma::ipc::SessionPool& sessions, int32_t batch_cap,
+                       int32_t target_batch, size_t rr_decode_idx, size_t rr_prefill_idx) {
+        Plan plan;
+        schedule_tick(sessions, batch_cap, target_batch, rr_decode_idx, rr_prefill_idx, plan);
+        return plan;
+    }
+};
+
+// Order of prefill candidates within a lane.
+enum class PrefillOrder {
+    RoundRobin,    // rotating cursor; first-token chunks capped at 16 tokens
+    ShortestFirst, // SRPT: fewest remaining prompt tokens first, aged by waiting time
 };
 
 // Baseline policy that mirrors the current scheduler behavior:
-// - Decode-first: 1 token per DECODE session (round-robin)
+// - Decode-first: 1 token per DECODE session (round-robin), except sessions whose
+//   connection is parked for backpressure (Connection::tx_parked)
 // - Budgeted prefill: fill remaining capacity, TTFT-first with small burst
+// With PrefillOrder::ShortestFirst, each TTFT-first group is instead ordered by remaining
+// prompt tokens minus aging_tok_per_s for every second the request has waited since it
+// arrived, so short prompts go first but a long one overtakes them eventually. The
+// first-token burst is then adaptive: each prompt may take an equal share of the prefill
+// budget left for the prompts not yet served (at least 16 tokens), and what a short prompt
+// does not need passes to the longer ones behind it. ShortestFirst needs set_now() before
+// each tick.
+// Each step serves the interactive lane before the background one. Background work
+// (decode and prefill together) is capped so that interactive_share of the tick's budget
+// stays free for interactive work, as far as interactive requests can use it.
+// Candidates come from the pool's ready lists, so planning cost follows the number of
+// active requests rather than connections. The candidate lists are members so that a
+// steady-state tick does not allocate.
 class BaselinePolicy : public IBatchPolicy {
   public:
-    Plan schedule_tick(const uma::ipc::SessionPool& sessions, int32_t batch_cap,
-                       int32_t target_batch, size_t rr_decode_idx,
-                       size_t rr_prefill_idx) override;
+    explicit BaselinePolicy(double interactive_share = 0.5,
+                            PrefillOrder order = PrefillOrder::RoundRobin,
+                            double aging_tok_per_s = 1000.0);
+
+    void set_now(uint64_t now_ns) { now_ns_ = now_ns; }
+
+    using IBatchPolicy::schedule_tick;
+    void schedule_tick(const uma::ipc::SessionPool& sessions, int32_t batch_cap,
+                       int32_t target_batch, size_t rr_decode_idx, size_t rr_prefill_idx,
+                       Plan& out) override;
+
+  private:
+    using HotList = std::vector<const uma::ipc::SessionHot*>;
+    // Prefill one lane's candidates into `plan`, TTFT-first, spending from both budgets.
+    void plan_prefill(const HotList& lane, size_t rr_prefill_idx, int32_t& budget,
+                      int32_t& lane_budget, Plan& plan);
+    // The same in ShortestFirst order.
+    void plan_prefill_srpt(const HotList& lane, int32_t& budget, int32_t& lane_budget,
+                           Plan& plan);
+
+    struct Ranked {
+        bool first_token; // still waiting for it: ranks before the rest
+        double key;       // remaining prompt tokens minus aging credit
+        const uma::ipc::SessionHot* h;
+    };
+
+    double interactive_share_;
+    PrefillOrder order_;
+    double aging_tok_per_s_;
+    uint64_t now_ns_ = 0;
+    HotList decode_pool_[uma::ipc::kRequestClasses];
+    HotList prefill_pool_[uma::ipc::kRequestClasses];
+    HotList ttft_pool_;
+    HotList rest_pool_;
+    std::vector<Ranked> ranked_;
+};
+
+// Earliest-deadline-first policy against each request's own SLO targets (ClientSession::slo,
+// which a request may override). Deadlines:
+// - waiting for its first token: req_start_ns + target_ttft_ms
+// - otherwise: last token (last_emit_ns) + target_tbt_ms
+// Every ready decoder gets its token while the batch budget allows, the earliest deadlines
+// first. Prefill chunks are taken in deadline order and sized to what remains of the tick:
+// the batch budget, and the time until the earliest decoder deadline minus the decode time,
+// as predicted by `cost`. A prompt whose deadline is earlier than every decoder's still
+// gets at least min_chunk tokens, so an overdue stream cannot starve it. Until `cost` has
+// learned the prefill cost, chunks are sized by the batch budget only.
+// QoS lanes do not apply; background work should carry looser SLO targets instead.
+// Call set_now() before each tick.
+class EdfPolicy : public IBatchPolicy {
+  public:
+    explicit EdfPolicy(const StepCost& cost, int32_t min_chunk = 16);
+
+    void set_now(uint64_t now_ns) { now_ns_ = now_ns; }
+    // The deadline that orders a request in the given phase.
+    static uint64_t deadline_ns(const uma::ipc::ClientSession& s, Phase phase);
+
+    using IBatchPolicy::schedule_tick;
+    // The round-robin cursors are not used.
+    void schedule_tick(const uma::ipc::SessionPool& sessions, int32_t batch_cap,
+                       int32_t target_batch, size_t rr_decode_idx, size_t rr_prefill_idx,
+                       Plan& out) override;
+
+  private:
+    struct Candidate {
+        uint64_t deadline_ns;
+        const uma::ipc::SessionHot* h;
+        Phase phase;
+    };
+    const StepCost& cost_;
+    int32_t min_chunk_;
+    uint64_t now_ns_ = 0;
+    std::vector<Candidate> cands_; // reused every tick
 };
 
 } // namespace uma::sched
@@ -4,85 +4,241 @@
 #include "llama.h"
 #include "runtime/tokens.h"
 #include "sched/bmt.h"
+#include "util/logging.h"
 
 #include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <chrono>
+#include <climits>
 #include <cstddef>
 #include <cstdint>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 
 namespace uma::sched {
 
+static_assert(sizeof(metrics::Metrics::lanes) / sizeof(metrics::LaneMetrics) ==
+                      ipc::kRequestClasses,
+              "one metrics lane per request class");
+
 Scheduler::Scheduler(llama_context* ctx, const llama_vocab* vocab,
                      const runtime::RuntimeConfig& cfg, uma::metrics::Metrics* m)
-    : ctx_(ctx), vocab_(vocab), config_(cfg), metrics_(m) {
+    : ctx_(ctx), vocab_(vocab), config_(cfg), metrics_(m),
+      policy_(cfg.interactive_share,
+              cfg.sched_policy == "srpt" ? PrefillOrder::ShortestFirst : PrefillOrder::RoundRobin,
+              cfg.srpt_aging_tok_per_s),
+      edf_(step_cost_),
+      guard_(cfg.sched_policy == "edf" ? static_cast<IBatchPolicy&>(edf_) : policy_, step_cost_,
+             LatencyGuard::Params{(double)cfg.slo_tbt_ms, cfg.guard_hold_ticks,
+                                  cfg.guard_ramp_ticks}) {
+    if (cfg.sched_policy != "edf" && cfg.sched_policy != "srpt" && cfg.sched_policy != "baseline")
+        UMA_LOG_WARN() << "unknown policy '" << cfg.sched_policy << "'; using baseline";
+    if (config_.prefill_guard)
+        planner_ = &guard_;
+    else if (config_.sched_policy == "edf")
+        planner_ = &edf_;
+    else
+        planner_ = &policy_;
     batch_cap_ = llama_n_batch(ctx);
-    // Experiment: start with full backend batch capacity to better utilize device during prefill
+    // Full backend batch capacity until the step-time model can size ticks
     target_batch_ = batch_cap_;
     rr_decode_idx_ = rr_prefill_idx_ = 0;
+    // one sequence per token; every token of a prefill chunk belongs to the same request
+    batch_ = llama_batch_init(batch_cap_, 0, 1);
+    for (int32_t i = 0; i < batch_cap_; ++i)
+        batch_.n_seq_id[i] = 1;
+    plan_.items.reserve(batch_cap_);
+    samples_.reserve(batch_cap_);
     decode_ms_ewma_ = tick_budget_ms_;
     if (metrics_) {
         metrics_->set_decode_ms_ewma(decode_ms_ewma_);
     }
+    pieces_.build(uma::runtime::tokens::n_vocab(vocab_), [this](int32_t id, char* buf, size_t cap) {
+        return uma::runtime::tokens::token_to_piece(vocab_, id, buf, cap, true);
+    });
+}
+
+Scheduler::~Scheduler() {
+    llama_batch_free(batch_);
+}
+
+// Queue one token event in the connection's negotiated stream format, or hold it for a
+// coalesced "tokens" event. The first token with text always goes out alone (TTFT is
+// unaffected). Text comes from the piece table through the request's detokenizer: raw for
+// binary streams, pre-escaped for JSON ones. A token that ends inside a UTF-8 character
+// sends nothing: the detokenizer keeps its bytes and the token that completes the character
+// carries all of it. Binary ids-only connections skip detokenization entirely.
+void Scheduler::emit_token(ipc::ClientSession& s, llama_token id, uint64_t now_ns) {
+    ipc::Connection& c = *s.conn;
+    const bool ids_only = c.binary_stream && !c.binary_text;
+    std::string_view piece;
+    if (!ids_only) {
+        if (pieces_.piece(id).empty())
+            return;
+        piece = s.detok.push(pieces_, id, !c.binary_stream);
+        if (piece.empty())
+            return;
+    }
+    const bool explicit_hold = s.min_tokens_per_frame > 1 || s.flush_ms > 0;
+    const bool backlogged =
+            config_.coalesce_backlog_bytes > 0 && c.tx.size() >= config_.coalesce_backlog_bytes;
+    if (s.held_ids.empty() && (!s.token_sent || (!explicit_hold && !backlogged))) {
+        s.token_sent = true;
+        if (!c.binary_stream) {
+            uma::ipc::protocol::append_token_event_escaped(c.tx, *s.token_prefix, piece,
+                                                           (int)id);
+        } else {
+            uma::ipc::protocol::append_token_event_bin(c.tx, s.handle, (int)id, piece);
+        }
+        return;
+    }
+    if (s.held_ids.empty())
+        s.held_since_ns = now_ns;
+    s.held_ids.push_back((int32_t)id);
+    s.held_lens.push_back((uint32_t)piece.size());
+    s.held_text.append(piece.data(), piece.size());
+
+    bool due;
+    if (explicit_hold) {
+        due = (s.min_tokens_per_frame > 1 && s.held_ids.size() >= s.min_tokens_per_frame) ||
+              (s.flush_ms > 0 && now_ns - s.held_since_ns >= (uint64_t)s.flush_ms * 1000000ull);
+    } else {
+        due = !backlogged; // the reader caught up: release what piled up
+    }
+    if (due || s.held_ids.size() >= kMaxHeldTokens)
+        flush_held_tokens(s);
+}
+
+void Scheduler::flush_held_tokens(ipc::ClientSession& s, bool end_of_stream) {
+    ipc::Connection& c = *s.conn;
+    if (end_of_stream && s.detok.holding()) {
+        // a character that never completed goes out as U+FFFD with its last token
+        const int32_t id = s.detok.pending_id();
+        const std::string_view rest = s.detok.finish(!c.binary_stream);
+        s.held_ids.push_back(id);
+        s.held_lens.push_back((uint32_t)rest.size());
+        s.held_text.append(rest.data(), rest.size());
+    }
+    const size_t n = s.held_ids.size();
+    if (n == 0)
+        return;
+    s.token_sent = true;
+    if (n == 1) {
+        if (!c.binary_stream) {
+            uma::ipc::protocol::append_token_event_escaped(c.tx, *s.token_prefix,
+                                                           s.held_text, s.held_ids[0]);
+        } else {
+            uma::ipc::protocol::append_token_event_bin(c.tx, s.handle, s.held_ids[0], s.held_text);
+        }
+    } else {
+        if (!c.binary_stream) {
+            uma::ipc::protocol::append_tokens_event_escaped(c.tx, s.request_id, s.held_ids.data(),
+                                                            s.held_lens.data(), n, s.held_text);
+        } else {
+            uma::ipc::protocol::append_tokens_event_bin(c.tx, s.handle, s.held_ids.data(),
+                                                        s.held_lens.data(), n, s.held_text);
+        }
+        if (metrics_) {
+            metrics_->coalesced_frames_total.fetch_add(1, std::memory_order_relaxed);
+            metrics_->coalesced_tokens_total.fetch_add(n, std::memory_order_relaxed);
+        }
+    }
+    s.held_ids.clear();
+    s.held_lens.clear();
+    s.held_text.clear();
+}
+
+// Backpressure: stop decoding for a connection whose client has stopped reading. The event
+// loop resumes it once tx drains to the low-water mark.
+void Scheduler::park_if_backlogged(ipc::Connection& c) {
+    if (c.tx_parked || config_.tx_high_water_bytes == 0 ||
+        c.tx.size() < config_.tx_high_water_bytes)
+        return;
+    c.tx_parked = true;
+    if (metrics_)
+        metrics_->tx_parks_total.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Scheduler::account_finished_slo(const ipc::ClientSession& s) {
+    if (!metrics_ || s.first_emit_ns == 0)
+        return;
+    const bool ttft_ok =
+            s.first_emit_ns - s.req_start_ns <= (uint64_t)s.slo.target_ttft_ms * 1000000ull;
+    // mean over the gaps after the first token (one per generated_count)
+    const bool tbt_ok = s.generated_count == 0 ||
+                        (s.last_emit_ns - s.first_emit_ns) / s.generated_count <=
+                                (uint64_t)s.slo.target_tbt_ms * 1000000ull;
+    metrics_->slo_requests_total.fetch_add(1, std::memory_order_relaxed);
+    if (ttft_ok && tbt_ok)
+        metrics_->slo_requests_met.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Token budget for the next tick from the step-time model: the decoders that fit in
+// tick_budget_ms_, plus the prefill tokens that fit in what they leave, priced at the
+// shallowest waiting prompt (deeper chunks are the prefill guard's and ΣBMT's to trim).
+// Until prefill has been priced, waiting prompts may fill the backend batch.
+int32_t Scheduler::fit_target_batch(const ipc::SessionPool& sessions) const {
+    int32_t d = 0;
+    uint64_t kv = 0;
+    for (const auto* h = sessions.decode_ready().front(); h; h = h->list_next) {
+        if (h->has_pending_tok && !(h->conn && h->conn->tx_parked)) {
+            ++d;
+            kv += kv_units(h->n_past, 1);
+        }
+    }
+    int32_t min_ctx = INT_MAX;
+    for (const auto* h = sessions.prefill_ready().front(); h; h = h->list_next)
+        min_ctx = std::min(min_ctx, h->n_past);
+
+    int32_t d_fit = 0;
+    uint64_t kv_fit = 0;
+    if (d > 0) {
+        d_fit = std::min(d, step_cost_.decode_within(tick_budget_ms_, (double)kv / d - 1.0));
+        kv_fit = kv * (uint64_t)d_fit / (uint64_t)d;
+    }
+    int64_t p_fit = 0;
+    if (min_ctx != INT_MAX && !step_cost_.prefill_known()) {
+        p_fit = batch_cap_;
+    } else if (min_ctx != INT_MAX) {
+        const double spare = tick_budget_ms_ - step_cost_.predict_ms(d_fit, 0, kv_fit);
+        p_fit = step_cost_.prefill_within(spare, min_ctx);
+    }
+    return (int32_t)std::clamp<int64_t>(d_fit + p_fit, kMinTargetBatch, batch_cap_);
 }
 
-std::vector<int> Scheduler::tick(ipc::SessionPool& sessions, uint64_t now_ns) {
-    std::vector<llama_token> tokens;
-    tokens.reserve(batch_cap_);
-    std::vector<int32_t> n_seq_id;
-    n_seq_id.reserve(batch_cap_);
-    std::vector<llama_seq_id> seq_id_vals;
-    seq_id_vals.reserve(batch_cap_);
-    std::vector<llama_seq_id*> seq_ids;
-    seq_ids.reserve(batch_cap_);
-    std::vector<int8_t> logits;
-    logits.reserve(batch_cap_);
-    std::vector<llama_pos> pos;
-    pos.reserve(batch_cap_);
-
-    struct SampleRef {
-        int fd;
-        int batch_index;
-        uma::ipc::SessionState state_before;
-    };
-    std::vector<SampleRef> samples;
-    samples.reserve(batch_cap_);
-
-    std::vector<int> result_fds;
-
-    // Use policy to plan this tick
-    Plan plan = policy_.schedule_tick(sessions, batch_cap_, target_batch_, rr_decode_idx_,
-                                      rr_prefill_idx_);
+// Plan this tick and lay its tokens out in the member batch arrays. Returns false when
+// there is nothing to decode. Session cursors (prefill_idx, n_past, pending token) advance
+// here, so a prepared batch must be completed with complete_batch().
+bool Scheduler::prepare_batch(ipc::SessionPool& sessions, uint64_t now_ns) {
+    samples_.clear();
+
+    if (step_cost_.decode_known()) {
+        target_batch_ = fit_target_batch(sessions);
+        if (metrics_)
+            metrics_->target_batch.store((uint32_t)target_batch_, std::memory_order_relaxed);
+    }
+
+    // Use policy to plan this tick (through the prefill guard when enabled)
+    policy_.set_now(now_ns);
+    edf_.set_now(now_ns);
+    planner_->schedule_tick(sessions, batch_cap_, target_batch_, rr_decode_idx_, rr_prefill_idx_,
+                            plan_);
+    if (metrics_ && config_.prefill_guard && guard_.last_trimmed() > 0) {
+        metrics_->skipped_prefill_due_to_latency_total.fetch_add(1, std::memory_order_relaxed);
+        metrics_->prefill_guard_trimmed_tokens.fetch_add((uint64_t)guard_.last_trimmed(),
+                                                         std::memory_order_relaxed);
+    }
+    if (metrics_ && config_.prefill_guard && guard_.last_trimmed_decode() > 0) {
+        metrics_->background_decode_throttled_total.fetch_add(
+                (uint64_t)guard_.last_trimmed_decode(), std::memory_order_relaxed);
+    }
     // BMT guard (experimental): trim PREFILL to stay within budget units, if configured
     if (config_.bmt_budget_units > 0) {
-        uint64_t est = uma::sched::bmt::estimate_units(sessions, plan);
+        uint64_t est = uma::sched::bmt::estimate_units(sessions, plan_);
         bool trimmed = false;
-        if (est > config_.bmt_budget_units) {
-            // Build base n_past per FD for PREFILL cost updates
-            std::unordered_map<int, uint64_t> base_npast;
-            base_npast.reserve(sessions.size());
-            for (auto& kv : sessions) {
-                base_npast.emplace(kv.first, (uint64_t) kv.second->n_past);
-            }
-            for (int idx = (int)plan.items.size() - 1; idx >= 0 && est > config_.bmt_budget_units; --idx) {
-                auto& it = plan.items[(size_t) idx];
-                if (it.phase != uma::sched::Phase::PREFILL || it.n_tokens <= 0) continue;
-                uint64_t base = base_npast[it.fd];
-                // remove tokens from the end of the chunk until under budget
-                while (it.n_tokens > 0 && est > config_.bmt_budget_units) {
-                    // cost of last token in chunk m: base + m
-                    uint64_t m = (uint64_t) it.n_tokens;
-                    uint64_t tok_cost = base + m;
-                    it.n_tokens -= 1;
-                    est -= tok_cost;
-                    plan.prefill_tok_count -= 1;
-                    trimmed = true;
-                }
-            }
-        }
+        est = uma::sched::bmt::trim_to_budget(sessions, plan_, est, config_.bmt_budget_units,
+                                              trimmed);
         if (metrics_) {
             metrics_->bmt_budget_units.store(config_.bmt_budget_units, std::memory_order_relaxed);
             metrics_->bmt_units_last.store(est, std::memory_order_relaxed);
@@ -94,240 +250,292 @@ std::vector<int> Scheduler::tick(ipc::SessionPool& sessions, uint64_t now_ns) {
             }
         }
     }
+    // what the tick attends, for the step-time model (n_past still as planned)
+    plan_kv_ = bmt::estimate_units(sessions, plan_);
+
     // Apply RR cursor updates
-    rr_decode_idx_ = plan.next_rr_decode_idx;
-    rr_prefill_idx_ = plan.next_rr_prefill_idx;
-
-    // Enact the plan: fill tokens arrays and session updates according to items
-    for (const auto& item : plan.items) {
-        auto it = sessions.find(item.fd);
-        if (it == sessions.end()) continue;
-        auto& s = *it->second;
+    rr_decode_idx_ = plan_.next_rr_decode_idx;
+    rr_prefill_idx_ = plan_.next_rr_prefill_idx;
+
+    // Enact the plan: write tokens into the batch and advance the sessions
+    int32_t n = 0;
+    for (const auto& item : plan_.items) {
+        ipc::ClientSession* sp = sessions.find(item.sid);
+        if (!sp) continue;
+        auto& s = *sp;
         if (item.phase == uma::sched::Phase::DECODE) {
-            llama_token t = static_cast<llama_token>(s.pending_tok);
-            s.has_pending_tok = false;
-            tokens.push_back(t);
-            n_seq_id.push_back(1);
-            seq_id_vals.push_back((llama_seq_id)s.seq);
-            seq_ids.push_back(&seq_id_vals.back());
-            pos.push_back((llama_pos)s.n_past);
-            logits.push_back(1);
-            samples.push_back({s.fd, (int)tokens.size() - 1, uma::ipc::SessionState::DECODE});
+            assert(n < batch_cap_ && "batch exceeds llama_n_batch");
+            batch_.token[n] = static_cast<llama_token>(s.hot->pending_tok);
+            batch_.pos[n] = (llama_pos)s.hot->n_past;
+            batch_.seq_id[n][0] = (llama_seq_id)s.hot->seq;
+            batch_.logits[n] = 1;
+            s.hot->has_pending_tok = false;
+            samples_.push_back({s.sid, n, uma::ipc::SessionState::DECODE});
+            ++n;
         } else { // PREFILL
             const int32_t chunk = item.n_tokens;
             assert(chunk >= 0 && "prefill chunk size is less than 0");
-            const int32_t base_pos = s.n_past;
+            assert(n + chunk <= batch_cap_ && "batch exceeds llama_n_batch");
+            const int32_t base_pos = s.hot->n_past;
+            // only the chunk that ends the prompt is sampled: it yields the first token and
+            // moves the request to DECODE; earlier chunks just fill the KV cache
+            const bool last_chunk = s.hot->prefill_idx + (size_t)chunk == s.prompt_tokens.size();
             for (int32_t j = 0; j < chunk; ++j) {
-                llama_token t = static_cast<llama_token>(s.prompt_tokens[s.prefill_idx++]);
-                tokens.push_back(t);
-                n_seq_id.push_back(1);
-                seq_id_vals.push_back(s.seq);
-                seq_ids.push_back(&seq_id_vals.back());
-                pos.push_back((llama_pos)(base_pos + j));
-                int8_t lg = (j == chunk - 1) ? 1 : 0;
-                logits.push_back(lg);
+                batch_.token[n] = static_cast<llama_token>(s.prompt_tokens[s.hot->prefill_idx++]);
+                batch_.pos[n] = (llama_pos)(base_pos + j);
+                batch_.seq_id[n][0] = (llama_seq_id)s.hot->seq;
+                const int8_t lg = (last_chunk && j == chunk - 1) ? 1 : 0;
+                batch_.logits[n] = lg;
                 if (lg) {
-                    samples.push_back({s.fd, (int)tokens.size() - 1, uma::ipc::SessionState::PREFILL});
+                    samples_.push_back({s.sid, n, uma::ipc::SessionState::PREFILL});
                 }
+                ++n;
             }
-            s.n_past = base_pos + chunk;
+            s.hot->n_past = base_pos + chunk;
         }
     }
 
-    if (!tokens.empty()) {
-        // batch arrays should be in lockstep
-        assert(n_seq_id.size() == tokens.size());
-        assert(seq_id_vals.size() == tokens.size());
-        assert(seq_ids.size() == tokens.size());
-        assert(logits.size() == tokens.size());
-        // ensure we don't exceed API limits
-        assert(tokens.size() <= static_cast<size_t>(batch_cap_) && "batch exceeds llama_n_batch");
-        assert(tokens.size() <= static_cast<size_t>(INT32_MAX) && "n_tokens must fit int32");
-        // logits rows must match samples count
-        size_t ones = static_cast<size_t>(std::count(logits.begin(), logits.end(), 1));
-        assert(ones == samples.size() && "logits==1 count must equal samples");
-        llama_batch batch{};
-        batch.n_tokens = static_cast<int32_t>(tokens.size());
-        batch.token = tokens.data();
-        batch.embd = nullptr;
-        batch.pos = pos.data();
-        batch.n_seq_id = n_seq_id.data();
-        batch.seq_id = seq_ids.data();
-        batch.logits = logits.data();
+    batch_.n_tokens = n;
+    if (n == 0)
+        return false;
+    // logits rows must match samples count
+    assert(static_cast<size_t>(std::count(batch_.logits, batch_.logits + n, 1)) ==
+                   samples_.size() &&
+           "logits==1 count must equal samples");
 
+    if (config_.enable_perf) {
+        llama_perf_context_reset(ctx_);
+    }
+    return true;
+}
+
+// Runs on the compute thread when there is one: touches only the context and the batch.
+int Scheduler::decode_batch() {
+    const int rc = llama_decode(ctx_, batch_);
+    // Always synchronize to reflect real compute time in wall clock
+    llama_synchronize(ctx_);
+    return rc;
+}
+
+// Account the decode, then sample and emit for every request in the batch. Connections
+// whose tx went from empty to non-empty are appended to fds_out.
+void Scheduler::complete_batch(ipc::SessionPool& sessions, uint64_t now_ns, int dec_rc,
+                               uint64_t dur_ns, std::vector<int>& fds_out) {
+    double ms = static_cast<double>(dur_ns) / 1.0e6;
+
+    // update metrics (if provided)
+    if (metrics_) {
+        metrics_->batch_calls_total.fetch_add(1, std::memory_order_relaxed);
+        metrics_->last_batch_size.store(static_cast<uint32_t>(batch_.n_tokens),
+                                        std::memory_order_relaxed);
+
+        // Split accounting: attribute total time proportionally to token counts
+        const uint64_t tot_tok = static_cast<uint64_t>(batch_.n_tokens);
+        const uint64_t gen_tok = static_cast<uint64_t>(plan_.decode_tok_count);
+        const uint64_t pf_tok = static_cast<uint64_t>(plan_.prefill_tok_count);
+        metrics_->decode_phase_tokens_total.fetch_add(gen_tok, std::memory_order_relaxed);
+        metrics_->prefill_tokens_total.fetch_add(pf_tok, std::memory_order_relaxed);
+
+        uint64_t gen_ns = 0;
+        uint64_t pf_ns = 0;
+        if (tot_tok > 0) {
+            gen_ns = static_cast<uint64_t>((__int128)dur_ns * gen_tok / tot_tok);
+            pf_ns = static_cast<uint64_t>(dur_ns) - gen_ns;
+        }
+        metrics_->decode_ns_total_gen.fetch_add(gen_ns, std::memory_order_relaxed);
+        metrics_->prefill_ns_total.fetch_add(pf_ns, std::memory_order_relaxed);
+
+        // Generation-only decode metrics: exclude PREFILL
+        if (gen_tok > 0) {
+            uint32_t gen_ms_u32 = static_cast<uint32_t>((gen_ns / 1000000.0) + 0.5);
+            metrics_->decode_ms_last.store(gen_ms_u32, std::memory_order_relaxed);
+            metrics_->decode_ns_total.fetch_add(gen_ns, std::memory_order_relaxed);
+            metrics_->decode_calls.fetch_add(1, std::memory_order_relaxed);
+            metrics_->decode_tokens_total.fetch_add(gen_tok, std::memory_order_relaxed);
+            // Min/max (single-threaded writer; relaxed is fine)
+            uint32_t cur_min = metrics_->decode_ms_min.load(std::memory_order_relaxed);
+            if (gen_ms_u32 < cur_min)
+                metrics_->decode_ms_min.store(gen_ms_u32, std::memory_order_relaxed);
+            uint32_t cur_max = metrics_->decode_ms_max.load(std::memory_order_relaxed);
+            if (gen_ms_u32 > cur_max)
+                metrics_->decode_ms_max.store(gen_ms_u32, std::memory_order_relaxed);
+        }
+
+        // llama internal perf breakdown (optional)
         if (config_.enable_perf) {
-            llama_perf_context_reset(ctx_);
+            auto pdata = llama_perf_context(ctx_);
+            uint32_t eval_ms = static_cast<uint32_t>(pdata.t_eval_ms + 0.5);
+            uint32_t p_eval_ms = static_cast<uint32_t>(pdata.t_p_eval_ms + 0.5);
+            metrics_->eval_ms_last.store(eval_ms, std::memory_order_relaxed);
+            metrics_->p_eval_ms_last.store(p_eval_ms, std::memory_order_relaxed);
+            metrics_->eval_ns_total.fetch_add((uint64_t)(pdata.t_eval_ms * 1.0e6),
+                                              std::memory_order_relaxed);
+            metrics_->p_eval_ns_total.fetch_add((uint64_t)(pdata.t_p_eval_ms * 1.0e6),
+                                                std::memory_order_relaxed);
+            // increment calls if non-zero to avoid counting empty resets
+            if (pdata.n_eval > 0)
+                metrics_->eval_calls.fetch_add(1, std::memory_order_relaxed);
+            if (pdata.n_p_eval > 0)
+                metrics_->p_eval_calls.fetch_add(1, std::memory_order_relaxed);
         }
-        auto t0 = std::chrono::steady_clock::now();
-        int dec_rc = llama_decode(ctx_, batch);
-        // Always synchronize to reflect real compute time in wall clock
-        llama_synchronize(ctx_);
-        auto t1 = std::chrono::steady_clock::now();
-        auto dur_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
-        double ms = static_cast<double>(dur_ns) / 1.0e6;
-
-        // update metrics (if provided)
-        if (metrics_) {
-            metrics_->batch_calls_total.fetch_add(1, std::memory_order_relaxed);
-            metrics_->last_batch_size.store(static_cast<uint32_t>(tokens.size()),
-                                            std::memory_order_relaxed);
-
-            // Split accounting: attribute total time proportionally to token counts
-            const uint64_t tot_tok = static_cast<uint64_t>(tokens.size());
-            const uint64_t gen_tok = static_cast<uint64_t>(plan.decode_tok_count);
-            const uint64_t pf_tok = static_cast<uint64_t>(plan.prefill_tok_count);
-            metrics_->decode_phase_tokens_total.fetch_add(gen_tok, std::memory_order_relaxed);
-            metrics_->prefill_tokens_total.fetch_add(pf_tok, std::memory_order_relaxed);
-
-            uint64_t gen_ns = 0;
-            uint64_t pf_ns = 0;
-            if (tot_tok > 0) {
-                gen_ns = static_cast<uint64_t>((__int128)dur_ns * gen_tok / tot_tok);
-                pf_ns = static_cast<uint64_t>(dur_ns) - gen_ns;
-            }
-            metrics_->decode_ns_total_gen.fetch_add(gen_ns, std::memory_order_relaxed);
-            metrics_->prefill_ns_total.fetch_add(pf_ns, std::memory_order_relaxed);
-
-            // Generation-only decode metrics: exclude PREFILL
-            if (gen_tok > 0) {
-                uint32_t gen_ms_u32 = static_cast<uint32_t>((gen_ns / 1000000.0) + 0.5);
-                metrics_->decode_ms_last.store(gen_ms_u32, std::memory_order_relaxed);
-                metrics_->decode_ns_total.fetch_add(gen_ns, std::memory_order_relaxed);
-                metrics_->decode_calls.fetch_add(1, std::memory_order_relaxed);
-                metrics_->decode_tokens_total.fetch_add(gen_tok, std::memory_order_relaxed);
-                // Min/max (single-threaded writer; relaxed is fine)
-                uint32_t cur_min = metrics_->decode_ms_min.load(std::memory_order_relaxed);
-                if (gen_ms_u32 < cur_min)
-                    metrics_->decode_ms_min.store(gen_ms_u32, std::memory_order_relaxed);
-                uint32_t cur_max = metrics_->decode_ms_max.load(std::memory_order_relaxed);
-                if (gen_ms_u32 > cur_max)
-                    metrics_->decode_ms_max.store(gen_ms_u32, std::memory_order_relaxed);
-            }
+    }
+    // EWMA toward observed decode time + publish (admission estimates queue waits with it)
+    decode_ms_ewma_ = 0.8 * decode_ms_ewma_ + 0.2 * ms;
+    if (metrics_)
+        metrics_->set_decode_ms_ewma(decode_ms_ewma_);
 
-            // llama internal perf breakdown (optional)
-            if (config_.enable_perf) {
-                auto pdata = llama_perf_context(ctx_);
-                uint32_t eval_ms = static_cast<uint32_t>(pdata.t_eval_ms + 0.5);
-                uint32_t p_eval_ms = static_cast<uint32_t>(pdata.t_p_eval_ms + 0.5);
-                metrics_->eval_ms_last.store(eval_ms, std::memory_order_relaxed);
-                metrics_->p_eval_ms_last.store(p_eval_ms, std::memory_order_relaxed);
-                metrics_->eval_ns_total.fetch_add((uint64_t)(pdata.t_eval_ms * 1.0e6),
-                                                  std::memory_order_relaxed);
-                metrics_->p_eval_ns_total.fetch_add((uint64_t)(pdata.t_p_eval_ms * 1.0e6),
-                                                    std::memory_order_relaxed);
-                // increment calls if non-zero to avoid counting empty resets
-                if (pdata.n_eval > 0)
-                    metrics_->eval_calls.fetch_add(1, std::memory_order_relaxed);
-                if (pdata.n_p_eval > 0)
-                    metrics_->p_eval_calls.fetch_add(1, std::memory_order_relaxed);
-            }
+    // Learn step costs; the prefill guard opens or closes prefill for the next ticks
+    if (dec_rc == 0) {
+        step_cost_.observe(plan_.decode_tok_count, plan_.prefill_tok_count, plan_kv_, ms);
+        if (metrics_) {
+            const auto c = step_cost_.coefficients();
+            metrics_->set_cost_model(c.fixed_ms, c.decode_ms, c.prefill_ms, c.kv_ms_per_k,
+                                     step_cost_.error_ms(), step_cost_.samples());
         }
-        // EWMA toward observed decode time + publish
-        decode_ms_ewma_ = 0.8 * decode_ms_ewma_ + 0.2 * ms;
-        if (metrics_)
-            metrics_->set_decode_ms_ewma(decode_ms_ewma_);
-        // Simple adaptive tuning
-        if (decode_ms_ewma_ > 1.3 * tick_budget_ms_) {
-            target_batch_ = std::max<int32_t>(8, (int32_t)(target_batch_ * 0.7));
-        } else if (decode_ms_ewma_ < 0.8 * tick_budget_ms_) {
-            target_batch_ = std::min<int32_t>(
-                    batch_cap_, target_batch_ + std::max<int32_t>(1, target_batch_ / 8));
+    }
+    if (config_.prefill_guard && dec_rc == 0) {
+        guard_.observe(plan_.decode_tok_count, plan_.prefill_tok_count, ms,
+                       plan_.background_decode_count);
+        if (metrics_) {
+            metrics_->prefill_guard_active.store(guard_.active() ? 1 : 0,
+                                                 std::memory_order_relaxed);
+            metrics_->ticks_over_budget.store(guard_.ticks_over_budget(),
+                                              std::memory_order_relaxed);
         }
+    }
 
-        if (dec_rc != 0) {
-            for (auto& sample : samples) {
-                auto it = sessions.find(sample.fd);
-                if (it == sessions.end()) {
-                    continue;
-                }
-                auto& s = *it->second;
-                s.last_error = "decode error";
-                s.state = ipc::SessionState::ERRORED;
-                uma::ipc::protocol::append_error_event(s.tx, s.request_id, "E_RUNTIME_DECODE",
-                                                       "decode failed");
-                s.read_closed = true;
+    if (dec_rc != 0) {
+        for (auto& sample : samples_) {
+            ipc::ClientSession* found = sessions.find(sample.sid);
+            if (!found) {
+                continue; // closed while the batch was in flight (a reused slot has a new sid)
             }
-        } else {
-            const int32_t n_vocab = llama_vocab_n_tokens(vocab_);
-            for (size_t i = 0; i < samples.size(); ++i) {
-                auto& sample = samples[i];
-                auto it = sessions.find(sample.fd);
-                if (it == sessions.end()) {
-                    continue;
+            auto& s = *found;
+            if (s.hot->state == ipc::SessionState::DONE)
+                continue; // cancelled while the batch was in flight
+            const bool need_arm = s.conn->tx.empty();
+            s.last_error = "decode error";
+            sessions.set_state(s, ipc::SessionState::ERRORED);
+            flush_held_tokens(s, true);
+            uma::ipc::protocol::append_error_event(s.conn->tx, s.request_id,
+                                                   "E_RUNTIME_DECODE", "decode failed");
+            if (need_arm)
+                fds_out.push_back(s.fd);
+        }
+    } else {
+        const int32_t n_vocab = llama_vocab_n_tokens(vocab_);
+        for (size_t i = 0; i < samples_.size(); ++i) {
+            auto& sample = samples_[i];
+            ipc::ClientSession* found = sessions.find(sample.sid);
+            if (!found) {
+                continue; // closed while the batch was in flight (a reused slot has a new sid)
+            }
+            auto& s = *found;
+            if (s.hot->state == ipc::SessionState::DONE)
+                continue; // cancelled while the batch was in flight
+            bool need_arm = s.conn->tx.empty();
+            float* logits_row = llama_get_logits_ith(ctx_, sample.batch_index);
+            if (logits_row == nullptr) {
+                continue;
+            }
+            // pluggable sampling (default: temperature + top-p)
+            SamplingParams sp{};
+            sp.temperature = static_cast<float>(s.temperature);
+            sp.top_p = static_cast<float>(s.top_p);
+            sp.top_k = s.top_k;
+            llama_token new_id = sampler_.sample(logits_row, n_vocab, sp, rng_);
+            if (sample.state_before == ipc::SessionState::PREFILL) {
+                // transition to DECODE; feed this token next tick
+                s.hot->pending_tok = new_id;
+                s.hot->has_pending_tok = true;
+                sessions.set_state(s, ipc::SessionState::DECODE);
+                emit_token(s, new_id, now_ns);
+                if (s.first_emit_ns == 0) {
+                    s.first_emit_ns = now_ns;
+                    if (metrics_) {
+                        metrics_->slo_ttft_total.fetch_add(1, std::memory_order_relaxed);
+                        if (now_ns - s.req_start_ns > (uint64_t)s.slo.target_ttft_ms * 1000000ull)
+                            metrics_->slo_violations_ttft_total.fetch_add(
+                                    1, std::memory_order_relaxed);
+                    }
                 }
-                auto& s = *it->second;
-                bool need_arm = s.tx.empty();
-                float* logits_row = llama_get_logits_ith(ctx_, sample.batch_index);
-                if (logits_row == nullptr) {
-                    continue;
+                s.last_emit_ns = now_ns;
+                if (metrics_) {
+                    metrics_->tokens_generated_total.fetch_add(1, std::memory_order_relaxed);
+                    metrics_->lanes[(size_t)s.hot->cls].tokens_total.fetch_add(
+                            1, std::memory_order_relaxed);
                 }
-                // pluggable sampling (default: temperature + top-p)
-                SamplingParams sp{};
-                sp.temperature = static_cast<float>(s.temperature);
-                sp.top_p = static_cast<float>(s.top_p);
-                sp.top_k = s.top_k;
-                llama_token new_id = sampler_.sample(logits_row, n_vocab, sp, rng_);
-                if (sample.state_before == ipc::SessionState::PREFILL) {
-                    // transition to DECODE; feed this token next tick
-                    s.pending_tok = new_id;
-                    s.has_pending_tok = true;
-                    s.state = ipc::SessionState::DECODE;
-                    {
-                        std::string piece =
-                                uma::runtime::tokens::token_to_piece_str(vocab_, new_id, true);
-                        if (!piece.empty()) {
-                            uma::ipc::protocol::append_token_event(s.tx, s.request_id, piece,
-                                                                   (int)new_id);
-                        }
-                    }
+            } else {
+                if (llama_vocab_is_eog(vocab_, new_id) ||
+                    s.generated_count >= config_.max_tokens) {
+                    flush_held_tokens(s, true);
+                    uma::ipc::protocol::append_eos_event(
+                            s.conn->tx, s.request_id,
+                            s.generated_count >= config_.max_tokens ? "length" : "stop");
+                    sessions.set_state(s, ipc::SessionState::STREAM);
+                    account_finished_slo(s);
+                    llama_memory_seq_rm(llama_get_memory(ctx_), s.hot->seq, -1, -1);
+                    s.hot->n_past = 0;
+                    // Update last emit on EOS
                     if (s.first_emit_ns == 0)
                         s.first_emit_ns = now_ns;
                     s.last_emit_ns = now_ns;
-                    if (metrics_)
-                        metrics_->tokens_generated_total.fetch_add(1, std::memory_order_relaxed);
                 } else {
-                    if (llama_vocab_is_eog(vocab_, new_id) ||
-                        s.generated_count >= config_.max_tokens) {
-                        uma::ipc::protocol::append_eos_event(
-                                s.tx, s.request_id,
-                                s.generated_count >= config_.max_tokens ? "length" : "stop");
-                        s.state = ipc::SessionState::STREAM;
-                        llama_memory_seq_rm(llama_get_memory(ctx_), s.seq, -1, -1);
-                        s.n_past = 0;
-                        // Update last emit on EOS
-                        if (s.first_emit_ns == 0)
-                            s.first_emit_ns = now_ns;
-                        s.last_emit_ns = now_ns;
-                    } else {
-                        {
-                            std::string piece =
-                                    uma::runtime::tokens::token_to_piece_str(vocab_, new_id, true);
-                            if (!piece.empty()) {
-                                uma::ipc::protocol::append_token_event(s.tx, s.request_id, piece,
-                                                                       (int)new_id);
-                            }
-                        }
-                        s.generated_count++;
-                        s.pending_tok = new_id;
-                        s.has_pending_tok = true;
-                        s.n_past += 1; // we consumed the previously pending token this tick
-                        s.state = ipc::SessionState::DECODE;
-                        if (s.first_emit_ns == 0)
-                            s.first_emit_ns = now_ns;
-                        s.last_emit_ns = now_ns;
-                        if (metrics_)
-                            metrics_->tokens_generated_total.fetch_add(1,
-                                                                       std::memory_order_relaxed);
+                    if (metrics_ && s.last_emit_ns != 0) {
+                        const uint64_t gap_ns = now_ns - s.last_emit_ns;
+                        metrics_->lanes[(size_t)s.hot->cls].observe_tbt(gap_ns);
+                        metrics_->slo_tbt_total.fetch_add(1, std::memory_order_relaxed);
+                        if (gap_ns > (uint64_t)s.slo.target_tbt_ms * 1000000ull)
+                            metrics_->slo_violations_tbt_total.fetch_add(
+                                    1, std::memory_order_relaxed);
+                    }
+                    emit_token(s, new_id, now_ns);
+                    s.generated_count++;
+                    s.hot->pending_tok = new_id;
+                    s.hot->has_pending_tok = true;
+                    s.hot->n_past += 1; // we consumed the previously pending token this tick
+                    sessions.set_state(s, ipc::SessionState::DECODE);
+                    if (s.first_emit_ns == 0)
+                        s.first_emit_ns = now_ns;
+                    s.last_emit_ns = now_ns;
+                    if (metrics_) {
+                        metrics_->tokens_generated_total.fetch_add(1,
+                                                                   std::memory_order_relaxed);
+                        metrics_->lanes[(size_t)s.hot->cls].tokens_total.fetch_add(
+                                1, std::memory_order_relaxed);
                     }
                 }
-                if (need_arm) {
-                    result_fds.push_back(s.fd);
-                }
             }
+            if (need_arm && !s.conn->tx.empty()) { // held tokens produce no output yet
+                fds_out.push_back(s.fd);
+            }
+            park_if_backlogged(*s.conn);
         }
     }
 
-    return result_fds;
+}
+
+void Scheduler::tick(ipc::SessionPool& sessions, uint64_t now_ns, std::vector<int>& fds_out) {
+    if (!prepare_batch(sessions, now_ns))
+        return;
+    auto t0 = std::chrono::steady_clock::now();
+    const int dec_rc = decode_batch();
+    auto t1 = std::chrono::steady_clock::now();
+    const auto dur_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+    complete_batch(sessions, now_ns, dec_rc, (uint64_t)dur_ns, fds_out);
+}
+
+bool Scheduler::begin_tick(ipc::SessionPool& sessions, uint64_t now_ns) {
+    assert(!in_flight_ && "previous batch not finished");
+    in_flight_ = prepare_batch(sessions, now_ns);
+    return in_flight_;
+}
+
+void Scheduler::finish_tick(ipc::SessionPool& sessions, uint64_t now_ns, int dec_rc,
+                            uint64_t dur_ns, std::vector<int>& fds_out) {
+    assert(in_flight_ && "no batch in flight");
+    in_flight_ = false;
+    complete_batch(sessions, now_ns, dec_rc, dur_ns, fds_out);
 }
 
 } // namespace uma::sched
@@ -1,6 +1,8 @@
 #pragma once
 
+#include "ipc/piece_table.h"
 #include "ipc/session.h"
+#include "sched/latency_guard.h"
 #include "sched/policy.h"
 #include "llama.h"
 #include "metrics/metrics.h"
@@ -21,16 +23,68 @@ class Scheduler {
     const runtime::RuntimeConfig config_;
     uma::metrics::Metrics* metrics_;
     double decode_ms_ewma_;
-    const double tick_budget_ms_ = 30.0;
+    const double tick_budget_ms_ = 30.0; // what fit_target_batch() sizes ticks for
+    static constexpr int32_t kMinTargetBatch = 8;
+    ipc::PieceTable pieces_; // per-token text, built once from the vocab
+    StepCost step_cost_;    // learned from every decoded tick
+    uint64_t plan_kv_ = 0;  // ΣKV positions of the prepared batch, for step_cost_
     BaselinePolicy policy_;
+    EdfPolicy edf_;
+    LatencyGuard guard_;    // wraps the configured policy when config_.prefill_guard is set
+    IBatchPolicy* planner_; // what prepare_batch() plans with
     TopPSampler sampler_;
     std::mt19937 rng_ { std::random_device{}() };
 
+    // Upper bound on tokens held for one coalesced "tokens" event.
+    static constexpr size_t kMaxHeldTokens = 64;
+
+    // The batch of the current tick: built by prepare_batch(), decoded by decode_batch()
+    // (possibly on the compute thread), then consumed by complete_batch(). The storage is
+    // allocated once for batch_cap_ tokens and reused: batch_ comes from llama_batch_init()
+    // and each tick rewrites only its first n_tokens entries.
+    struct SampleRef {
+        int sid;
+        int batch_index;
+        uma::ipc::SessionState state_before;
+    };
+    Plan plan_;
+    std::vector<SampleRef> samples_;
+    llama_batch batch_{};
+    bool in_flight_ = false;
+
+    int32_t fit_target_batch(const ipc::SessionPool& sessions) const;
+    bool prepare_batch(ipc::SessionPool& sessions, uint64_t now_ns);
+    void complete_batch(ipc::SessionPool& sessions, uint64_t now_ns, int dec_rc, uint64_t dur_ns,
+                        std::vector<int>& fds_out);
+
+    void emit_token(ipc::ClientSession& s, llama_token id, uint64_t now_ns);
+    void park_if_backlogged(ipc::Connection& c);
+    // SLO attainment of a request that finished normally (before last_emit_ns moves to EOS).
+    void account_finished_slo(const ipc::ClientSession& s);
+    // end_of_stream also releases a partial UTF-8 character the detokenizer still holds.
+    void flush_held_tokens(ipc::ClientSession& s, bool end_of_stream = false);
+
   public:
     Scheduler(llama_context* ctx, const llama_vocab* vocab, const runtime::RuntimeConfig& cfg,
               uma::metrics::Metrics* m = nullptr);
+    ~Scheduler();
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    // Run one batched decode over the in-flight requests. Appends to `fds_out` the fds of
+    // connections whose tx queue went from empty to non-empty (each at most once).
+    void tick(ipc::SessionPool& sessions, uint64_t now_ns, std::vector<int>& fds_out);
 
-    std::vector<int> tick(ipc::SessionPool& sessions, uint64_t now_ns);
+    // The same tick split in two, for a decode that runs on a ComputeWorker. begin_tick()
+    // plans the batch as of now_ns (false: nothing to decode). The worker then calls
+    // decode_batch(), and finish_tick() samples and emits with its result, appending fds as
+    // tick() does.
+    // Between the two, sessions may be added or closed but KV memory must not be touched.
+    bool begin_tick(ipc::SessionPool& sessions, uint64_t now_ns);
+    int decode_batch();
+    void finish_tick(ipc::SessionPool& sessions, uint64_t now_ns, int dec_rc, uint64_t dur_ns,
+                     std::vector<int>& fds_out);
+    bool in_flight() const { return in_flight_; }
 };
 
 } // namespace uma::sched
@@ -0,0 +1,112 @@
+// UMA Serve - Online step-time model shared by the scheduler and the planning policies
+#include "sched/step_cost.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+namespace uma::sched {
+
+namespace {
+constexpr int kFixed = 0, kDecode = 1, kPrefill = 2, kKv = 3;
+} // namespace
+
+StepCost::StepCost() {
+    for (int i = 0; i < kN; ++i)
+        p_[i][i] = kPrior;
+}
+
+StepCost::StepCost(const Coefficients& prior) : StepCost() {
+    theta_[kFixed] = prior.fixed_ms;
+    theta_[kDecode] = prior.decode_ms;
+    theta_[kPrefill] = prior.prefill_ms;
+    theta_[kKv] = prior.kv_ms_per_k;
+    decode_known_ = prefill_known_ = true;
+}
+
+void StepCost::observe(int32_t decode_toks, int32_t prefill_toks, uint64_t kv, double ms) {
+    if (decode_toks + prefill_toks <= 0)
+        return;
+    const double err = ms - predict_ms(decode_toks, prefill_toks, kv);
+    error_ms_ = samples_ == 0 ? std::fabs(err)
+                              : (1 - kErrAlpha) * error_ms_ + kErrAlpha * std::fabs(err);
+    ++samples_;
+    decode_known_ |= decode_toks > 0;
+    prefill_known_ |= prefill_toks > 0;
+
+    // RLS step: gain k = P·x / (λ + xᵀ·P·x); θ += k·(y - xᵀ·θ); P = (P - k·xᵀ·P) / λ
+    const double x[kN] = {1.0, (double)decode_toks, (double)prefill_toks,
+                          (double)kv / 1000.0};
+    double px[kN] = {};
+    double xpx = 0.0;
+    double y_hat = 0.0;
+    for (int i = 0; i < kN; ++i) {
+        for (int j = 0; j < kN; ++j)
+            px[i] += p_[i][j] * x[j];
+        xpx += x[i] * px[i];
+        y_hat += theta_[i] * x[i];
+    }
+    const double denom = kForget + xpx;
+    const double resid = ms - y_hat;
+    double trace = 0.0;
+    for (int i = 0; i < kN; ++i) {
+        theta_[i] += px[i] / denom * resid;
+        for (int j = 0; j < kN; ++j)
+            p_[i][j] -= px[i] * px[j] / denom;
+        trace += p_[i][i];
+    }
+    // Forget only while the covariance is bounded: directions that recent ticks do not
+    // excite (e.g. no prefill for a while) would otherwise grow without limit.
+    if (trace < kMaxTrace) {
+        for (auto& row : p_)
+            for (double& v : row)
+                v /= kForget;
+    }
+}
+
+StepCost::Coefficients StepCost::coefficients() const {
+    return {theta_[kFixed], theta_[kDecode], theta_[kPrefill], theta_[kKv]};
+}
+
+// Planning uses non-negative coefficients: a term the fit has not settled yet (or that
+// noise pushed below zero) must not make work look free or negative.
+double StepCost::predict_ms(int32_t decode_toks, int32_t prefill_toks, uint64_t kv) const {
+    return std::max(0.0, theta_[kFixed]) + decode_toks * std::max(0.0, theta_[kDecode]) +
+           prefill_toks * std::max(0.0, theta_[kPrefill]) +
+           (double)kv / 1000.0 * std::max(0.0, theta_[kKv]);
+}
+
+double StepCost::prefill_chunk_ms(int32_t n, int32_t n_past) const {
+    return n * std::max(0.0, theta_[kPrefill]) +
+           (double)kv_units(n_past, n) / 1000.0 * std::max(0.0, theta_[kKv]);
+}
+
+int32_t StepCost::prefill_within(double ms, int32_t n_past) const {
+    if (ms <= 0)
+        return 0;
+    // cost(n) = a·n² + b·n with the KV sum written out
+    const double kv = std::max(0.0, theta_[kKv]) / 1000.0;
+    const double a = kv / 2.0;
+    const double b = std::max(0.0, theta_[kPrefill]) + kv * (std::max(n_past, 0) + 0.5);
+    double n;
+    if (a > 0)
+        n = (-b + std::sqrt(b * b + 4.0 * a * ms)) / (2.0 * a);
+    else if (b > 0)
+        n = ms / b;
+    else
+        return INT_MAX;
+    return (int32_t)std::min(std::floor(n), (double)INT_MAX);
+}
+
+int32_t StepCost::decode_within(double ms, double n_past) const {
+    const double per_tok = std::max(0.0, theta_[kDecode]) +
+                           std::max(0.0, theta_[kKv]) * (std::max(n_past, 0.0) + 1.0) / 1000.0;
+    const double left = ms - std::max(0.0, theta_[kFixed]);
+    if (left <= 0)
+        return 0;
+    if (per_tok <= 0)
+        return INT_MAX;
+    return (int32_t)std::min(std::floor(left / per_tok), (double)INT_MAX);
+}
+
+} // namespace uma::sched
@@ -0,0 +1,72 @@
+// UMA Serve - Online step-time model shared by the scheduler and the planning policies
+#pragma once
+
+#include <cstdint>
+
+namespace uma::sched {
+
+// KV positions attended by a chunk of n tokens appended to a sequence that already holds
+// n_past tokens: sum over the chunk of (n_past + j + 1). Same units as bmt::estimate_units.
+inline uint64_t kv_units(int32_t n_past, int32_t n) {
+    if (n <= 0)
+        return 0;
+    const uint64_t base = n_past > 0 ? (uint64_t)n_past : 0;
+    return (uint64_t)n * base + (uint64_t)n * (uint64_t)(n + 1) / 2;
+}
+
+// Tick time as a linear function of what the tick carries:
+//   ms ≈ fixed + decode·decode_tokens + prefill·prefill_tokens + kv·(ΣKV positions / 1000)
+// fitted online by recursive least squares with exponential forgetting, so the model
+// follows the device (thermal state, other load) and the context lengths in flight. The
+// KV term is what makes a prefill chunk deep into a long context cost more than the same
+// number of decode tokens at short contexts.
+//
+// Until ticks of a kind have been observed the model cannot price them: decode_known() and
+// prefill_known() say whether it can. A prior (e.g. from an offline calibration) makes
+// both known from the start and is then refined by every observation.
+class StepCost {
+  public:
+    struct Coefficients {
+        double fixed_ms = 0.0;       // per tick
+        double decode_ms = 0.0;      // per decode token
+        double prefill_ms = 0.0;     // per prompt token
+        double kv_ms_per_k = 0.0;    // per 1000 attended KV positions
+    };
+
+    StepCost();
+    explicit StepCost(const Coefficients& prior);
+
+    // Feed one decoded tick: its token counts, ΣKV positions and measured duration.
+    void observe(int32_t decode_toks, int32_t prefill_toks, uint64_t kv, double ms);
+
+    double predict_ms(int32_t decode_toks, int32_t prefill_toks, uint64_t kv) const;
+    // Time a prefill chunk of n tokens at n_past adds to a tick (no fixed cost).
+    double prefill_chunk_ms(int32_t n, int32_t n_past) const;
+    // Most prefill tokens of one chunk at n_past that fit in `ms`.
+    int32_t prefill_within(double ms, int32_t n_past) const;
+    // Most decode tokens that fit in a tick of `ms`, for streams at mean context n_past.
+    int32_t decode_within(double ms, double n_past) const;
+
+    bool decode_known() const { return decode_known_; }
+    bool prefill_known() const { return prefill_known_; }
+    Coefficients coefficients() const;
+    // Mean absolute error of the prediction made before each observation (EWMA, ms).
+    double error_ms() const { return error_ms_; }
+    uint64_t samples() const { return samples_; }
+
+  private:
+    static constexpr int kN = 4;              // fixed, decode, prefill, kv
+    static constexpr double kForget = 0.99;   // weight kept by the past per observation
+    static constexpr double kPrior = 1.0e4;   // initial covariance: how little the prior is trusted
+    static constexpr double kMaxTrace = 1.0e8; // stop forgetting when unexcited directions blow up
+    static constexpr double kErrAlpha = 0.1;
+
+    double theta_[kN] = {};
+    double p_[kN][kN] = {};
+    double error_ms_ = 0.0;
+    uint64_t samples_ = 0;
+    bool decode_known_ = false;
+    bool prefill_known_ = false;
+};
+
+} // namespace uma::sched
@@ -1,5 +1,6 @@
 // UMA Serve — Daemon + model lifecycle (M1 subset)
 
+#include "ipc/io_engine.h"
 #include "ipc/poller.h"
 #include "ipc/protocol.h"
 #include "ipc/session.h"
@@ -8,20 +9,23 @@
 #include "metrics/metrics.h"
 #include "runtime/config.h"
 #include "runtime/model.h"
+#include "runtime/tokenizer_pool.h"
 #include "runtime/tokens.h"
+#include "sched/compute_worker.h"
 #include "sched/scheduler.h"
 #include "util/logging.h"
 
 #include "llama.h"
 
+#include <algorithm>
 #include <atomic>
 #include <cerrno>
 #include <csignal>
+#include <cstring>
 #include <fcntl.h>
 #include <filesystem>
 #include <iostream>
 #include <stdexcept>
-#include <sys/event.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <unistd.h>
@@ -46,6 +50,8 @@ void install_signal_handlers() {
     sa.sa_flags = 0; // do not set SA_RESTART so accept() is interrupted
     sigaction(SIGINT, &sa, nullptr);
     sigaction(SIGTERM, &sa, nullptr);
+    // Linux has no SO_NOSIGPIPE: a write to a closed peer must surface as EPIPE, not kill us
+    std::signal(SIGPIPE, SIG_IGN);
 }
 
 void print_usage() {
@@ -111,7 +117,7 @@ int main(int argc, char** argv) {
                         << (llama_model_has_encoder(model.get()) ? "true" : "false")
                         << " n_seq_max=" << llama_n_seq_max(admin_ctx.get());
 
-        // UDS server (kqueue, multi-client)
+        // UDS server (kqueue/epoll poller, multi-client)
         uma::ipc::UDSServer server(cfg.socket_path, cfg.socket_mode);
         if (!server.open_listen()) {
             UMA_LOG_ERROR() << "Failed to open UDS listen socket";
@@ -131,38 +137,124 @@ int main(int argc, char** argv) {
         // scheduler hook
         uma::sched::Scheduler scheduler(gctx, vocab, cfg, &mtx);
 
+        // Admission: one request per sequence slot; the rest queue or are shed
+        {
+            uma::ipc::AdmissionLimits adm;
+            adm.max_depth = cfg.admission_queue_depth;
+            adm.max_background = cfg.admission_queue_background;
+            adm.ttft_slack = cfg.admission_ttft_slack;
+            adm.initial_steps = cfg.max_tokens + 1;
+            sessions.configure_admission(adm, llama_n_seq_max(gctx));
+            sessions.set_step_ms(mtx.get_decode_ms_ewma());
+            sessions.set_metrics(&mtx);
+            UMA_LOG_INFO() << "admission: slots=" << llama_n_seq_max(gctx)
+                           << " queue_depth=" << adm.max_depth
+                           << " background=" << adm.max_background
+                           << " ttft_slack=" << adm.ttft_slack;
+        }
+
         auto now_ns = []() {
             using namespace std::chrono;
             return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
         };
 
+        // Long prompts are tokenized off the loop; completions wake the poller
+        std::unique_ptr<uma::runtime::TokenizerPool> tok_pool;
+        if (cfg.tokenizer_threads > 0) {
+            tok_pool = std::make_unique<uma::runtime::TokenizerPool>(
+                    cfg.tokenizer_threads,
+                    [vocab](const std::string& text, bool add_bos, bool special) {
+                        return uma::runtime::tokens::tokenize(vocab, text, add_bos, special);
+                    },
+                    [&poller] { poller.wake(); });
+            sessions.set_tokenizer(tok_pool.get());
+            UMA_LOG_INFO() << "tokenizer_threads=" << cfg.tokenizer_threads
+                           << " tokenize_inline_bytes=" << cfg.tokenize_inline_bytes;
+        }
+        std::vector<uma::runtime::TokenizeResult> tok_done;
+
+        // Decode on the compute thread: while a batch is in flight the loop keeps serving
+        // sockets, and the finished decode wakes it through the poller. Declared after the
+        // scheduler and poller so it is joined before either goes away.
+        std::unique_ptr<uma::sched::ComputeWorker> compute;
+        if (cfg.compute_thread) {
+            compute = std::make_unique<uma::sched::ComputeWorker>(
+                    [&scheduler] { return scheduler.decode_batch(); },
+                    [&poller] { poller.wake(); });
+        }
+        UMA_LOG_INFO() << "compute_thread=" << (compute ? "on" : "off");
+
+        // TX engine: tokens produced by a tick are flushed in one batch right after it
+        auto io = uma::ipc::make_io_engine(cfg.io_engine);
+        UMA_LOG_INFO() << "io_engine=" << io->name();
+        std::vector<uma::ipc::SendOp> send_ops;
+        std::vector<iovec> send_iov;
+        std::vector<int> fds_to_arm; // connections with new output this tick
+
+        // Called once a connection's tx has fully drained: close one-shot / failed connections,
+        // and half-closed ones whose requests have all finished.
+        auto finish_drained = [&](int fd) {
+            auto* cp = sessions.find_conn(fd);
+            if (!cp)
+                return;
+            if (cp->close_after_flush || (cp->read_closed && cp->requests.empty()))
+                sessions.close(fd, poller, gctx);
+        };
+
+        // Shared-memory connections: move queued frames into the ring (no syscalls unless the
+        // reader is blocked on its doorbell). A full ring leaves the rest in tx and the fd on
+        // ring_backlog, retried every millisecond until the reader catches up. A client that
+        // corrupts the ring is dropped; drain_ring() then returns false and c is gone.
+        // Backpressure: a connection the scheduler parked at the tx high-water mark rejoins
+        // decoding once its client has read tx down to the low-water mark.
+        auto resume_if_drained = [&](uma::ipc::Connection& c) {
+            if (c.tx_parked && c.tx.size() <= cfg.tx_low_water_bytes)
+                c.tx_parked = false;
+        };
+
+        std::vector<int> ring_backlog;
+        auto drain_ring = [&](uma::ipc::Connection& c) -> bool {
+            const size_t moved = c.ring->drain(c.tx);
+            if (c.ring->corrupt()) {
+                UMA_LOG_WARN() << "shm ring protocol violation on fd=" << c.fd
+                               << " (invalid tail); dropping connection";
+                sessions.drop_connection(c.fd, poller, gctx, cfg.max_tokens);
+                return false;
+            }
+            if (moved > 0) {
+                mtx.shm_bytes_total.fetch_add(moved, std::memory_order_relaxed);
+                if (c.ring->notify())
+                    mtx.shm_doorbells_total.fetch_add(1, std::memory_order_relaxed);
+                c.last_activity_ns = now_ns();
+                resume_if_drained(c);
+            }
+            if (!c.tx.empty() &&
+                std::find(ring_backlog.begin(), ring_backlog.end(), c.fd) == ring_backlog.end())
+                ring_backlog.push_back(c.fd);
+            return true;
+        };
+
         UMA_LOG_INFO() << "Ready. Use framed JSON over UDS at " << cfg.socket_path
                        << " (see README client snippet or uma-cli).";
 
         // main event loop
+        std::vector<uma::ipc::PollEvent> ready_events;
+        uint64_t next_idle_sweep_ns = 0;
         while (!g_shutdown.load(std::memory_order_relaxed)) {
-            struct kevent events[64];
-            // Dynamic timeout: if any session has ready work, don't sleep; otherwise idle for 200ms
-            bool has_ready_work = false;
-            for (auto& kv : sessions.map()) {
-                auto& s = *kv.second;
-                if ((s.state == uma::ipc::SessionState::PREFILL &&
-                     s.prefill_idx < s.prompt_tokens.size()) ||
-                    (s.state == uma::ipc::SessionState::DECODE && s.has_pending_tok)) {
-                    has_ready_work = true;
-                    break;
-                }
-            }
+            // Dynamic timeout: if a batch could be started now, don't sleep; otherwise idle for
+            // 200ms. A batch in flight on the compute thread wakes the poller when it finishes.
+            // Only the pool's ready lists are walked, not every attached session.
+            const bool has_ready_work =
+                    !scheduler.in_flight() && sessions.map().has_ready_work();
             int time_ms = 0;
             if (!has_ready_work) {
-                time_ms = 200 * 1000 * 1000;
+                time_ms = ring_backlog.empty() ? 200 : 1;
             }
-            std::vector<uma::ipc::PollEvent> ready_events;
             int nev = poller.wait(time_ms, ready_events);
             if (nev < 0) {
                 if (errno == EINTR)
                     continue;
-                std::perror("kevent(wait)");
+                std::perror("poller.wait");
                 break;
             }
 
@@ -181,140 +273,247 @@ int main(int argc, char** argv) {
                         int one = 1;
                         ::setsockopt(cfd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
 #endif
-                        if (sessions.map().size() >= cfg.max_sessions) {
-                            ::close(cfd);
+                        if (sessions.connections().size() >= cfg.max_sessions) {
+                            // over the connection cap: say so (with a retry hint) and close
+                            auto& c = sessions.add_client(cfd, now_ns());
+                            sessions.refuse_connection(c);
+                            c.tx.write_to(cfd);
+                            if (c.tx.empty())
+                                sessions.close(cfd, poller, gctx);
+                            else
+                                poller.add(cfd, uma::ipc::PollFlags::Write);
                             continue;
                         }
                         sessions.add_client(cfd, now_ns());
-                        poller.add(cfd, uma::ipc::PollFlags::Read);
+                        // on_readable drains to EAGAIN, so client reads can be edge-triggered
+                        poller.add(cfd, uma::ipc::PollFlags::Read | uma::ipc::PollFlags::Edge);
                         UMA_LOG_DEBUG() << "[accept] fd=" << cfd;
                     }
-                } else if (ev.readable()) {
+                    continue;
+                }
+                // A client event may report read and write readiness together: serve both,
+                // or an edge-triggered notification would be consumed with tx still pending.
+                if (ev.readable()) {
                     // client read via SessionManager
                     auto rr = sessions.on_readable(ev.fd, cfg, vocab, now_ns());
-                    auto* sp = sessions.find(ev.fd);
-                    if (!sp)
+                    if (rr.peer_gone) {
+                        // client hung up mid-request: free its sequences now, not at EOS
+                        sessions.drop_connection(ev.fd, poller, gctx, cfg.max_tokens);
                         goto next_event;
-                    auto& s = *sp;
+                    }
+                    auto* cp = sessions.find_conn(ev.fd);
+                    if (!cp)
+                        goto next_event;
+                    auto& c = *cp;
                     if (rr.admin_request) {
                         bool dbg = uma::util::Logger::instance().should(uma::util::LogLevel::Debug);
-                        std::string js = mtx.to_json((uint32_t)sessions.map().size(), dbg);
+                        uint32_t parked = 0;
+                        uint64_t buffered = 0;
+                        for (const auto& kv : sessions.connections()) {
+                            parked += kv.second->tx_parked;
+                            buffered += kv.second->tx.size();
+                        }
+                        mtx.parked_sessions.store(parked, std::memory_order_relaxed);
+                        mtx.tx_buffered_bytes.store(buffered, std::memory_order_relaxed);
+                        mtx.admission_queue_depth.store((uint32_t)sessions.admission().depth(),
+                                                        std::memory_order_relaxed);
+                        mtx.admission_queue_depth_background.store(
+                                (uint32_t)sessions.admission().depth(
+                                        uma::ipc::RequestClass::Background),
+                                std::memory_order_relaxed);
+                        std::string js = mtx.to_json((uint32_t)sessions.connections().size(), dbg);
                         // Wrap metrics in an event
                         std::string payload =
                                 std::string("{\"event\":\"metrics\",\"metrics\":") + js + "}";
-                        uma::ipc::protocol::write_frame(s.tx, payload);
-                        // One-shot admin response: close after flushing
-                        s.state = uma::ipc::SessionState::STREAM;
-                        s.read_closed = true;
-                        poller.remove(ev.fd, uma::ipc::PollFlags::Read);
+                        // One-shot admin response (close_after_flush is already set)
+                        uma::ipc::protocol::write_frame(c.tx, payload);
                         rr.wants_write = true;
                     }
                     if (rr.removed_read) {
                         poller.remove(ev.fd, uma::ipc::PollFlags::Read);
                     }
-                    if (rr.wants_write) {
-                        if (!s.tx.empty()) {
-                            // Try an immediate non-blocking drain; then arm write notifications if
-                            // needed.
-                            ssize_t w = ::write(ev.fd, s.tx.data(), s.tx.size());
-                            if (w > 0) {
-                                UMA_LOG_DEBUG() << "[write-now] fd=" << ev.fd << " wrote(rx)=" << w;
-                                s.tx.erase(s.tx.begin(), s.tx.begin() + w);
-                            }
+                    if (rr.wants_write && !c.tx.empty() && c.ring) {
+                        if (!drain_ring(c))
+                            goto next_event;
+                    } else if (rr.wants_write && !c.tx.empty()) {
+                        // Try an immediate non-blocking drain; then arm write notifications if
+                        // needed.
+                        ssize_t w = c.tx.write_to(ev.fd);
+                        mtx.tx_syscalls_total.fetch_add(1, std::memory_order_relaxed);
+                        if (w > 0) {
+                            UMA_LOG_DEBUG() << "[write-now] fd=" << ev.fd << " wrote(rx)=" << w;
+                            mtx.tx_bytes_total.fetch_add((uint64_t)w, std::memory_order_relaxed);
+                            resume_if_drained(c);
                         }
-                        if (!s.tx.empty()) {
+                        if (!c.tx.empty())
                             poller.add(ev.fd, uma::ipc::PollFlags::Write);
-                        } else {
-                            // If we finished writing immediately, finalize response handling now
-                            if (s.state == uma::ipc::SessionState::ERRORED) {
-                                sessions.close(ev.fd, poller, gctx);
-                            } else if (s.state == uma::ipc::SessionState::STREAM) {
-                                if (s.read_closed) {
-                                    sessions.close(ev.fd, poller, gctx);
-                                } else {
-                                    s.state = uma::ipc::SessionState::RECV_REQ;
-                                    s.prompt_tokens.clear();
-                                    s.prefill_idx = 0;
-                                    s.generated_count = 0;
-                                    s.has_pending_tok = false;
-                                    s.n_past = 0;
-                                    s.req_start_ns = 0;
-                                    s.first_emit_ns = 0;
-                                    s.last_emit_ns = 0;
-                                    // Ensure we are monitoring reads again
-                                    poller.add(ev.fd, uma::ipc::PollFlags::Read);
-                                }
-                            }
-                        }
                     }
-                } else if (ev.writable()) {
+                    if (c.tx.empty()) {
+                        // nothing pending: finalize one-shot / half-closed connections now
+                        finish_drained(ev.fd);
+                    }
+                }
+                if (ev.writable()) {
                     // client write
-                    auto* itp = sessions.find(ev.fd);
-                    if (!itp)
+                    auto* cp = sessions.find_conn(ev.fd);
+                    if (!cp)
                         continue;
-                    auto& s = *itp;
-                    while (!s.tx.empty()) {
-                        ssize_t w = ::write(ev.fd, s.tx.data(), s.tx.size());
+                    auto& c = *cp;
+                    while (!c.tx.empty()) {
+                        ssize_t w = c.tx.write_to(ev.fd);
+                        mtx.tx_syscalls_total.fetch_add(1, std::memory_order_relaxed);
                         if (w < 0) {
                             if (errno == EAGAIN || errno == EWOULDBLOCK)
                                 break;
-                            sessions.close(ev.fd, poller, gctx);
+                            sessions.drop_connection(ev.fd, poller, gctx, cfg.max_tokens);
                             goto next_event;
                         }
                         UMA_LOG_DEBUG() << "[write] fd=" << ev.fd << " wrote=" << w
-                                        << " tx_left=" << (s.tx.size() - (size_t)w);
-                        s.tx.erase(s.tx.begin(), s.tx.begin() + w);
-                        s.last_activity_ns = now_ns();
+                                        << " tx_left=" << c.tx.size();
+                        mtx.tx_bytes_total.fetch_add((uint64_t)w, std::memory_order_relaxed);
+                        c.last_activity_ns = now_ns();
                     }
-                    if (s.tx.empty()) {
+                    resume_if_drained(c);
+                    if (c.tx.empty()) {
                         // done streaming, stop write notifications
                         poller.remove(ev.fd, uma::ipc::PollFlags::Write);
-                        if (s.state == uma::ipc::SessionState::ERRORED) {
-                            // close errored sessions after flushing error
-                            sessions.close(ev.fd, poller, gctx);
-                        } else if (s.state == uma::ipc::SessionState::STREAM) {
-                            // finished a response
-                            if (s.read_closed) {
-                                sessions.close(ev.fd, poller, gctx);
-                            } else {
-                                s.state = uma::ipc::SessionState::RECV_REQ;
-                                s.prompt_tokens.clear();
-                                s.prefill_idx = 0;
-                                s.generated_count = 0;
-                                s.has_pending_tok = false;
-                                s.n_past = 0;
-                                s.req_start_ns = 0;
-                                s.first_emit_ns = 0;
-                                s.last_emit_ns = 0;
-                            }
-                        }
+                        finish_drained(ev.fd);
                     }
                 }
+                if (!ev.readable() && !ev.writable() && (ev.hup() || ev.err())) {
+                    // hangup reported without read/write readiness
+                    if (sessions.find_conn(ev.fd) && uma::ipc::UDSServer::peer_closed(ev.fd))
+                        sessions.drop_connection(ev.fd, poller, gctx, cfg.max_tokens);
+                }
             next_event:;
             }
 
-            // idle timeout cleanup
+            // idle timeout cleanup; the timeout is in whole seconds, so sweeping the
+            // connections once a second is enough
             uint64_t now = now_ns();
             uint64_t idle_ns = (uint64_t)cfg.idle_timeout_sec * 1000ull * 1000ull * 1000ull;
-            std::vector<int> to_close;
-            for (auto& kv : sessions.map()) {
-                auto& s = *kv.second;
-                if (idle_ns > 0 && now - s.last_activity_ns > idle_ns) {
-                    to_close.push_back(s.fd);
+            if (idle_ns > 0 && now >= next_idle_sweep_ns) {
+                next_idle_sweep_ns = now + 1000000000ull;
+                std::vector<int> to_close;
+                for (auto& kv : sessions.connections()) {
+                    auto& c = *kv.second;
+                    if (now - c.last_activity_ns > idle_ns) {
+                        to_close.push_back(c.fd);
+                    }
+                }
+                for (int fd_c : to_close)
+                    sessions.close(fd_c, poller, gctx);
+            }
+
+            // retry shared-memory rings that were full
+            if (!ring_backlog.empty()) {
+                std::vector<int> retry;
+                retry.swap(ring_backlog);
+                for (int fd_r : retry) {
+                    auto* cp = sessions.find_conn(fd_r);
+                    if (!cp || !cp->ring || !drain_ring(*cp))
+                        continue;
+                    if (cp->tx.empty())
+                        finish_drained(fd_r);
                 }
             }
-            for (int fd_c : to_close)
-                sessions.close(fd_c, poller, gctx);
 
             // ---- M3 Scheduler tick: build global batch from ready sessions ----
             // Two-phase policy per tick: (A) 1 token per DECODE session, (B) PREFILL drain in
             // chunks
             {
-                auto fds_to_arm = scheduler.tick(sessions.map(), now_ns());
+                // admit requests whose prompts finished tokenizing; they join this tick
+                fds_to_arm.clear();
+                if (tok_pool) {
+                    tok_done.clear();
+                    if (tok_pool->drain(tok_done) > 0) {
+                        const uint64_t t = now_ns();
+                        for (const auto& r : tok_done) {
+                            const uint64_t ns = t - r.submit_ns;
+                            mtx.tokenize_ns_total.fetch_add(ns, std::memory_order_relaxed);
+                            const uint32_t ms = (uint32_t)(ns / 1000000ull);
+                            if (ms > mtx.tokenize_ms_max.load(std::memory_order_relaxed))
+                                mtx.tokenize_ms_max.store(ms, std::memory_order_relaxed);
+                        }
+                        mtx.tokenize_jobs_total.fetch_add(tok_done.size(),
+                                                          std::memory_order_relaxed);
+                        sessions.on_tokenized(tok_done, fds_to_arm);
+                    }
+                    mtx.tokenize_queue_depth.store((uint32_t)tok_pool->depth(),
+                                                   std::memory_order_relaxed);
+                }
+                if (compute) {
+                    // collect a finished decode, then start the next batch right away so the
+                    // compute thread stays busy while this loop flushes and polls
+                    uma::sched::DecodeOutcome done;
+                    if (scheduler.in_flight() && compute->poll(done)) {
+                        scheduler.finish_tick(sessions.map(), now_ns(), done.rc, done.dur_ns,
+                                              fds_to_arm);
+                        sessions.set_kv_busy(false);
+                        sessions.flush_kv(gctx);
+                    }
+                    // retire finished requests before flushing so drained half-closed
+                    // connections can be closed below; their slots go to queued requests
+                    sessions.reap_finished(gctx);
+                    sessions.set_step_ms(mtx.get_decode_ms_ewma());
+                    sessions.admit_queued(now_ns());
+                    if (!scheduler.in_flight() && scheduler.begin_tick(sessions.map(), now_ns())) {
+                        sessions.set_kv_busy(true);
+                        compute->submit();
+                    }
+                } else {
+                    scheduler.tick(sessions.map(), now_ns(), fds_to_arm);
+                    sessions.reap_finished(gctx);
+                    sessions.set_step_ms(mtx.get_decode_ms_ewma());
+                    sessions.admit_queued(now_ns());
+                }
+                // on_tokenized and the tick append disjoint fds: both only report a
+                // connection whose tx was empty before
+                // Flush every session that produced output in one engine call; only sockets
+                // that could not take everything get Write interest armed.
+                send_ops.clear();
+                // sized up front so the iovec pointers handed to send_ops stay valid
+                send_iov.resize(fds_to_arm.size() * uma::ipc::TxQueue::kMaxIov);
                 for (int fd : fds_to_arm) {
-                    auto* itp = sessions.find(fd);
-                    if (itp && !itp->tx.empty()) {
-                        poller.add(fd, uma::ipc::PollFlags::Write);
+                    auto* cp = sessions.find_conn(fd);
+                    if (cp && cp->ring) {
+                        // shared-memory connection: no socket write at all
+                        if (drain_ring(*cp) && cp->tx.empty())
+                            finish_drained(fd);
+                        continue;
+                    }
+                    if (cp && !cp->tx.empty()) {
+                        iovec* iov = &send_iov[send_ops.size() * uma::ipc::TxQueue::kMaxIov];
+                        int cnt = cp->tx.fill_iov(iov, uma::ipc::TxQueue::kMaxIov);
+                        send_ops.push_back({fd, iov, cnt, 0});
+                    }
+                }
+                if (!send_ops.empty()) {
+                    size_t nsys = io->flush(send_ops);
+                    mtx.tx_syscalls_total.fetch_add(nsys, std::memory_order_relaxed);
+                    mtx.tx_flush_batches_total.fetch_add(1, std::memory_order_relaxed);
+                    const uint64_t flushed_ns = now_ns();
+                    for (const auto& op : send_ops) {
+                        auto* cp = sessions.find_conn(op.fd);
+                        if (!cp)
+                            continue;
+                        auto& c = *cp;
+                        if (op.result > 0) {
+                            c.tx.consume((size_t)op.result);
+                            mtx.tx_bytes_total.fetch_add((uint64_t)op.result,
+                                                         std::memory_order_relaxed);
+                            c.last_activity_ns = flushed_ns;
+                            resume_if_drained(c);
+                        } else if (op.result < 0 && op.result != -EAGAIN &&
+                                   op.result != -EWOULDBLOCK) {
+                            sessions.drop_connection(op.fd, poller, gctx, cfg.max_tokens);
+                            continue;
+                        }
+                        if (!c.tx.empty()) {
+                            poller.add(op.fd, uma::ipc::PollFlags::Write);
+                        } else {
+                            finish_drained(op.fd);
+                        }
                     }
                 }
             }
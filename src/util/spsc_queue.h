@@ -0,0 +1,73 @@
+// UMA Serve - Bounded lock-free single-producer/single-consumer queue
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace uma::util {
+
+// Ring of T with capacity rounded up to a power of two. Exactly one thread may push and
+// exactly one (other) thread may pop; neither ever blocks or takes a lock. Head and tail
+// live on separate cache lines, and each side caches the other's index so the shared line
+// is only re-read when the queue looks full (producer) or empty (consumer).
+template <class T> class SpscQueue {
+  public:
+    explicit SpscQueue(size_t capacity) {
+        size_t cap = 2;
+        while (cap < capacity)
+            cap <<= 1;
+        buf_.resize(cap);
+        mask_ = cap - 1;
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Producer side. false when full (v is left untouched).
+    bool push(T&& v) {
+        const size_t t = tail_.load(std::memory_order_relaxed);
+        if (t - head_cache_ > mask_) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (t - head_cache_ > mask_)
+                return false;
+        }
+        buf_[t & mask_] = std::move(v);
+        tail_.store(t + 1, std::memory_order_release);
+        return true;
+    }
+    bool push(const T& v) {
+        T copy = v;
+        return push(std::move(copy));
+    }
+
+    // Consumer side. false when empty.
+    bool pop(T& out) {
+        const size_t h = head_.load(std::memory_order_relaxed);
+        if (h == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (h == tail_cache_)
+                return false;
+        }
+        out = std::move(buf_[h & mask_]);
+        head_.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate from any thread; exact from either endpoint when the other is idle.
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+    size_t capacity() const { return mask_ + 1; }
+
+  private:
+    std::vector<T> buf_;
+    size_t mask_ = 0;
+    alignas(64) std::atomic<size_t> head_{0}; // next slot to pop (written by the consumer)
+    size_t tail_cache_ = 0;                   // consumer's last view of tail_
+    alignas(64) std::atomic<size_t> tail_{0}; // next slot to push (written by the producer)
+    size_t head_cache_ = 0;                   // producer's last view of head_
+};
+
+} // namespace uma::util
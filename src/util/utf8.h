@@ -1,6 +1,8 @@
-// UMA Serve - UTF-8 validation helper
+// UMA Serve - UTF-8 validation helpers
 #pragma once
 
+#include <cstddef>
+#include <string>
 #include <string_view>
 
 namespace uma::util {
@@ -53,5 +55,88 @@ inline bool is_valid_utf8(std::string_view s) {
     return remaining == 0;
 }
 
+// Decode the sequence starting at s[i] (s[i] >= 0x80). Returns its length when it is
+// well-formed. Otherwise returns 0 and sets *bad to the length of its maximal ill-formed
+// prefix (>= 1, the bytes one U+FFFD replaces). *truncated is set when that prefix runs
+// into the end of s, i.e. more bytes could still complete the sequence.
+inline size_t utf8_sequence(std::string_view s, size_t i, size_t* bad, bool* truncated) {
+    const unsigned char c = (unsigned char)s[i];
+    size_t need;
+    unsigned char lo = 0x80, hi = 0xBF; // allowed range of the first continuation byte
+    if (c >= 0xC2 && c <= 0xDF) {
+        need = 1;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        need = 2;
+        if (c == 0xE0)
+            lo = 0xA0; // overlong
+        else if (c == 0xED)
+            hi = 0x9F; // surrogates
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        need = 3;
+        if (c == 0xF0)
+            lo = 0x90; // overlong
+        else if (c == 0xF4)
+            hi = 0x8F; // > U+10FFFF
+    } else {
+        *bad = 1;
+        *truncated = false;
+        return 0;
+    }
+    for (size_t k = 1; k <= need; ++k) {
+        if (i + k >= s.size()) {
+            *bad = k;
+            *truncated = true;
+            return 0;
+        }
+        const unsigned char b = (unsigned char)s[i + k];
+        if (k == 1 ? (b < lo || b > hi) : (b & 0xC0) != 0x80) {
+            *bad = k;
+            *truncated = false;
+            return 0;
+        }
+    }
+    return need + 1;
+}
+
+// Number of trailing bytes of s (0-3) that start a multi-byte sequence the next bytes
+// could still complete. Streaming emitters hold these back instead of sending them.
+inline size_t utf8_incomplete_tail(std::string_view s) {
+    const size_t n = s.size();
+    for (size_t k = 1; k <= 3 && k <= n; ++k) {
+        const unsigned char c = (unsigned char)s[n - k];
+        if ((c & 0xC0) == 0x80)
+            continue; // continuation byte: keep looking for the lead
+        if (c < 0x80)
+            return 0;
+        size_t bad = 0;
+        bool truncated = false;
+        return (utf8_sequence(s, n - k, &bad, &truncated) == 0 && truncated) ? k : 0;
+    }
+    return 0;
+}
+
+// Append s to out, replacing each ill-formed sequence with U+FFFD.
+inline void append_utf8_sanitized(std::string& out, std::string_view s) {
+    size_t i = 0, run = 0;
+    while (i < s.size()) {
+        if ((unsigned char)s[i] < 0x80) {
+            ++i;
+            continue;
+        }
+        size_t bad = 0;
+        bool truncated = false;
+        const size_t len = utf8_sequence(s, i, &bad, &truncated);
+        if (len > 0) {
+            i += len;
+            continue;
+        }
+        out.append(s.data() + run, i - run);
+        out.append("\xEF\xBF\xBD", 3);
+        i += bad;
+        run = i;
+    }
+    out.append(s.data() + run, s.size() - run);
+}
+
 } // namespace uma::util
 
@@ -0,0 +1,221 @@
+// UMA Serve - Microbenchmark: single-pass JSON request parser vs. the per-key extractors
+// it replaced (each key searched from the start of the payload).
+//
+// Usage: uma_bench_json [iterations]
+#include "ipc/json_request.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// ---- baseline: the extractors session_manager used before parse_json_request ----
+
+std::string extract_json_string(std::string_view j, const char* key, bool& invalid_escape) {
+    invalid_escape = false;
+    size_t kpos = j.find("\"" + std::string(key) + "\"");
+    if (kpos == std::string::npos)
+        return {};
+    size_t colon = j.find(':', kpos);
+    if (colon == std::string::npos)
+        return {};
+    size_t q1 = j.find('"', colon);
+    if (q1 == std::string::npos)
+        return {};
+    size_t i = q1 + 1;
+    std::string out;
+    auto is_hex = [](char c) {
+        return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+    };
+    while (i < j.size()) {
+        char c = j[i++];
+        if (c == '\\') {
+            if (i >= j.size()) {
+                invalid_escape = true;
+                break;
+            }
+            char e = j[i++];
+            switch (e) {
+                case '"':
+                    out.push_back('"');
+                    break;
+                case '\\':
+                    out.push_back('\\');
+                    break;
+                case '/':
+                    out.push_back('/');
+                    break;
+                case 'b':
+                    out.push_back('\b');
+                    break;
+                case 'f':
+                    out.push_back('\f');
+                    break;
+                case 'n':
+                    out.push_back('\n');
+                    break;
+                case 'r':
+                    out.push_back('\r');
+                    break;
+                case 't':
+                    out.push_back('\t');
+                    break;
+                case 'u': {
+                    if (i + 4 > j.size() || !is_hex(j[i]) || !is_hex(j[i + 1]) ||
+                        !is_hex(j[i + 2]) || !is_hex(j[i + 3])) {
+                        invalid_escape = true;
+                        break;
+                    }
+                    // skip 4 hex digits; we won't decode here
+                    i += 4;
+                    // append placeholder; actual UTF-8 decoding not required for this test
+                    out.push_back('?');
+                    break;
+                }
+                default:
+                    // unsupported escape (e.g., \x) → invalid
+                    invalid_escape = true;
+                    break;
+            }
+            if (invalid_escape)
+                break;
+        } else if (c == '"') {
+            // end of string
+            break;
+        } else {
+            // control chars are invalid in JSON strings
+            if (static_cast<unsigned char>(c) < 0x20) {
+                invalid_escape = true;
+                break;
+            }
+            out.push_back(c);
+        }
+    }
+    return out;
+}
+
+// true iff `key` is present with the literal value false
+bool extract_json_false(std::string_view j, const char* key) {
+    size_t kpos = j.find("\"" + std::string(key) + "\"");
+    if (kpos == std::string::npos)
+        return false;
+    size_t colon = j.find(':', kpos);
+    if (colon == std::string::npos)
+        return false;
+    size_t i = j.find_first_not_of(" \t\r\n", colon + 1);
+    return i != std::string::npos && j.substr(i, 5) == "false";
+}
+
+// Minimal numeric extractor: parses unquoted JSON numbers after key
+void extract_json_number(std::string_view j, const char* key, bool& found, double& out_val) {
+    found = false;
+    out_val = 0.0;
+    std::string k = std::string("\"") + key + "\"";
+    size_t p = j.find(k);
+    if (p == std::string::npos) return;
+    size_t colon = j.find(':', p);
+    if (colon == std::string::npos) return;
+    // skip whitespace
+    size_t i = colon + 1;
+    while (i < j.size() && (j[i] == ' ' || j[i] == '\t' || j[i] == '\n' || j[i] == '\r')) ++i;
+    if (i >= j.size()) return;
+    // read until delimiter (comma or closing brace)
+    size_t start = i;
+    while (i < j.size()) {
+        char c = j[i];
+        if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == 'e' || c == 'E' || c == '.') {
+            ++i;
+            continue;
+        }
+        break;
+    }
+    if (i == start) return;
+    std::string num(j.substr(start, i - start));
+    char* endp = nullptr;
+    out_val = std::strtod(num.c_str(), &endp);
+    if (endp && endp != num.c_str()) {
+        found = true;
+    }
+}
+
+// All fields on_frame used to look up for a request frame.
+size_t legacy_parse(std::string_view js) {
+    bool inv = false, f = false;
+    double v = 0;
+    size_t sink = 0;
+    sink += extract_json_string(js, "type", inv).size();
+    sink += extract_json_string(js, "event", inv).size();
+    sink += extract_json_string(js, "id", inv).size();
+    sink += extract_json_string(js, "prompt", inv).size();
+    for (const char* k : {"temperature", "top_p", "top_k", "flush_ms", "min_tokens_per_frame"}) {
+        extract_json_number(js, k, f, v);
+        sink += f;
+    }
+    sink += extract_json_false(js, "stream");
+    return sink;
+}
+
+size_t single_pass_parse(std::string_view js, uma::ipc::JsonRequest& req) {
+    uma::ipc::parse_json_request(js, req);
+    return req.type.size() + req.event.size() + req.id.size() + req.prompt.size() +
+           req.temperature.has_value() + req.top_p.has_value() + req.top_k.has_value();
+}
+
+std::string make_request(size_t prompt_bytes, bool escapes) {
+    std::string prompt;
+    prompt.reserve(prompt_bytes + 16);
+    while (prompt.size() < prompt_bytes) {
+        prompt += "The quick brown fox jumps over the lazy dog. ";
+        if (escapes)
+            prompt += "\\n\\\"quoted\\\" caf\\u00e9 ";
+    }
+    // sampling keys placed after the prompt: the old extractors scan past it for each one
+    return "{\"id\":\"bench-1\",\"prompt\":\"" + prompt +
+           "\",\"stream\":true,\"temperature\":0.7,\"top_p\":0.9,\"top_k\":40}";
+}
+
+template <class F> double time_ns_per_op(int iters, F&& fn) {
+    size_t sink = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < iters; ++i)
+        sink += fn();
+    auto t1 = std::chrono::steady_clock::now();
+    if (sink == 42)
+        std::puts(""); // keep the work observable
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / iters;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int base_iters = argc > 1 ? std::atoi(argv[1]) : 20000;
+    struct Case {
+        const char* name;
+        size_t prompt_bytes;
+        bool escapes;
+    };
+    const std::vector<Case> cases = {
+            {"small (64 B)", 64, false},
+            {"medium (4 KiB)", 4096, false},
+            {"medium+esc (4 KiB)", 4096, true},
+            {"large (1 MiB)", 1 << 20, false},
+            {"large+esc (1 MiB)", 1 << 20, true},
+    };
+    std::printf("%-20s %10s %14s %14s %9s %10s\n", "case", "bytes", "legacy ns/op",
+                "1-pass ns/op", "speedup", "1-pass GB/s");
+    uma::ipc::JsonRequest req;
+    for (const auto& c : cases) {
+        const std::string js = make_request(c.prompt_bytes, c.escapes);
+        const int iters = std::max(3, (int)(base_iters * 64.0 / (double)js.size()));
+        const double legacy = time_ns_per_op(iters, [&] { return legacy_parse(js); });
+        const double fast = time_ns_per_op(iters, [&] { return single_pass_parse(js, req); });
+        std::printf("%-20s %10zu %14.0f %14.0f %8.2fx %10.2f\n", c.name, js.size(), legacy, fast,
+                    legacy / fast, (double)js.size() / fast);
+    }
+    return 0;
+}
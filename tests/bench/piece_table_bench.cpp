@@ -0,0 +1,110 @@
+// UMA Serve - Microbenchmark: per-token JSON emit cost with the piece table vs. the
+// detokenize-then-escape path it replaced (token_to_piece_str + escaping append).
+//
+// The vocabulary is synthetic and its piece lookup is a plain copy, so the baseline here
+// is a lower bound: the real llama_token_to_piece also walks the vocab's token attributes.
+//
+// Usage: uma_bench_pieces [tokens]
+#include "ipc/piece_table.h"
+#include "ipc/protocol.h"
+#include "ipc/tx_queue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+constexpr int32_t kVocab = 32000;
+
+// SentencePiece/BPE-like pieces: mostly short words with a leading space, plus some
+// punctuation that needs escaping and multi-byte / partial UTF-8 pieces.
+std::vector<std::string> make_vocab() {
+    std::mt19937 rng(7);
+    std::vector<std::string> v;
+    v.reserve(kVocab);
+    const char* special[] = {"\n", "\"", "\\", "\t", "\n\n", ".\"", "caf\xC3\xA9", "\xE2\x82"};
+    for (int32_t i = 0; i < kVocab; ++i) {
+        if (i % 97 == 0) {
+            v.emplace_back(special[(i / 97) % 8]);
+            continue;
+        }
+        std::string p = (i % 3) ? " " : "";
+        const int len = 1 + (int)(rng() % 8);
+        for (int k = 0; k < len; ++k)
+            p += (char)('a' + rng() % 26);
+        v.push_back(std::move(p));
+    }
+    return v;
+}
+
+// The former emit path: detokenize into a stack buffer, build a std::string, escape into tx.
+std::string token_to_piece_str(const std::vector<std::string>& vocab, int32_t id) {
+    char tmp[256];
+    const std::string& p = vocab[(size_t)id];
+    const size_t n = std::min(p.size(), sizeof(tmp));
+    std::memcpy(tmp, p.data(), n);
+    if (n == 0)
+        return {};
+    return std::string(tmp, tmp + n);
+}
+
+template <class F> double time_ns_per_token(const std::vector<int32_t>& ids, F&& emit) {
+    uma::ipc::TxQueue tx;
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < ids.size(); ++i) {
+        emit(tx, ids[i]);
+        if ((i & 63) == 63)
+            tx.consume(tx.size()); // a flush every 64 tokens, as after a busy tick
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / (double)ids.size();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t n_tokens = argc > 1 ? (size_t)std::atol(argv[1]) : 2000000;
+    const auto vocab = make_vocab();
+
+    auto b0 = std::chrono::steady_clock::now();
+    uma::ipc::PieceTable table;
+    table.build(kVocab, [&](int32_t id, char* buf, size_t cap) -> int {
+        const std::string& p = vocab[(size_t)id];
+        if (p.size() > cap)
+            return -(int)p.size();
+        std::memcpy(buf, p.data(), p.size());
+        return (int)p.size();
+    });
+    auto b1 = std::chrono::steady_clock::now();
+    std::printf("table: %d ids, %zu arena bytes, built in %.2f ms\n", table.size(),
+                table.arena_bytes(), std::chrono::duration<double, std::milli>(b1 - b0).count());
+
+    std::mt19937 rng(11);
+    std::vector<int32_t> ids(n_tokens);
+    for (auto& id : ids)
+        id = (int32_t)(rng() % kVocab);
+    const std::string prefix = uma::ipc::protocol::render_token_prefix("bench-1");
+
+    const double before = time_ns_per_token(ids, [&](uma::ipc::TxQueue& tx, int32_t id) {
+        std::string piece = token_to_piece_str(vocab, id);
+        if (!piece.empty())
+            uma::ipc::protocol::append_token_event(tx, prefix, piece, id);
+    });
+    const double after = time_ns_per_token(ids, [&](uma::ipc::TxQueue& tx, int32_t id) {
+        std::string_view piece = table.json(id);
+        if (!piece.empty())
+            uma::ipc::protocol::append_token_event_escaped(tx, prefix, piece, id);
+    });
+    std::printf("%-28s %10s\n", "path", "ns/token");
+    std::printf("%-28s %10.1f\n", "token_to_piece + escape", before);
+    std::printf("%-28s %10.1f\n", "piece table (pre-escaped)", after);
+    std::printf("speedup %.2fx\n", before / after);
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include "gtest/gtest.h"
+#include "ipc/admission.h"
+
+#include <cstring>
+
+using uma::ipc::AdmissionLimits;
+using uma::ipc::AdmissionQueue;
+using uma::ipc::RequestClass;
+
+namespace {
+
+AdmissionQueue make_queue(uint32_t depth, uint32_t background, double slack) {
+    AdmissionLimits lim;
+    lim.max_depth = depth;
+    lim.max_background = background;
+    lim.ttft_slack = slack;
+    lim.initial_steps = 40;
+    AdmissionQueue q;
+    q.set_limits(lim);
+    q.set_slots(4);
+    q.set_step_ms(10.0); // a slot frees every 40 * 10 / 4 = 100 ms
+    return q;
+}
+
+} // namespace
+
+TEST(Admission, ParsesRequestClass) {
+    RequestClass c = RequestClass::Interactive;
+    EXPECT_TRUE(uma::ipc::parse_request_class("background", 10, c));
+    EXPECT_EQ(c, RequestClass::Background);
+    EXPECT_TRUE(uma::ipc::parse_request_class("interactive", 11, c));
+    EXPECT_EQ(c, RequestClass::Interactive);
+    EXPECT_FALSE(uma::ipc::parse_request_class("batch", 5, c));
+}
+
+TEST(Admission, FifoWithRemovalAndPerClassDepth) {
+    AdmissionQueue q = make_queue(8, 4, 0);
+    q.push(1, RequestClass::Interactive, 100);
+    q.push(2, RequestClass::Background, 200);
+    q.push(3, RequestClass::Interactive, 300);
+    EXPECT_EQ(q.depth(), 3u);
+    EXPECT_EQ(q.depth(RequestClass::Background), 1u);
+
+    EXPECT_TRUE(q.remove(2));
+    EXPECT_FALSE(q.remove(2));
+    EXPECT_EQ(q.depth(RequestClass::Background), 0u);
+
+    int sid = 0;
+    uint64_t t = 0;
+    ASSERT_TRUE(q.pop(sid, t));
+    EXPECT_EQ(sid, 1);
+    EXPECT_EQ(t, 100u);
+    ASSERT_TRUE(q.pop(sid, t));
+    EXPECT_EQ(sid, 3);
+    EXPECT_FALSE(q.pop(sid, t));
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(Admission, PredictsWaitFromPositionAndStepTime) {
+    AdmissionQueue q = make_queue(8, 4, 0);
+    EXPECT_DOUBLE_EQ(q.predict_wait_ms(0), 100.0);
+    EXPECT_DOUBLE_EQ(q.predict_wait_ms(3), 400.0);
+    EXPECT_EQ(q.retry_hint_ms(), 100u);
+
+    // short requests free slots sooner
+    for (int i = 0; i < 50; ++i)
+        q.on_finished(8);
+    EXPECT_NEAR(q.steps_per_request(), 8.0, 0.01);
+    EXPECT_NEAR(q.predict_wait_ms(0), 20.0, 0.01);
+}
+
+TEST(Admission, RejectsWhenQueueOrClassIsFull) {
+    AdmissionQueue q = make_queue(3, 1, 0);
+    EXPECT_TRUE(q.check(RequestClass::Background, 150).admit);
+    q.push(1, RequestClass::Background, 0);
+    auto v = q.check(RequestClass::Background, 150);
+    EXPECT_FALSE(v.admit);
+    EXPECT_FALSE(v.shed);
+    EXPECT_EQ(v.retry_after_ms, 100u);
+    // interactive requests still have room
+    EXPECT_TRUE(q.check(RequestClass::Interactive, 150).admit);
+    q.push(2, RequestClass::Interactive, 0);
+    q.push(3, RequestClass::Interactive, 0);
+    v = q.check(RequestClass::Interactive, 150);
+    EXPECT_FALSE(v.admit);
+    EXPECT_NE(std::strstr(v.reason, "full"), nullptr);
+
+    // a queue depth of 0 never queues
+    AdmissionQueue none = make_queue(0, 0, 0);
+    EXPECT_FALSE(none.check(RequestClass::Interactive, 150).admit);
+}
+
+TEST(Admission, ShedsWhenPredictedWaitMissesTtftTarget) {
+    AdmissionQueue q = make_queue(16, 8, 2.0);
+    // alone in the queue: 100 ms predicted, within 2 x 150 ms
+    EXPECT_TRUE(q.check(RequestClass::Interactive, 150).admit);
+    q.push(1, RequestClass::Interactive, 0);
+    q.push(2, RequestClass::Interactive, 0);
+    // third in line: 300 ms, exactly the limit
+    EXPECT_TRUE(q.check(RequestClass::Interactive, 150).admit);
+    q.push(3, RequestClass::Interactive, 0);
+    q.push(4, RequestClass::Interactive, 0);
+    // fifth in line: 500 ms predicted; a retry fits once 200 ms of queue has drained
+    auto v = q.check(RequestClass::Interactive, 150);
+    EXPECT_FALSE(v.admit);
+    EXPECT_TRUE(v.shed);
+    EXPECT_DOUBLE_EQ(v.predicted_wait_ms, 500.0);
+    EXPECT_EQ(v.retry_after_ms, 200u);
+    // a relaxed per-request target still fits
+    EXPECT_TRUE(q.check(RequestClass::Interactive, 1000).admit);
+}
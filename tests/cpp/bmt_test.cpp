@@ -3,8 +3,6 @@
 #include "sched/policy.h"
 #include "ipc/session.h"
 
-#include <memory>
-
 using uma::sched::Plan;
 using uma::sched::BatchItem;
 using uma::sched::Phase;
@@ -13,24 +11,50 @@ TEST(BmtTest, EstimateSimple) {
     uma::ipc::SessionPool sessions;
 
     // DECODE session with n_past=10
-    {
-        auto s = std::make_unique<uma::ipc::ClientSession>();
-        s->fd = 1; s->state = uma::ipc::SessionState::DECODE; s->has_pending_tok = true; s->n_past = 10;
-        sessions.emplace(s->fd, std::move(s));
-    }
+    auto& dec = sessions.create();
+    sessions.set_state(dec, uma::ipc::SessionState::DECODE); dec.hot->has_pending_tok = true; dec.hot->n_past = 10;
     // PREFILL session with base n_past=5, chunk m=3 -> sum (6+7+8)=21
-    {
-        auto s = std::make_unique<uma::ipc::ClientSession>();
-        s->fd = 2; s->state = uma::ipc::SessionState::PREFILL; s->n_past = 5; s->prefill_idx = 0;
-        sessions.emplace(s->fd, std::move(s));
-    }
+    auto& pf = sessions.create();
+    sessions.set_state(pf, uma::ipc::SessionState::PREFILL); pf.hot->n_past = 5; pf.hot->prefill_idx = 0;
 
     Plan plan;
-    plan.items.push_back({1, Phase::DECODE, 1});
-    plan.items.push_back({2, Phase::PREFILL, 3});
+    plan.items.push_back({dec.sid, Phase::DECODE, 1});
+    plan.items.push_back({pf.sid, Phase::PREFILL, 3});
 
     uint64_t est = uma::sched::bmt::estimate_units(sessions, plan);
     // decode cost = 11; prefill sum = 21; total = 32
     EXPECT_EQ(est, 32u);
 }
 
+
+TEST(BmtTest, TrimDropsPrefillTailUntilWithinBudget) {
+    uma::ipc::SessionPool sessions;
+    auto& dec = sessions.create();
+    sessions.set_state(dec, uma::ipc::SessionState::DECODE); dec.hot->has_pending_tok = true; dec.hot->n_past = 10;
+    auto& pf = sessions.create();
+    sessions.set_state(pf, uma::ipc::SessionState::PREFILL); pf.hot->n_past = 5;
+
+    Plan plan;
+    plan.items.push_back({dec.sid, Phase::DECODE, 1});
+    plan.items.push_back({pf.sid, Phase::PREFILL, 3});
+    plan.decode_tok_count = 1;
+    plan.prefill_tok_count = 3;
+
+    bool trimmed = false;
+    uint64_t est = uma::sched::bmt::estimate_units(sessions, plan);
+    // 32 units; dropping the last prefill token (cost 8) gets to 24
+    est = uma::sched::bmt::trim_to_budget(sessions, plan, est, 25, trimmed);
+    EXPECT_TRUE(trimmed);
+    EXPECT_EQ(est, 24u);
+    EXPECT_EQ(plan.items[1].n_tokens, 2);
+    EXPECT_EQ(plan.prefill_tok_count, 2);
+    EXPECT_EQ(est, uma::sched::bmt::estimate_units(sessions, plan));
+
+    // decode is never trimmed, even when over budget
+    est = uma::sched::bmt::trim_to_budget(sessions, plan, est, 1, trimmed);
+    EXPECT_EQ(plan.items[1].n_tokens, 0);
+    EXPECT_EQ(est, 11u);
+
+    est = uma::sched::bmt::trim_to_budget(sessions, plan, est, 100, trimmed);
+    EXPECT_FALSE(trimmed);
+}
@@ -0,0 +1,56 @@
+#include "gtest/gtest.h"
+#include "ipc/byte_buffer.h"
+
+#include <cstring>
+#include <string>
+
+using uma::ipc::ByteBuffer;
+
+TEST(ByteBufferTest, AppendConsumeFifo) {
+    ByteBuffer b;
+    EXPECT_TRUE(b.empty());
+    b.append(std::string("hello "));
+    b.append(std::string("world"));
+    EXPECT_EQ(b.size(), 11u);
+    EXPECT_EQ(b.view(), "hello world");
+
+    b.consume(6);
+    EXPECT_EQ(b.view(), "world");
+    b.consume(100); // clamped
+    EXPECT_TRUE(b.empty());
+    EXPECT_EQ(b.size(), 0u);
+}
+
+TEST(ByteBufferTest, PrepareCommitWritesInPlace) {
+    ByteBuffer b;
+    uint8_t* p = b.prepare(16);
+    std::memcpy(p, "abc", 3);
+    b.commit(3);
+    EXPECT_EQ(b.view(), "abc");
+    EXPECT_GE(b.capacity(), 16u);
+}
+
+TEST(ByteBufferTest, ConsumeDoesNotMoveLiveBytes) {
+    ByteBuffer b;
+    b.append(std::string("0123456789"));
+    const uint8_t* before = b.data();
+    b.consume(4);
+    EXPECT_EQ(b.data(), before + 4);
+    EXPECT_EQ(b.view(), "456789");
+}
+
+// A slow consumer draining a little at a time while a producer keeps appending must not
+// grow the buffer without bound: the dead prefix gets reclaimed.
+TEST(ByteBufferTest, SteadyStateReusesCapacity) {
+    ByteBuffer b;
+    const std::string chunk(64, 'x');
+    for (int i = 0; i < 8; ++i) b.append(chunk);
+    size_t cap = 0;
+    for (int i = 0; i < 10000; ++i) {
+        b.consume(chunk.size());
+        b.append(chunk);
+        if (i == 100) cap = b.capacity();
+    }
+    EXPECT_EQ(b.size(), 8 * chunk.size());
+    EXPECT_EQ(b.capacity(), cap);
+}
@@ -0,0 +1,78 @@
+#include "gtest/gtest.h"
+#include "sched/compute_worker.h"
+#include "util/spsc_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+using uma::sched::ComputeWorker;
+using uma::sched::DecodeOutcome;
+using uma::util::SpscQueue;
+
+TEST(SpscQueue, FifoAndCapacity) {
+    SpscQueue<std::string> q(3); // rounded up to 4
+    EXPECT_EQ(q.capacity(), 4u);
+    std::string out;
+    EXPECT_FALSE(q.pop(out));
+    for (int i = 0; i < 4; ++i)
+        EXPECT_TRUE(q.push("v" + std::to_string(i)));
+    EXPECT_FALSE(q.push("overflow"));
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(q.pop(out));
+        EXPECT_EQ(out, "v" + std::to_string(i));
+    }
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(SpscQueue, CrossThreadOrder) {
+    SpscQueue<uint64_t> q(64);
+    constexpr uint64_t kN = 100000;
+    std::thread producer([&] {
+        for (uint64_t i = 0; i < kN;) {
+            if (q.push(i))
+                ++i;
+            else
+                std::this_thread::yield();
+        }
+    });
+    uint64_t expect = 0, v = 0;
+    while (expect < kN) {
+        if (q.pop(v)) {
+            ASSERT_EQ(v, expect);
+            ++expect;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+}
+
+TEST(ComputeWorker, RunsDecodesInOrderAndNotifies) {
+    std::atomic<int> calls{0};
+    std::atomic<int> wakes{0};
+    auto w = std::make_unique<ComputeWorker>(
+            [&] {
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                return calls.fetch_add(1) == 1 ? -1 : 0; // the second decode "fails"
+            },
+            [&] { wakes.fetch_add(1); });
+
+    DecodeOutcome d;
+    EXPECT_FALSE(w->poll(d));
+    // one batch in flight at a time, as the event loop drives it
+    for (uint64_t i = 1; i <= 3; ++i) {
+        EXPECT_EQ(w->submit(), i);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!w->poll(d) && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        EXPECT_EQ(d.ticket, i);
+        EXPECT_EQ(d.rc, i == 2 ? -1 : 0);
+        EXPECT_GE(d.dur_ns, 1000000u);
+    }
+    EXPECT_EQ(calls.load(), 3);
+    EXPECT_EQ(wakes.load(), 3);
+    w.reset(); // idle worker shuts down promptly
+}
@@ -0,0 +1,98 @@
+#include "gtest/gtest.h"
+#include "ipc/detokenizer.h"
+#include "ipc/piece_table.h"
+#include "util/utf8.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+using uma::ipc::PieceTable;
+using uma::ipc::StreamDetokenizer;
+
+namespace {
+
+PieceTable make_table(const std::vector<std::string>& vocab) {
+    PieceTable t;
+    t.build((int32_t)vocab.size(), [&vocab](int32_t id, char* buf, size_t cap) -> int {
+        const std::string& p = vocab[(size_t)id];
+        if (p.size() > cap)
+            return -(int)p.size();
+        std::memcpy(buf, p.data(), p.size());
+        return (int)p.size();
+    });
+    return t;
+}
+
+} // namespace
+
+TEST(Utf8, IncompleteTail) {
+    using uma::util::utf8_incomplete_tail;
+    EXPECT_EQ(utf8_incomplete_tail(""), 0u);
+    EXPECT_EQ(utf8_incomplete_tail("abc"), 0u);
+    EXPECT_EQ(utf8_incomplete_tail("a\xE2\x82\xAC"), 0u); // complete euro sign
+    EXPECT_EQ(utf8_incomplete_tail("a\xE2"), 1u);
+    EXPECT_EQ(utf8_incomplete_tail("a\xE2\x82"), 2u);
+    EXPECT_EQ(utf8_incomplete_tail("\xF0\x9F\x98"), 3u);
+    EXPECT_EQ(utf8_incomplete_tail("\xC3"), 1u);
+    // ill-formed tails are not held (they can never complete)
+    EXPECT_EQ(utf8_incomplete_tail("a\xE0\x80"), 0u); // overlong
+    EXPECT_EQ(utf8_incomplete_tail("a\xED\xA0"), 0u); // surrogate
+    EXPECT_EQ(utf8_incomplete_tail("a\x82"), 0u);     // stray continuation
+    EXPECT_EQ(utf8_incomplete_tail("a\xFF"), 0u);
+}
+
+TEST(Utf8, SanitizeReplacesIllFormedSequences) {
+    auto clean = [](std::string_view s) {
+        std::string out;
+        uma::util::append_utf8_sanitized(out, s);
+        return out;
+    };
+    EXPECT_EQ(clean("caf\xC3\xA9"), "caf\xC3\xA9");
+    EXPECT_EQ(clean("a\xFF" "b"), "a\xEF\xBF\xBD" "b");
+    // one replacement per maximal ill-formed prefix
+    EXPECT_EQ(clean("\xE2\x82" "A"), "\xEF\xBF\xBD" "A");
+    EXPECT_EQ(clean("\x80\x80"), "\xEF\xBF\xBD\xEF\xBF\xBD");
+    EXPECT_EQ(clean("\xF0\x9F\x98"), "\xEF\xBF\xBD");
+    EXPECT_TRUE(uma::util::is_valid_utf8(clean("x\xC0\xAF\xED\xA0\x80y")));
+}
+
+TEST(StreamDetokenizer, HoldsSplitCharactersUntilComplete) {
+    // byte-fallback pieces: U+1F600 split over three tokens, then the euro sign over two
+    const std::vector<std::string> vocab = {"Hi ", "\xF0\x9F", "\x98", "\x80", "\xE2",
+                                            "\x82\xAC\"", "!"};
+    const PieceTable t = make_table(vocab);
+    EXPECT_TRUE(t.whole(0));
+    EXPECT_FALSE(t.whole(1));
+
+    StreamDetokenizer d;
+    // whole pieces come straight from the table
+    EXPECT_EQ(d.push(t, 0, true).data(), t.json(0).data());
+    EXPECT_TRUE(d.push(t, 1, true).empty());
+    EXPECT_TRUE(d.holding());
+    EXPECT_TRUE(d.push(t, 2, true).empty());
+    EXPECT_EQ(d.pending_id(), 2);
+    EXPECT_EQ(d.push(t, 3, true), "\xF0\x9F\x98\x80");
+    EXPECT_FALSE(d.holding());
+    EXPECT_TRUE(d.push(t, 4, false).empty());
+    EXPECT_EQ(d.push(t, 5, false), "\xE2\x82\xAC\"");
+    EXPECT_TRUE(d.push(t, 4, true).empty());
+    EXPECT_EQ(d.push(t, 5, true), "\xE2\x82\xAC\\\""); // escaped after joining
+    EXPECT_TRUE(d.finish(true).empty());
+}
+
+TEST(StreamDetokenizer, BrokenSequencesBecomeReplacementCharacters) {
+    const std::vector<std::string> vocab = {"\xE2", "!", "\x80"};
+    const PieceTable t = make_table(vocab);
+    StreamDetokenizer d;
+    EXPECT_TRUE(d.push(t, 0, true).empty());
+    // the next piece cannot continue the character: U+FFFD, then the piece
+    EXPECT_EQ(d.push(t, 1, true), "\xEF\xBF\xBD!");
+    // a stray continuation byte is replaced right away, never held
+    EXPECT_EQ(d.push(t, 2, true), "\xEF\xBF\xBD");
+    EXPECT_FALSE(d.holding());
+    // end of stream inside a character
+    EXPECT_TRUE(d.push(t, 0, true).empty());
+    EXPECT_EQ(d.finish(true), "\xEF\xBF\xBD");
+    EXPECT_FALSE(d.holding());
+}
@@ -2,10 +2,11 @@
 #include "ipc/protocol.h"
 #include <vector>
 #include <string>
+#include <string_view>
 
 // Test case for try_read_frame with an oversized frame
 TEST(ProtocolTest, TryReadFrameOversized) {
-    std::vector<uint8_t> rx;
+    uma::ipc::ByteBuffer rx;
     // Create a length header indicating a frame larger than kDefaultMaxFrameBytes
     // kDefaultMaxFrameBytes is 1 MiB, so 2 MiB will be too large
     uint32_t oversized_len = 2 * 1024 * 1024; 
@@ -28,7 +29,7 @@ TEST(ProtocolTest, TryReadFrameOversized) {
 
 // Test case for try_read_frame with an incomplete frame (not enough payload data)
 TEST(ProtocolTest, TryReadFrameIncomplete) {
-    std::vector<uint8_t> rx;
+    uma::ipc::ByteBuffer rx;
     // Length header indicating a payload of 10 bytes
     uint32_t len = 10;
     rx.push_back((uint8_t)(len & 0xFF));
@@ -50,7 +51,8 @@ TEST(ProtocolTest, TryReadFrameIncomplete) {
 
 // Test case for try_read_frame with too few bytes to even read the length header
 TEST(ProtocolTest, TryReadFrameTooShortForHeader) {
-    std::vector<uint8_t> rx = {0x01, 0x02, 0x03}; // Only 3 bytes
+    uma::ipc::ByteBuffer rx; // Only 3 bytes
+    rx.push_back(0x01); rx.push_back(0x02); rx.push_back(0x03);
     std::string out_json;
     std::string err_msg;
     bool result = uma::ipc::protocol::try_read_frame(rx, out_json, uma::ipc::protocol::kDefaultMaxFrameBytes, &err_msg);
@@ -61,7 +63,7 @@ TEST(ProtocolTest, TryReadFrameTooShortForHeader) {
 
 // Test case for try_read_frame with a zero length frame (invalid)
 TEST(ProtocolTest, TryReadFrameZeroLength) {
-    std::vector<uint8_t> rx;
+    uma::ipc::ByteBuffer rx;
     uint32_t zero_len = 0;
     rx.push_back((uint8_t)(zero_len & 0xFF));
     rx.push_back((uint8_t)((zero_len >> 8) & 0xFF));
@@ -78,7 +80,7 @@ TEST(ProtocolTest, TryReadFrameZeroLength) {
 
 // Test write_frame + try_read_frame roundtrip with multiple frames
 TEST(ProtocolTest, WriteReadRoundtrip) {
-    std::vector<uint8_t> buf;
+    uma::ipc::ByteBuffer buf;
     std::string js1 = "{\"a\":1}";
     std::string js2 = "{\"b\":\"text\"}";
     uma::ipc::protocol::write_frame(buf, js1);
@@ -95,3 +97,77 @@ TEST(ProtocolTest, WriteReadRoundtrip) {
     ASSERT_EQ(out, js2);
     ASSERT_TRUE(buf.empty());
 }
+
+// peek_frame exposes the payload in place; consume() releases it without copying
+TEST(ProtocolTest, PeekFrameZeroCopyThenConsume) {
+    uma::ipc::ByteBuffer buf;
+    uma::ipc::protocol::write_frame(buf, std::string("{\"a\":1}"));
+    uma::ipc::protocol::write_frame(buf, std::string("{\"b\":2}"));
+
+    std::string_view js;
+    size_t frame_bytes = 0;
+    std::string err;
+    ASSERT_TRUE(uma::ipc::protocol::peek_frame(buf, js, frame_bytes, uma::ipc::protocol::kDefaultMaxFrameBytes, &err));
+    EXPECT_EQ(js, "{\"a\":1}");
+    EXPECT_EQ(frame_bytes, 4u + js.size());
+    EXPECT_EQ(reinterpret_cast<const uint8_t*>(js.data()), buf.data() + 4);
+
+    buf.consume(frame_bytes);
+    // the view stays valid across consume()
+    EXPECT_EQ(js, "{\"a\":1}");
+    ASSERT_TRUE(uma::ipc::protocol::peek_frame(buf, js, frame_bytes, uma::ipc::protocol::kDefaultMaxFrameBytes, &err));
+    EXPECT_EQ(js, "{\"b\":2}");
+    buf.consume(frame_bytes);
+    EXPECT_TRUE(buf.empty());
+}
+
+TEST(ProtocolTest, VarintRoundtrip) {
+    const uint64_t vals[] = {0, 1, 127, 128, 300, 151935, UINT32_MAX, UINT64_MAX};
+    for (uint64_t v : vals) {
+        uint8_t buf[uma::ipc::protocol::kMaxVarintBytes];
+        size_t n = uma::ipc::protocol::put_varint(buf, v);
+        const uint8_t* p = buf;
+        uint64_t got = 0;
+        ASSERT_TRUE(uma::ipc::protocol::get_varint(p, buf + n, got));
+        EXPECT_EQ(got, v);
+        EXPECT_EQ(p, buf + n);
+        // truncated input must be rejected
+        if (n > 1) {
+            p = buf;
+            EXPECT_FALSE(uma::ipc::protocol::get_varint(p, buf + n - 1, got));
+        }
+    }
+}
+
+// Binary token events: tag + varint handle + varint id + raw UTF-8 (no escaping)
+TEST(ProtocolTest, BinaryTokenEventRoundtrip) {
+    uma::ipc::TxQueue tx;
+    const std::string text = "\"h\xC3\xA9\"\n";
+    uma::ipc::protocol::append_token_event_bin(tx, 3, 151935, text);
+    uma::ipc::protocol::append_token_event_bin(tx, 3, 7, {});
+
+    uma::ipc::ByteBuffer rx;
+    struct iovec iov[uma::ipc::TxQueue::kMaxIov];
+    int n = tx.fill_iov(iov, uma::ipc::TxQueue::kMaxIov);
+    for (int i = 0; i < n; ++i) rx.append(iov[i].iov_base, iov[i].iov_len);
+
+    std::string payload, err;
+    ASSERT_TRUE(uma::ipc::protocol::try_read_frame(rx, payload, uma::ipc::protocol::kDefaultMaxFrameBytes, &err));
+    EXPECT_TRUE(uma::ipc::protocol::is_binary_payload(payload));
+    EXPECT_EQ(payload.size(), 1u + 1u + 3u + text.size());
+    uma::ipc::protocol::BinTokenEvent ev;
+    ASSERT_TRUE(uma::ipc::protocol::parse_token_event_bin(payload, ev));
+    EXPECT_EQ(ev.handle, 3u);
+    EXPECT_EQ(ev.token_id, 151935);
+    EXPECT_EQ(ev.text, text);
+
+    ASSERT_TRUE(uma::ipc::protocol::try_read_frame(rx, payload, uma::ipc::protocol::kDefaultMaxFrameBytes, &err));
+    ASSERT_TRUE(uma::ipc::protocol::parse_token_event_bin(payload, ev));
+    EXPECT_EQ(ev.token_id, 7);
+    EXPECT_TRUE(ev.text.empty());
+    EXPECT_TRUE(rx.empty());
+
+    // JSON payloads are never mistaken for binary ones
+    EXPECT_FALSE(uma::ipc::protocol::is_binary_payload("{\"event\":\"eos\"}"));
+    EXPECT_FALSE(uma::ipc::protocol::parse_token_event_bin(std::string("\x01\x80", 2), ev));
+}
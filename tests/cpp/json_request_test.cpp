@@ -0,0 +1,200 @@
+#include "gtest/gtest.h"
+#include "ipc/json_request.h"
+
+#include <string>
+
+using uma::ipc::JsonParseStatus;
+using uma::ipc::JsonRequest;
+using uma::ipc::parse_json_request;
+
+TEST(JsonRequest, ParsesTypedFields) {
+    JsonRequest r;
+    ASSERT_EQ(parse_json_request(R"({"id":"r1","prompt":"Hi there","stream":false,"temperature":0.7,
+        "top_p":0.9,"top_k":40,"flush_ms":25,"min_tokens_per_frame":4})",
+                                 r),
+              JsonParseStatus::Ok);
+    EXPECT_EQ(r.id, "r1");
+    EXPECT_EQ(r.prompt, "Hi there");
+    ASSERT_TRUE(r.stream.has_value());
+    EXPECT_FALSE(*r.stream);
+    EXPECT_DOUBLE_EQ(r.temperature.value_or(-1), 0.7);
+    EXPECT_DOUBLE_EQ(r.top_p.value_or(-1), 0.9);
+    EXPECT_DOUBLE_EQ(r.top_k.value_or(-1), 40);
+    EXPECT_DOUBLE_EQ(r.flush_ms.value_or(-1), 25);
+    EXPECT_DOUBLE_EQ(r.min_tokens_per_frame.value_or(-1), 4);
+    EXPECT_FALSE(r.text.has_value());
+
+    ASSERT_EQ(parse_json_request(R"( { "type" : "hello", "stream_format":"binary", "text":false,
+        "transport":"shm", "shm_bytes": 65536 } )",
+                                 r),
+              JsonParseStatus::Ok);
+    EXPECT_EQ(r.type, "hello");
+    EXPECT_EQ(r.stream_format, "binary");
+    EXPECT_EQ(r.transport, "shm");
+    EXPECT_EQ(r.text, false);
+    EXPECT_DOUBLE_EQ(r.shm_bytes.value_or(0), 65536);
+    EXPECT_TRUE(r.id.empty()); // fields of the previous frame are cleared
+    EXPECT_FALSE(r.temperature.has_value());
+}
+
+TEST(JsonRequest, DecodesEscapesAndUnicode) {
+    JsonRequest r;
+    ASSERT_EQ(parse_json_request(
+                      R"({"prompt":"a\"b\\c\/d\n\t\u00e9\u4E2D\ud83d\ude00\u0020A"})", r),
+              JsonParseStatus::Ok);
+    EXPECT_EQ(r.prompt, "a\"b\\c/d\n\t\xC3\xA9\xE4\xB8\xAD\xF0\x9F\x98\x80 A");
+
+    // raw multi-byte UTF-8 passes through unchanged
+    ASSERT_EQ(parse_json_request("{\"prompt\":\"caf\xC3\xA9 \xE2\x82\xAC\"}", r),
+              JsonParseStatus::Ok);
+    EXPECT_EQ(r.prompt, "caf\xC3\xA9 \xE2\x82\xAC");
+}
+
+TEST(JsonRequest, IgnoresNestedAndUnknownKeys) {
+    JsonRequest r;
+    ASSERT_EQ(parse_json_request(R"({"metadata":{"prompt":"nested","id":["x",{"type":"metrics"}]},
+        "id":"outer","slo":{"target_ttft_ms":120,"extra":null,"target_tbt_ms":40,"priority":2},
+        "prompt":"top","class":"background","unknown":[1,2.5e3,true,false,null]})",
+                                 r),
+              JsonParseStatus::Ok);
+    EXPECT_EQ(r.id, "outer");
+    EXPECT_EQ(r.prompt, "top");
+    EXPECT_TRUE(r.type.empty());
+    EXPECT_DOUBLE_EQ(r.slo_ttft_ms.value_or(0), 120);
+    EXPECT_DOUBLE_EQ(r.slo_tbt_ms.value_or(0), 40);
+    EXPECT_DOUBLE_EQ(r.slo_priority.value_or(0), 2);
+    EXPECT_EQ(r.request_class, "background");
+
+    // a value of the wrong type leaves the field unset
+    ASSERT_EQ(parse_json_request(R"({"prompt":123,"temperature":"hot","stream":"yes"})", r),
+              JsonParseStatus::Ok);
+    EXPECT_TRUE(r.prompt.empty());
+    EXPECT_FALSE(r.temperature.has_value());
+    EXPECT_FALSE(r.stream.has_value());
+}
+
+TEST(JsonRequest, RejectsBadStrings) {
+    JsonRequest r;
+    // the id decoded before the error is kept for the error event
+    EXPECT_EQ(parse_json_request(R"({"id":"bad","prompt":"Hello \xc0bad"})", r),
+              JsonParseStatus::BadString);
+    EXPECT_EQ(r.id, "bad");
+    EXPECT_EQ(parse_json_request(R"({"prompt":"\u12"})", r), JsonParseStatus::BadString);
+    EXPECT_EQ(parse_json_request(R"({"prompt":"\ud83d"})", r), JsonParseStatus::BadString);
+    EXPECT_EQ(parse_json_request(R"({"prompt":"\ude00"})", r), JsonParseStatus::BadString);
+    EXPECT_EQ(parse_json_request("{\"prompt\":\"tab\there\"}", r), JsonParseStatus::BadString);
+    EXPECT_EQ(parse_json_request("{\"prompt\":\"\xC0\xAF\"}", r), JsonParseStatus::BadString);
+    // invalid strings are caught inside skipped values too
+    EXPECT_EQ(parse_json_request(R"({"meta":{"k":"\q"},"prompt":"x"})", r),
+              JsonParseStatus::BadString);
+    EXPECT_EQ(parse_json_request("{\"meta\":[\"\xFF\"],\"prompt\":\"x\"}", r),
+              JsonParseStatus::BadString);
+    // keys are validated the same way at the top level and inside "slo"
+    EXPECT_EQ(parse_json_request("{\"k\xC0\xAF\":1,\"prompt\":\"x\"}", r),
+              JsonParseStatus::BadString);
+    EXPECT_EQ(parse_json_request("{\"slo\":{\"k\xC0\xAF\":1},\"prompt\":\"x\"}", r),
+              JsonParseStatus::BadString);
+}
+
+TEST(JsonRequest, LongNumbersAreValid) {
+    JsonRequest r;
+    const std::string digits = "0." + std::string(70, '0') + "5";
+    const std::string big = "4" + std::string(80, '0') + "e-80";
+    ASSERT_EQ(parse_json_request("{\"temperature\":" + digits + ",\"top_k\":" + big +
+                                         ",\"slo\":{\"target_ttft_ms\":" + big + "}}",
+                                 r),
+              JsonParseStatus::Ok);
+    EXPECT_DOUBLE_EQ(r.temperature.value_or(-1), 5e-71);
+    EXPECT_DOUBLE_EQ(r.top_k.value_or(-1), 4);
+    EXPECT_DOUBLE_EQ(r.slo_ttft_ms.value_or(-1), 4);
+}
+
+TEST(JsonRequest, RejectsMalformedObjects) {
+    JsonRequest r;
+    const char* bad[] = {
+            "",
+            "[]",
+            R"({"prompt":"x")",
+            R"({"prompt":"x"} trailing)",
+            R"({"prompt" "x"})",
+            R"({"prompt":"x",})",
+            R"({"top_k":01})",
+            R"({"top_k":1.})",
+            R"({"stream":tru})",
+            R"({"prompt":"unterminated)",
+    };
+    for (const char* js : bad)
+        EXPECT_EQ(parse_json_request(js, r), JsonParseStatus::Syntax) << js;
+
+    std::string deep(100, '[');
+    EXPECT_EQ(parse_json_request("{\"a\":" + deep, r), JsonParseStatus::Syntax);
+}
+
+TEST(JsonRequest, LongPromptAcrossVectorBlocks) {
+    // escapes and stop bytes at every offset relative to the 16-byte scan blocks
+    std::string expect, js = "{\"id\":\"long\",\"prompt\":\"";
+    for (int i = 0; i < 4000; ++i) {
+        if (i % 37 == 0) {
+            js += "\\n";
+            expect += '\n';
+        } else if (i % 53 == 0) {
+            js += "\\u00fc";
+            expect += "\xC3\xBC";
+        } else {
+            js += static_cast<char>('a' + i % 26);
+            expect += static_cast<char>('a' + i % 26);
+        }
+    }
+    js += "\"}";
+    JsonRequest r;
+    ASSERT_EQ(parse_json_request(js, r), JsonParseStatus::Ok);
+    EXPECT_EQ(r.prompt, expect);
+
+    // reusing the request keeps its buffers
+    const auto* data = r.prompt.data();
+    ASSERT_EQ(parse_json_request(js, r), JsonParseStatus::Ok);
+    EXPECT_EQ(r.prompt.data(), data);
+}
+
+TEST(JsonRequest, ParsesPromptTokens) {
+    JsonRequest r;
+    ASSERT_EQ(parse_json_request(R"({"id":"t","prompt_tokens":[1, 15043, 0 ,2147483647],
+        "return_prompt_tokens":true})",
+                                 r),
+              JsonParseStatus::Ok);
+    ASSERT_TRUE(r.has_prompt_tokens);
+    EXPECT_EQ(r.prompt_tokens, (std::vector<int32_t>{1, 15043, 0, 2147483647}));
+    EXPECT_EQ(r.return_prompt_tokens, true);
+    EXPECT_TRUE(r.prompt.empty());
+
+    // values that are not int32 ids become -1 (rejected by the vocab range check)
+    ASSERT_EQ(parse_json_request(R"({"prompt_tokens":[7,1.5,"x",2147483648,-3,1e2,null]})", r),
+              JsonParseStatus::Ok);
+    EXPECT_EQ(r.prompt_tokens, (std::vector<int32_t>{7, -1, -1, -1, -3, -1, -1}));
+
+    ASSERT_EQ(parse_json_request(R"({"prompt_tokens":[]})", r), JsonParseStatus::Ok);
+    EXPECT_TRUE(r.has_prompt_tokens);
+    EXPECT_TRUE(r.prompt_tokens.empty());
+
+    EXPECT_EQ(parse_json_request(R"({"prompt_tokens":[01]})", r), JsonParseStatus::Syntax);
+    EXPECT_EQ(parse_json_request(R"({"prompt_tokens":[1,]})", r), JsonParseStatus::Syntax);
+}
+
+TEST(JsonRequest, DecodesPackedTokenBlob) {
+    JsonRequest r;
+    // [1, 15043, 0x01020304] as little-endian int32: 01000000 c33a0000 04030201
+    ASSERT_EQ(parse_json_request(R"({"prompt_tokens":"AQAAAMM6AAAEAwIB"})", r),
+              JsonParseStatus::Ok);
+    EXPECT_EQ(r.prompt_tokens, (std::vector<int32_t>{1, 15043, 0x01020304}));
+
+    // one id (4 bytes) needs padding: "AQAAAA=="
+    ASSERT_EQ(parse_json_request(R"({"prompt_tokens":"AQAAAA=="})", r), JsonParseStatus::Ok);
+    EXPECT_EQ(r.prompt_tokens, (std::vector<int32_t>{1}));
+
+    // bad alphabet / length / not a whole number of ids
+    for (const char* js : {R"({"prompt_tokens":"AQAA*AAA"})", R"({"prompt_tokens":"AQA"})",
+                           R"({"prompt_tokens":"AQAA"})"}) {
+        ASSERT_EQ(parse_json_request(js, r), JsonParseStatus::Ok) << js;
+        EXPECT_EQ(r.prompt_tokens, (std::vector<int32_t>{-1})) << js;
+    }
+}
@@ -0,0 +1,169 @@
+#include "gtest/gtest.h"
+#include "ipc/session.h"
+#include "sched/latency_guard.h"
+#include "sched/policy.h"
+#include "sched/step_cost.h"
+
+using uma::sched::BaselinePolicy;
+using uma::sched::LatencyGuard;
+using uma::sched::Phase;
+using uma::sched::Plan;
+using uma::sched::StepCost;
+
+namespace {
+
+// Two decoding streams and one request with a long prompt that already has its first token
+// (so BaselinePolicy gives it the whole remaining budget: 62 tokens at target 64).
+void fill_pool(uma::ipc::SessionPool& sessions, bool with_decode = true) {
+    for (int i = 0; with_decode && i < 2; ++i) {
+        auto& s = sessions.create();
+        sessions.set_state(s, uma::ipc::SessionState::DECODE);
+        s.hot->seq = i; s.hot->has_pending_tok = true; s.hot->n_past = 10;
+    }
+    auto& p = sessions.create();
+    sessions.set_state(p, uma::ipc::SessionState::PREFILL);
+    p.hot->seq = 2;
+    p.first_emit_ns = 1;
+    p.prompt_tokens.assign(1000, 1);
+}
+
+LatencyGuard::Params params() {
+    LatencyGuard::Params p;
+    p.budget_ms = 10.0;
+    p.hold_ticks = 2;
+    p.ramp_ticks = 2;
+    p.min_prefill = 4;
+    return p;
+}
+
+Plan plan(LatencyGuard& g, const uma::ipc::SessionPool& sessions) {
+    return g.schedule_tick(sessions, /*batch_cap*/64, /*target*/64, 0, 0);
+}
+
+// A device where a tick costs decode_ms per decode token and prefill_ms per prompt token,
+// nothing else: the model starts from it and the ticks below agree with it.
+StepCost device(double decode_ms, double prefill_ms) {
+    StepCost::Coefficients c;
+    c.decode_ms = decode_ms;
+    c.prefill_ms = prefill_ms;
+    return StepCost(c);
+}
+
+// What the scheduler does after a decode: feed the cost model, then the guard.
+void decoded(StepCost& cost, LatencyGuard& g, int32_t decode, int32_t prefill, double ms,
+             int32_t background = 0) {
+    cost.observe(decode, prefill, /*kv*/0, ms);
+    g.observe(decode, prefill, ms, background);
+}
+
+} // namespace
+
+TEST(LatencyGuardTest, PassesThroughUntilCostsAreKnown) {
+    uma::ipc::SessionPool sessions;
+    fill_pool(sessions);
+    BaselinePolicy base;
+    StepCost cost;
+    LatencyGuard g(base, cost, params());
+    Plan p = plan(g, sessions);
+    EXPECT_EQ(p.decode_tok_count, 2);
+    EXPECT_EQ(p.prefill_tok_count, 62);
+    EXPECT_EQ(g.last_trimmed(), 0);
+    EXPECT_FALSE(g.active());
+}
+
+TEST(LatencyGuardTest, OvershootHoldsPrefillThenRampsBack) {
+    uma::ipc::SessionPool sessions;
+    fill_pool(sessions);
+    BaselinePolicy base;
+    StepCost cost = device(1.0, 0.5);
+    LatencyGuard g(base, cost, params());
+    decoded(cost, g, 2, 0, 2.0);
+    decoded(cost, g, 2, 62, 33.0); // over budget
+    EXPECT_DOUBLE_EQ(cost.coefficients().decode_ms, 1.0);
+    EXPECT_DOUBLE_EQ(cost.coefficients().prefill_ms, 0.5);
+    EXPECT_EQ(g.ticks_over_budget(), 1u);
+    EXPECT_TRUE(g.active());
+
+    // held: decode only, for hold_ticks ticks
+    for (int i = 0; i < 2; ++i) {
+        Plan p = plan(g, sessions);
+        EXPECT_EQ(p.prefill_tok_count, 0);
+        EXPECT_EQ(p.decode_tok_count, 2);
+        ASSERT_EQ(p.items.size(), 2u);
+        EXPECT_EQ(g.last_trimmed(), 62);
+        decoded(cost, g, p.decode_tok_count, p.prefill_tok_count, 2.0);
+    }
+
+    // ramp: half of the 16 tokens that fit in (10 - 2) ms, then all of them
+    Plan p = plan(g, sessions);
+    EXPECT_EQ(p.prefill_tok_count, 8);
+    EXPECT_EQ(p.items.back().phase, Phase::PREFILL);
+    EXPECT_EQ(p.items.back().n_tokens, 8);
+    decoded(cost, g, p.decode_tok_count, p.prefill_tok_count, 6.0);
+    EXPECT_FALSE(g.active());
+    p = plan(g, sessions);
+    EXPECT_EQ(p.prefill_tok_count, 16);
+    EXPECT_NEAR(cost.predict_ms(p.decode_tok_count, p.prefill_tok_count, 0), 10.0, 1e-9);
+}
+
+TEST(LatencyGuardTest, DecodeOnlyOvershootDoesNotStarvePrefill) {
+    uma::ipc::SessionPool sessions;
+    fill_pool(sessions);
+    BaselinePolicy base;
+    StepCost cost = device(15.0, 0.5);
+    LatencyGuard g(base, cost, params());
+    decoded(cost, g, 2, 0, 30.0); // decode alone is over budget
+    decoded(cost, g, 2, 4, 32.0);
+    EXPECT_EQ(g.ticks_over_budget(), 2u);
+    // held after the mixed tick, but slow decode-only ticks still count down the hold
+    decoded(cost, g, 2, 0, 30.0);
+    decoded(cost, g, 2, 0, 30.0);
+    Plan p = plan(g, sessions);
+    EXPECT_EQ(p.prefill_tok_count, 4); // nothing fits; the floor keeps prompts moving
+}
+
+TEST(LatencyGuardTest, PlansWithoutDecodeAreNotTrimmed) {
+    uma::ipc::SessionPool sessions;
+    fill_pool(sessions, /*with_decode*/false);
+    BaselinePolicy base;
+    StepCost cost = device(1.0, 0.5);
+    LatencyGuard g(base, cost, params());
+    decoded(cost, g, 2, 0, 2.0);
+    decoded(cost, g, 2, 62, 33.0);
+    Plan p = plan(g, sessions);
+    EXPECT_EQ(p.prefill_tok_count, 64);
+    EXPECT_EQ(g.last_trimmed(), 0);
+}
+
+TEST(LatencyGuardTest, HoldThrottlesBackgroundDecodersFirst) {
+    uma::ipc::SessionPool sessions;
+    for (int i = 0; i < 6; ++i) {
+        auto& s = sessions.create();
+        sessions.set_state(s, uma::ipc::SessionState::DECODE);
+        s.hot->has_pending_tok = true;
+        s.hot->cls = i < 2 ? uma::ipc::RequestClass::Interactive
+                           : uma::ipc::RequestClass::Background;
+    }
+    BaselinePolicy base;
+    StepCost cost = device(2.0, 0.5);
+    LatencyGuard g(base, cost, params());
+    Plan p = plan(g, sessions);
+    EXPECT_EQ(p.background_decode_count, 4);
+    decoded(cost, g, p.decode_tok_count, 0, 12.0, p.background_decode_count);
+    EXPECT_TRUE(g.active());
+
+    // 5 tokens fit in 10 ms: one background decoder waits, interactive ones never do
+    p = plan(g, sessions);
+    EXPECT_EQ(p.decode_tok_count, 5);
+    EXPECT_EQ(p.background_decode_count, 3);
+    EXPECT_EQ(g.last_trimmed_decode(), 1);
+    EXPECT_EQ(p.items.size(), 5u);
+    EXPECT_EQ(p.items[0].cls, uma::ipc::RequestClass::Interactive);
+    EXPECT_EQ(p.items[1].cls, uma::ipc::RequestClass::Interactive);
+
+    // the hold ends: everyone decodes again
+    decoded(cost, g, 5, 0, 10.0, 3);
+    decoded(cost, g, 5, 0, 10.0, 3);
+    p = plan(g, sessions);
+    EXPECT_EQ(p.background_decode_count, 4);
+}
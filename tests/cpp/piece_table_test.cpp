@@ -0,0 +1,88 @@
+#include "gtest/gtest.h"
+#include "ipc/piece_table.h"
+#include "ipc/protocol.h"
+#include "ipc/tx_queue.h"
+
+#include <cstring>
+#include <string>
+#include <sys/uio.h>
+#include <vector>
+
+using uma::ipc::PieceTable;
+using uma::ipc::TxQueue;
+
+namespace {
+
+// Fake vocab following the llama_token_to_piece contract (negative = needed size).
+PieceTable::PieceFn vocab_fn(const std::vector<std::string>& vocab) {
+    return [&vocab](int32_t id, char* buf, size_t cap) -> int {
+        const std::string& p = vocab[(size_t)id];
+        if (p.size() > cap)
+            return -(int)p.size();
+        std::memcpy(buf, p.data(), p.size());
+        return (int)p.size();
+    };
+}
+
+std::string flatten(const TxQueue& q) {
+    iovec iov[TxQueue::kMaxIov];
+    int n = q.fill_iov(iov, TxQueue::kMaxIov);
+    std::string out;
+    for (int i = 0; i < n; ++i)
+        out.append(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
+    return out;
+}
+
+} // namespace
+
+TEST(PieceTable, RawAndEscapedForms) {
+    const std::vector<std::string> vocab = {"", "Hello", " \"quoted\"", "a\nb\\c\x01",
+                                            "caf\xC3\xA9", std::string(300, 'x')};
+    PieceTable t;
+    t.build((int32_t)vocab.size(), vocab_fn(vocab));
+    ASSERT_EQ(t.size(), 6);
+    for (size_t i = 0; i < vocab.size(); ++i) {
+        EXPECT_EQ(t.piece((int32_t)i), vocab[i]) << i;
+        EXPECT_EQ(t.json((int32_t)i), uma::ipc::protocol::json_escape(vocab[i])) << i;
+    }
+    EXPECT_EQ(t.json(3), "a\\nb\\\\c\\u0001");
+    // long pieces take the retry path
+    EXPECT_EQ(t.piece(5).size(), 300u);
+
+    EXPECT_TRUE(t.piece(-1).empty());
+    EXPECT_TRUE(t.json(6).empty());
+
+    // one arena: views stay valid and adjacent
+    EXPECT_EQ(t.piece(1).data() + 5, t.json(1).data());
+}
+
+TEST(PieceTable, EscapedEventsMatchEscapingPath) {
+    const std::vector<std::string> vocab = {"he said ", "\"hi\"", "\n", "\xE2\x82", "\xAC"};
+    PieceTable t;
+    t.build((int32_t)vocab.size(), vocab_fn(vocab));
+    const std::string prefix = uma::ipc::protocol::render_token_prefix("r1");
+
+    TxQueue a, b;
+    for (int32_t id = 0; id < t.size(); ++id) {
+        uma::ipc::protocol::append_token_event(a, prefix, vocab[(size_t)id], id);
+        uma::ipc::protocol::append_token_event_escaped(b, prefix, t.json(id), id);
+    }
+    EXPECT_EQ(flatten(a), flatten(b));
+
+    // coalesced: escaped pieces concatenate to the escape of the whole text, even across
+    // the split euro sign (ids 3 + 4)
+    const int32_t ids[] = {1, 2, 3, 4};
+    uint32_t raw_lens[4], esc_lens[4];
+    std::string raw, esc;
+    for (int i = 0; i < 4; ++i) {
+        raw += t.piece(ids[i]);
+        esc += t.json(ids[i]);
+        raw_lens[i] = (uint32_t)t.piece(ids[i]).size();
+        esc_lens[i] = (uint32_t)t.json(ids[i]).size();
+    }
+    EXPECT_EQ(esc, uma::ipc::protocol::json_escape(raw));
+    TxQueue c, d;
+    uma::ipc::protocol::append_tokens_event(c, "r1", ids, raw_lens, 4, raw);
+    uma::ipc::protocol::append_tokens_event_escaped(d, "r1", ids, esc_lens, 4, esc);
+    EXPECT_EQ(flatten(c), flatten(d));
+}
@@ -2,10 +2,8 @@
 #include "sched/policy.h"
 #include "ipc/session.h"
 
-#include <memory>
-#include <unordered_map>
-
 using uma::sched::BaselinePolicy;
+using uma::sched::EdfPolicy;
 using uma::sched::IBatchPolicy;
 using uma::sched::Phase;
 using uma::sched::Plan;
@@ -18,14 +16,12 @@ TEST(PolicyTest, DecodeFirstOneEach) {
     auto sessions = make_pool();
     // Two decode-ready sessions
     {
-        auto s = std::make_unique<uma::ipc::ClientSession>();
-        s->fd = 3; s->state = uma::ipc::SessionState::DECODE; s->has_pending_tok = true; s->seq = 1; s->n_past = 10;
-        sessions.emplace(s->fd, std::move(s));
+        auto& s = sessions.create();
+        sessions.set_state(s, uma::ipc::SessionState::DECODE); s.hot->has_pending_tok = true; s.hot->seq = 1; s.hot->n_past = 10;
     }
     {
-        auto s = std::make_unique<uma::ipc::ClientSession>();
-        s->fd = 4; s->state = uma::ipc::SessionState::DECODE; s->has_pending_tok = true; s->seq = 2; s->n_past = 20;
-        sessions.emplace(s->fd, std::move(s));
+        auto& s = sessions.create();
+        sessions.set_state(s, uma::ipc::SessionState::DECODE); s.hot->has_pending_tok = true; s.hot->seq = 2; s.hot->n_past = 20;
     }
 
     BaselinePolicy pol;
@@ -40,25 +36,25 @@ TEST(PolicyTest, DecodeFirstOneEach) {
 TEST(PolicyTest, PrefillTtftFirstBurstLimited) {
     auto sessions = make_pool();
     // TTFT session (no first emit yet), long prompt
+    int ttft_sid = -1;
     {
-        auto s = std::make_unique<uma::ipc::ClientSession>();
-        s->fd = 5; s->state = uma::ipc::SessionState::PREFILL; s->first_emit_ns = 0; s->prefill_idx = 0; s->seq = 3;
-        s->prompt_tokens.resize(100, 1);
-        sessions.emplace(s->fd, std::move(s));
+        auto& s = sessions.create();
+        ttft_sid = s.sid;
+        sessions.set_state(s, uma::ipc::SessionState::PREFILL); s.first_emit_ns = 0; s.hot->prefill_idx = 0; s.hot->seq = 3;
+        s.prompt_tokens.resize(100, 1);
     }
     // Non-TTFT session (already emitted), short remaining prompt
     {
-        auto s = std::make_unique<uma::ipc::ClientSession>();
-        s->fd = 6; s->state = uma::ipc::SessionState::PREFILL; s->first_emit_ns = 42; s->prefill_idx = 0; s->seq = 4;
-        s->prompt_tokens.resize(8, 1);
-        sessions.emplace(s->fd, std::move(s));
+        auto& s = sessions.create();
+        sessions.set_state(s, uma::ipc::SessionState::PREFILL); s.first_emit_ns = 42; s.hot->prefill_idx = 0; s.hot->seq = 4;
+        s.prompt_tokens.resize(8, 1);
     }
 
     BaselinePolicy pol;
     Plan plan = pol.schedule_tick(sessions, /*batch_cap*/64, /*target*/64, /*rrd*/0, /*rrp*/0);
     ASSERT_GE(plan.items.size(), 1u);
-    // First prefill item should be TTFT session (fd=5) with burst limit 16
-    EXPECT_EQ(plan.items[0].fd, 5);
+    // First prefill item should be the TTFT session with burst limit 16
+    EXPECT_EQ(plan.items[0].sid, ttft_sid);
     EXPECT_EQ(plan.items[0].phase, Phase::PREFILL);
     EXPECT_EQ(plan.items[0].n_tokens, 16);
 }
@@ -67,15 +63,13 @@ TEST(PolicyTest, BudgetRespectedAcrossPhases) {
     auto sessions = make_pool();
     // One DECODE and one PREFILL; target budget 3 should allocate 1 + 2
     {
-        auto s = std::make_unique<uma::ipc::ClientSession>();
-        s->fd = 7; s->state = uma::ipc::SessionState::DECODE; s->has_pending_tok = true; s->seq = 5;
-        sessions.emplace(s->fd, std::move(s));
+        auto& s = sessions.create();
+        sessions.set_state(s, uma::ipc::SessionState::DECODE); s.hot->has_pending_tok = true; s.hot->seq = 5;
     }
     {
-        auto s = std::make_unique<uma::ipc::ClientSession>();
-        s->fd = 8; s->state = uma::ipc::SessionState::PREFILL; s->first_emit_ns = 42; s->prefill_idx = 0; s->seq = 6;
-        s->prompt_tokens.resize(10, 1);
-        sessions.emplace(s->fd, std::move(s));
+        auto& s = sessions.create();
+        sessions.set_state(s, uma::ipc::SessionState::PREFILL); s.first_emit_ns = 42; s.hot->prefill_idx = 0; s.hot->seq = 6;
+        s.prompt_tokens.resize(10, 1);
     }
 
     BaselinePolicy pol;
@@ -89,9 +83,8 @@ TEST(PolicyTest, RoundRobinCursorsAdvance) {
     auto sessions = make_pool();
     // Three DECODE sessions
     for (int i = 0; i < 3; ++i) {
-        auto s = std::make_unique<uma::ipc::ClientSession>();
-        s->fd = 10 + i; s->state = uma::ipc::SessionState::DECODE; s->has_pending_tok = true; s->seq = 100 + i;
-        sessions.emplace(s->fd, std::move(s));
+        auto& s = sessions.create();
+        sessions.set_state(s, uma::ipc::SessionState::DECODE); s.hot->has_pending_tok = true; s.hot->seq = 100 + i;
     }
     BaselinePolicy pol;
     Plan plan = pol.schedule_tick(sessions, /*batch_cap*/32, /*target*/32, /*rrd*/0, /*rrp*/0);
@@ -99,3 +92,217 @@ TEST(PolicyTest, RoundRobinCursorsAdvance) {
     EXPECT_EQ(plan.next_rr_decode_idx, 1u);
 }
 
+
+TEST(PolicyTest, ParkedConnectionsGetNoDecodeSlots) {
+    auto sessions = make_pool();
+    uma::ipc::Connection slow, fast;
+    slow.tx_parked = true;
+    {
+        auto& s = sessions.create(&slow);
+        sessions.set_state(s, uma::ipc::SessionState::DECODE); s.hot->has_pending_tok = true; s.hot->seq = 1;
+    }
+    int fast_sid = -1;
+    {
+        auto& s = sessions.create(&fast);
+        fast_sid = s.sid;
+        sessions.set_state(s, uma::ipc::SessionState::DECODE); s.hot->has_pending_tok = true; s.hot->seq = 2;
+    }
+
+    BaselinePolicy pol;
+    Plan plan = pol.schedule_tick(sessions, /*batch_cap*/32, /*target*/32, /*rrd*/0, /*rrp*/0);
+    ASSERT_EQ(plan.items.size(), 1u);
+    EXPECT_EQ(plan.items[0].sid, fast_sid);
+
+    // resumed at the low-water mark: both decode again
+    slow.tx_parked = false;
+    plan = pol.schedule_tick(sessions, 32, 32, 0, 0);
+    EXPECT_EQ(plan.items.size(), 2u);
+}
+
+TEST(PolicyTest, InteractiveShareIsReservedFromBackground) {
+    auto sessions = make_pool();
+    using uma::ipc::RequestClass;
+    auto decoder = [&](RequestClass cls) {
+        auto& s = sessions.create();
+        sessions.set_state(s, uma::ipc::SessionState::DECODE);
+        s.hot->has_pending_tok = true; s.hot->cls = cls;
+    };
+    for (int i = 0; i < 10; ++i)
+        decoder(RequestClass::Background);
+    for (int i = 0; i < 2; ++i)
+        decoder(RequestClass::Interactive);
+    int ttft_sid = -1;
+    {
+        auto& s = sessions.create();
+        ttft_sid = s.sid;
+        sessions.set_state(s, uma::ipc::SessionState::PREFILL);
+        s.prompt_tokens.resize(100, 1);
+    }
+
+    // budget 16, half reserved: background decode stops at 8, interactive prefill gets 6
+    BaselinePolicy pol(0.5);
+    Plan plan = pol.schedule_tick(sessions, /*batch_cap*/64, /*target*/16, 0, 0);
+    EXPECT_EQ(plan.decode_tok_count, 10);
+    EXPECT_EQ(plan.background_decode_count, 8);
+    EXPECT_EQ(plan.prefill_tok_count, 6);
+    ASSERT_EQ(plan.items.size(), 11u);
+    EXPECT_EQ(plan.items[0].cls, RequestClass::Interactive);
+    EXPECT_EQ(plan.items[1].cls, RequestClass::Interactive);
+    EXPECT_EQ(plan.items[2].cls, RequestClass::Background);
+    EXPECT_EQ(plan.items.back().sid, ttft_sid);
+
+    // without interactive prefill the reserve shrinks to the 2 interactive decoders
+    sessions.erase(*sessions.find(ttft_sid));
+    plan = pol.schedule_tick(sessions, 64, 16, 0, 0);
+    EXPECT_EQ(plan.background_decode_count, 10);
+
+    // with no reserve background competes as before
+    BaselinePolicy shared(0.0);
+    auto& p = sessions.create();
+    sessions.set_state(p, uma::ipc::SessionState::PREFILL);
+    p.prompt_tokens.resize(100, 1);
+    plan = shared.schedule_tick(sessions, 64, 16, 0, 0);
+    EXPECT_EQ(plan.background_decode_count, 10);
+    EXPECT_EQ(plan.prefill_tok_count, 4);
+}
+
+TEST(PolicyTest, BackgroundPrefillComesAfterInteractive) {
+    auto sessions = make_pool();
+    auto& bg = sessions.create();
+    sessions.set_state(bg, uma::ipc::SessionState::PREFILL);
+    bg.hot->cls = uma::ipc::RequestClass::Background;
+    bg.prompt_tokens.resize(100, 1);
+    auto& fg = sessions.create();
+    sessions.set_state(fg, uma::ipc::SessionState::PREFILL);
+    fg.first_emit_ns = 1;
+    fg.prompt_tokens.resize(10, 1);
+
+    BaselinePolicy pol;
+    Plan plan = pol.schedule_tick(sessions, /*batch_cap*/64, /*target*/32, 0, 0);
+    ASSERT_EQ(plan.items.size(), 2u);
+    EXPECT_EQ(plan.items[0].sid, fg.sid);
+    EXPECT_EQ(plan.items[0].n_tokens, 10);
+    EXPECT_EQ(plan.items[1].sid, bg.sid);
+    EXPECT_EQ(plan.items[1].n_tokens, 16); // still a first-token burst
+}
+
+namespace {
+constexpr uint64_t kMs = 1000000ull;
+
+// DECODE request whose last token left at last_ms (default TBT target 80 ms)
+int add_decoder(uma::ipc::SessionPool& sessions, uint64_t last_ms) {
+    auto& s = sessions.create();
+    sessions.set_state(s, uma::ipc::SessionState::DECODE);
+    s.hot->has_pending_tok = true;
+    s.first_emit_ns = s.last_emit_ns = last_ms * kMs;
+    return s.sid;
+}
+
+// PREFILL request waiting for its first token since start_ms (default TTFT target 150 ms)
+int add_prompt(uma::ipc::SessionPool& sessions, uint64_t start_ms, size_t n) {
+    auto& s = sessions.create();
+    sessions.set_state(s, uma::ipc::SessionState::PREFILL);
+    s.req_start_ns = start_ms * kMs;
+    s.prompt_tokens.resize(n, 1);
+    return s.sid;
+}
+} // namespace
+
+TEST(EdfPolicyTest, OrdersWorkByDeadline) {
+    auto sessions = make_pool();
+    const int late = add_decoder(sessions, 1000);  // due at 1080 ms
+    const int early = add_decoder(sessions, 990);  // due at 1070 ms
+    const int prompt = add_prompt(sessions, 900, 8); // due at 1050 ms
+    uma::sched::StepCost cost; // nothing learned: sized by tokens only
+    EdfPolicy pol(cost);
+    pol.set_now(1000 * kMs);
+    Plan plan = pol.schedule_tick(sessions, /*batch_cap*/64, /*target*/64, 0, 0);
+    ASSERT_EQ(plan.items.size(), 3u);
+    EXPECT_EQ(plan.items[0].sid, prompt);
+    EXPECT_EQ(plan.items[0].n_tokens, 8);
+    EXPECT_EQ(plan.items[1].sid, early);
+    EXPECT_EQ(plan.items[2].sid, late);
+
+    // a per-request target moves the request in the order
+    sessions.find(early)->slo.target_tbt_ms = 200;
+    plan = pol.schedule_tick(sessions, 64, 64, 0, 0);
+    EXPECT_EQ(plan.items[1].sid, late);
+    EXPECT_EQ(plan.items[2].sid, early);
+
+    // decoders keep their tokens when the batch budget is short
+    plan = pol.schedule_tick(sessions, 64, /*target*/2, 0, 0);
+    EXPECT_EQ(plan.decode_tok_count, 2);
+    EXPECT_EQ(plan.prefill_tok_count, 0);
+}
+
+TEST(EdfPolicyTest, SizesPrefillToTheTimeLeft) {
+    auto sessions = make_pool();
+    add_decoder(sessions, 1000); // due at 1080 ms
+    add_decoder(sessions, 1000);
+    const int relaxed = add_prompt(sessions, 1000, 100); // due at 1150 ms
+    uma::sched::StepCost::Coefficients c;
+    c.decode_ms = 1.0;
+    c.prefill_ms = 0.5;
+    const uma::sched::StepCost cost(c);
+    EdfPolicy pol(cost, /*min_chunk*/16);
+
+    // 20 ms to the first decoder deadline, 2 ms of decode: 36 prefill tokens fit
+    pol.set_now(1060 * kMs);
+    Plan plan = pol.schedule_tick(sessions, /*batch_cap*/64, /*target*/64, 0, 0);
+    EXPECT_EQ(plan.decode_tok_count, 2);
+    EXPECT_EQ(plan.prefill_tok_count, 36);
+
+    // streams already overdue: a prompt due later waits...
+    pol.set_now(1100 * kMs);
+    plan = pol.schedule_tick(sessions, 64, 64, 0, 0);
+    EXPECT_EQ(plan.prefill_tok_count, 0);
+
+    // ...but one due before them still gets a minimum chunk
+    const int urgent = add_prompt(sessions, 900, 100); // due at 1050 ms
+    plan = pol.schedule_tick(sessions, 64, 64, 0, 0);
+    ASSERT_EQ(plan.prefill_tok_count, 16);
+    EXPECT_EQ(plan.items[0].sid, urgent);
+    for (const auto& item : plan.items)
+        EXPECT_NE(item.sid, relaxed);
+}
+
+TEST(SrptPolicyTest, ShortPromptsGoFirstWithAnAdaptiveBurst) {
+    auto sessions = make_pool();
+    const int long_sid = add_prompt(sessions, 1000, 6000);
+    const int short_sid = add_prompt(sessions, 1000, 40);
+
+    BaselinePolicy rr;
+    Plan plan = rr.schedule_tick(sessions, /*batch_cap*/256, /*target*/256, 0, 0);
+    EXPECT_EQ(plan.prefill_tok_count, 32); // two 16-token bursts
+
+    BaselinePolicy srpt(0.5, uma::sched::PrefillOrder::ShortestFirst);
+    srpt.set_now(1000 * kMs);
+    plan = srpt.schedule_tick(sessions, 256, 256, 0, 0);
+    ASSERT_EQ(plan.items.size(), 2u);
+    // the short prompt fits in its half of the budget; the long one gets the rest
+    EXPECT_EQ(plan.items[0].sid, short_sid);
+    EXPECT_EQ(plan.items[0].n_tokens, 40);
+    EXPECT_EQ(plan.items[1].sid, long_sid);
+    EXPECT_EQ(plan.items[1].n_tokens, 216);
+}
+
+TEST(SrptPolicyTest, WaitingAgesALongPromptAhead) {
+    auto sessions = make_pool();
+    const int long_sid = add_prompt(sessions, 0, 600);
+    const int short_sid = add_prompt(sessions, 1000, 100);
+
+    BaselinePolicy pure(0.5, uma::sched::PrefillOrder::ShortestFirst, /*aging*/0.0);
+    pure.set_now(1000 * kMs);
+    Plan plan = pure.schedule_tick(sessions, /*batch_cap*/64, /*target*/64, 0, 0);
+    EXPECT_EQ(plan.items[0].sid, short_sid);
+
+    // one second of waiting is worth 1000 tokens: 600 - 1000 ranks before 100
+    BaselinePolicy aged(0.5, uma::sched::PrefillOrder::ShortestFirst, /*aging*/1000.0);
+    aged.set_now(1000 * kMs);
+    plan = aged.schedule_tick(sessions, 64, 64, 0, 0);
+    ASSERT_EQ(plan.items.size(), 2u);
+    EXPECT_EQ(plan.items[0].sid, long_sid);
+    EXPECT_EQ(plan.items[0].n_tokens, 32);
+    EXPECT_EQ(plan.items[1].sid, short_sid);
+    EXPECT_EQ(plan.items[1].n_tokens, 32);
+}
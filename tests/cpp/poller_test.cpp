@@ -0,0 +1,189 @@
+#include "gtest/gtest.h"
+#include "ipc/poller.h"
+#include "ipc/uds_server.h"
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+using uma::ipc::PollEvent;
+using uma::ipc::PollFlags;
+using uma::ipc::Poller;
+
+namespace {
+
+struct SockPair {
+    int a = -1;
+    int b = -1;
+    SockPair() {
+        int sv[2];
+        if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0) {
+            a = sv[0];
+            b = sv[1];
+        }
+    }
+    ~SockPair() {
+        if (a >= 0) ::close(a);
+        if (b >= 0) ::close(b);
+    }
+};
+
+const PollEvent* find_fd(const std::vector<PollEvent>& evs, int fd) {
+    for (const auto& e : evs)
+        if (e.fd == fd) return &e;
+    return nullptr;
+}
+
+} // namespace
+
+TEST(PollerTest, ReadableAfterPeerWrite) {
+    SockPair sp;
+    ASSERT_GE(sp.a, 0);
+    Poller p;
+    ASSERT_TRUE(p.add(sp.a, PollFlags::Read));
+
+    std::vector<PollEvent> evs;
+    EXPECT_EQ(p.wait(0, evs), 0);
+
+    ASSERT_EQ(::write(sp.b, "x", 1), 1);
+    ASSERT_EQ(p.wait(100, evs), 1);
+    const PollEvent* e = find_fd(evs, sp.a);
+    ASSERT_NE(e, nullptr);
+    EXPECT_TRUE(e->readable());
+    EXPECT_FALSE(e->writable());
+}
+
+TEST(PollerTest, ReadAndWriteCoalescedPerFd) {
+    SockPair sp;
+    ASSERT_GE(sp.a, 0);
+    Poller p;
+    ASSERT_TRUE(p.add(sp.a, PollFlags::Read));
+    ASSERT_TRUE(p.add(sp.a, PollFlags::Write));
+    ASSERT_EQ(::write(sp.b, "x", 1), 1);
+
+    std::vector<PollEvent> evs;
+    ASSERT_EQ(p.wait(100, evs), 1);
+    EXPECT_TRUE(evs[0].readable());
+    EXPECT_TRUE(evs[0].writable());
+
+    // dropping write interest keeps read registered
+    ASSERT_TRUE(p.remove(sp.a, PollFlags::Write));
+    ASSERT_EQ(p.wait(100, evs), 1);
+    EXPECT_TRUE(evs[0].readable());
+    EXPECT_FALSE(evs[0].writable());
+
+    ASSERT_TRUE(p.remove(sp.a, PollFlags::Read));
+    EXPECT_EQ(p.wait(0, evs), 0);
+}
+
+TEST(PollerTest, EdgeTriggeredReportsOncePerArrival) {
+    SockPair sp;
+    ASSERT_GE(sp.a, 0);
+    Poller p;
+    ASSERT_TRUE(p.add(sp.a, PollFlags::Read | PollFlags::Edge));
+    ASSERT_EQ(::write(sp.b, "x", 1), 1);
+
+    std::vector<PollEvent> evs;
+    ASSERT_EQ(p.wait(100, evs), 1);
+    // not drained, but no new data: an edge-triggered registration stays quiet
+    EXPECT_EQ(p.wait(0, evs), 0);
+
+    ASSERT_EQ(::write(sp.b, "y", 1), 1);
+    ASSERT_EQ(p.wait(100, evs), 1);
+    EXPECT_TRUE(evs[0].readable());
+}
+
+TEST(PollerTest, WriteAddedToEdgeReadFdStaysLevelTriggered) {
+    SockPair sp;
+    ASSERT_GE(sp.a, 0);
+    Poller p;
+    // how umad registers clients: edge-triggered reads, write interest added on backlog
+    ASSERT_TRUE(p.add(sp.a, PollFlags::Read | PollFlags::Edge));
+    ASSERT_EQ(::write(sp.b, "x", 1), 1);
+    ASSERT_TRUE(p.add(sp.a, PollFlags::Write));
+
+    // one event carries both directions; the loop has to serve both from it
+    std::vector<PollEvent> evs;
+    ASSERT_EQ(p.wait(100, evs), 1);
+    EXPECT_TRUE(evs[0].readable());
+    EXPECT_TRUE(evs[0].writable());
+
+    // nothing was written: the write interest is still reported on the next wait
+    ASSERT_EQ(p.wait(0, evs), 1);
+    EXPECT_TRUE(evs[0].writable());
+}
+
+TEST(PollerTest, AddRearmsAnUnchangedEdgeRegistration) {
+    SockPair sp;
+    ASSERT_GE(sp.a, 0);
+    Poller p;
+    ASSERT_TRUE(p.add(sp.a, PollFlags::Read | PollFlags::Write | PollFlags::Edge));
+
+    std::vector<PollEvent> evs;
+    ASSERT_EQ(p.wait(100, evs), 1);
+    EXPECT_TRUE(evs[0].writable());
+    EXPECT_EQ(p.wait(0, evs), 0); // edge consumed
+
+    // the caller still has output queued: adding the same interest again re-arms it
+    ASSERT_TRUE(p.add(sp.a, PollFlags::Write | PollFlags::Edge));
+    ASSERT_EQ(p.wait(100, evs), 1);
+    EXPECT_TRUE(evs[0].writable());
+}
+
+TEST(PollerTest, PeerCloseReportsHup) {
+    SockPair sp;
+    ASSERT_GE(sp.a, 0);
+    Poller p;
+    ASSERT_TRUE(p.add(sp.a, PollFlags::Read));
+    ::close(sp.b);
+    sp.b = -1;
+
+    std::vector<PollEvent> evs;
+    ASSERT_EQ(p.wait(100, evs), 1);
+    EXPECT_TRUE(evs[0].hup());
+}
+
+TEST(PollerTest, WriteOnlyFdIgnoresPeerHalfClose) {
+    SockPair sp;
+    ASSERT_GE(sp.a, 0);
+    // a client that sent EOF and stopped reading while output is still queued
+    ASSERT_EQ(::fcntl(sp.a, F_SETFL, ::fcntl(sp.a, F_GETFL, 0) | O_NONBLOCK), 0);
+    char buf[4096] = {};
+    while (::write(sp.a, buf, sizeof(buf)) > 0) {
+    }
+    ASSERT_EQ(::shutdown(sp.b, SHUT_WR), 0);
+    Poller p;
+    ASSERT_TRUE(p.add(sp.a, PollFlags::Write));
+
+    // nothing to report until the peer drains its buffer
+    std::vector<PollEvent> evs;
+    EXPECT_EQ(p.wait(0, evs), 0);
+    EXPECT_EQ(p.wait(20, evs), 0);
+    ASSERT_EQ(::fcntl(sp.b, F_SETFL, ::fcntl(sp.b, F_GETFL, 0) | O_NONBLOCK), 0);
+    while (::read(sp.b, buf, sizeof(buf)) > 0) {
+    }
+    ASSERT_EQ(p.wait(100, evs), 1);
+    EXPECT_TRUE(evs[0].writable());
+}
+
+TEST(PollerTest, PeerClosedTellsHalfCloseFromHangup) {
+    SockPair sp;
+    ASSERT_GE(sp.a, 0);
+    EXPECT_FALSE(uma::ipc::UDSServer::peer_closed(sp.a));
+    // the client sent its requests and is still reading the stream
+    ASSERT_EQ(::shutdown(sp.b, SHUT_WR), 0);
+    EXPECT_FALSE(uma::ipc::UDSServer::peer_closed(sp.a));
+    ::close(sp.b);
+    sp.b = -1;
+    EXPECT_TRUE(uma::ipc::UDSServer::peer_closed(sp.a));
+}
+
+TEST(PollerTest, WakeInterruptsWaitWithoutEvents) {
+    Poller p;
+    ASSERT_TRUE(p.wake());
+    std::vector<PollEvent> evs;
+    // returns promptly (well before the timeout) and reports no fd events
+    EXPECT_EQ(p.wait(5000, evs), 0);
+    EXPECT_TRUE(evs.empty());
+}
@@ -0,0 +1,131 @@
+#include "gtest/gtest.h"
+#include "ipc/session.h"
+
+#include <vector>
+
+using uma::ipc::ClientSession;
+using uma::ipc::SessionList;
+using uma::ipc::SessionPool;
+using uma::ipc::SessionState;
+
+namespace {
+
+ClientSession& add(SessionPool& pool, SessionState st) {
+    auto& s = pool.create();
+    pool.set_state(s, st);
+    return s;
+}
+
+std::vector<int> sids(const SessionList& l) {
+    std::vector<int> out;
+    for (const auto* h = l.front(); h; h = h->list_next)
+        out.push_back(h->sid);
+    return out;
+}
+
+} // namespace
+
+TEST(SessionPoolTest, ListsFollowStateTransitions) {
+    SessionPool pool;
+    auto& a = add(pool, SessionState::PREFILL);
+    auto& b = add(pool, SessionState::TOKENIZING);
+    auto& c = add(pool, SessionState::PREFILL);
+    add(pool, SessionState::QUEUED);
+    const int sa = a.sid, sb = b.sid, sc = c.sid;
+    EXPECT_EQ(sids(pool.prefill_ready()), (std::vector<int>{sa, sc}));
+    EXPECT_TRUE(pool.decode_ready().empty());
+
+    pool.set_state(a, SessionState::DECODE);
+    pool.set_state(b, SessionState::PREFILL);
+    EXPECT_EQ(sids(pool.prefill_ready()), (std::vector<int>{sc, sb}));
+    EXPECT_EQ(sids(pool.decode_ready()), (std::vector<int>{sa}));
+
+    // staying in DECODE keeps the list order
+    pool.set_state(c, SessionState::DECODE);
+    pool.set_state(a, SessionState::DECODE);
+    EXPECT_EQ(sids(pool.decode_ready()), (std::vector<int>{sa, sc}));
+
+    pool.set_state(a, SessionState::STREAM);
+    pool.set_state(c, SessionState::DONE);
+    EXPECT_TRUE(pool.decode_ready().empty());
+    EXPECT_EQ(sids(pool.finished()), (std::vector<int>{sa, sc}));
+
+    // erasing unlinks
+    pool.erase(a);
+    pool.erase(b);
+    EXPECT_EQ(sids(pool.finished()), (std::vector<int>{sc}));
+    EXPECT_TRUE(pool.prefill_ready().empty());
+    EXPECT_EQ(pool.size(), 2u);
+}
+
+TEST(SessionPoolTest, ReadyWorkSkipsDrainedPrefillAndParkedDecode) {
+    SessionPool pool;
+    uma::ipc::Connection conn;
+    auto& p = add(pool, SessionState::PREFILL);
+    p.prompt_tokens = {1, 2};
+    p.hot->prefill_idx = 2; // whole prompt in the batch in flight
+    auto& d = pool.create(&conn);
+    pool.set_state(d, SessionState::DECODE);
+    d.hot->has_pending_tok = true;
+    conn.tx_parked = true;
+    EXPECT_FALSE(pool.has_ready_work());
+
+    conn.tx_parked = false;
+    EXPECT_TRUE(pool.has_ready_work());
+    conn.tx_parked = true;
+    p.hot->prefill_idx = 1;
+    EXPECT_TRUE(pool.has_ready_work());
+}
+
+TEST(SessionPoolTest, SlotsAreReusedUnderANewSid) {
+    SessionPool pool;
+    auto& a = add(pool, SessionState::DECODE);
+    const int old_sid = a.sid;
+    a.request_id = "r1";
+    a.hot->n_past = 7;
+    EXPECT_EQ(pool.find(old_sid), &a);
+    pool.erase(a);
+    EXPECT_EQ(pool.find(old_sid), nullptr);
+    EXPECT_TRUE(pool.empty());
+
+    // same slot, fresh request: a stale sid (e.g. a late tokenizer result) finds nothing
+    auto& b = pool.create();
+    EXPECT_EQ(&b, &a);
+    EXPECT_NE(b.sid, old_sid);
+    EXPECT_EQ(pool.find(old_sid), nullptr);
+    EXPECT_EQ(pool.find(b.sid), &b);
+    EXPECT_TRUE(b.request_id.empty());
+    EXPECT_EQ(b.hot->n_past, 0);
+    EXPECT_EQ(b.hot->state, SessionState::RECV_REQ);
+    EXPECT_EQ(pool.find(-1), nullptr);
+    EXPECT_EQ(pool.find(12345), nullptr);
+}
+
+TEST(SessionPoolTest, RequestsKeepTheirAddressAsThePoolGrows) {
+    SessionPool pool;
+    std::vector<ClientSession*> ptrs;
+    for (int i = 0; i < 300; ++i) {
+        auto& s = add(pool, SessionState::DECODE);
+        s.hot->n_past = i;
+        ptrs.push_back(&s);
+    }
+    EXPECT_EQ(pool.size(), 300u);
+    EXPECT_EQ(pool.decode_ready().size(), 300u);
+    for (int i = 0; i < 300; ++i) {
+        EXPECT_EQ(pool.find(ptrs[i]->sid), ptrs[i]);
+        EXPECT_EQ(ptrs[i]->hot->n_past, i);
+        EXPECT_EQ(ptrs[i]->hot->cold, ptrs[i]);
+    }
+}
+
+TEST(SessionPoolTest, MovedPoolKeepsItsLists) {
+    SessionPool pool;
+    auto& a = add(pool, SessionState::DECODE);
+    auto& b = add(pool, SessionState::DECODE);
+    const int sa = a.sid, sb = b.sid;
+    SessionPool moved = std::move(pool);
+    EXPECT_EQ(sids(moved.decode_ready()), (std::vector<int>{sa, sb}));
+    moved.set_state(*moved.find(sa), SessionState::ERRORED);
+    EXPECT_EQ(sids(moved.decode_ready()), (std::vector<int>{sb}));
+    EXPECT_EQ(sids(moved.finished()), (std::vector<int>{sa}));
+}
@@ -0,0 +1,206 @@
+#include "gtest/gtest.h"
+#include "ipc/protocol.h"
+#include "ipc/shm_ring.h"
+#include "ipc/tx_queue.h"
+#include "ipc/uds_server.h"
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using uma::ipc::ShmRingReader;
+using uma::ipc::ShmRingWriter;
+using uma::ipc::TxQueue;
+
+namespace {
+
+// Map the writer's ring a second time, as a client would after receiving the fds.
+bool attach_dup(ShmRingReader& r, const ShmRingWriter& w) {
+    return r.attach(::dup(w.mem_fd()), ::dup(w.doorbell_fd()));
+}
+
+std::string read_all(ShmRingReader& r) {
+    std::string out(r.available(), '\0');
+    out.resize(r.read(&out[0], out.size()));
+    return out;
+}
+
+} // namespace
+
+TEST(ShmRing, RoundsCapacityAndWrapsAround) {
+    auto w = ShmRingWriter::create(5000);
+    ASSERT_NE(w, nullptr);
+    EXPECT_EQ(w->capacity(), 8192u);
+    ShmRingReader r;
+    ASSERT_TRUE(attach_dup(r, *w));
+
+    // push the positions past the end several times with odd-sized chunks
+    std::string expect, got;
+    for (int i = 0; i < 50; ++i) {
+        std::string chunk(1000 + i * 7, static_cast<char>('a' + i % 26));
+        ASSERT_EQ(w->write(chunk.data(), chunk.size()), chunk.size());
+        expect += chunk;
+        got += read_all(r);
+    }
+    EXPECT_EQ(got, expect);
+    EXPECT_EQ(r.available(), 0u);
+}
+
+TEST(ShmRing, FullRingTakesPartialWrites) {
+    auto w = ShmRingWriter::create(4096);
+    ASSERT_NE(w, nullptr);
+    ShmRingReader r;
+    ASSERT_TRUE(attach_dup(r, *w));
+
+    std::string big(6000, 'x');
+    EXPECT_EQ(w->write(big.data(), big.size()), 4096u);
+    EXPECT_EQ(w->free_space(), 0u);
+    EXPECT_EQ(w->write(big.data(), 1), 0u);
+
+    char buf[1000];
+    EXPECT_EQ(r.read(buf, sizeof(buf)), sizeof(buf));
+    EXPECT_EQ(w->free_space(), sizeof(buf));
+    EXPECT_EQ(w->write(big.data(), big.size()), sizeof(buf));
+}
+
+TEST(ShmRing, ForgedTailIsRejected) {
+    auto w = ShmRingWriter::create(4096);
+    ASSERT_NE(w, nullptr);
+    // the client maps the header read-write and can store any tail
+    void* p = ::mmap(nullptr, uma::ipc::kShmDataOffset, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     w->mem_fd(), 0);
+    ASSERT_NE(p, MAP_FAILED);
+    auto* hdr = static_cast<uma::ipc::ShmRingHeader*>(p);
+
+    std::string big(1 << 20, 'x');
+    ASSERT_EQ(w->write(big.data(), 4096), 4096u);
+    hdr->tail.store(4096);
+    ASSERT_EQ(w->write(big.data(), 4096), 4096u);
+    EXPECT_FALSE(w->corrupt());
+
+    // a tail from before the last lap would make head - tail exceed the capacity
+    hdr->tail.store(0);
+    EXPECT_EQ(w->free_space(), 0u);
+    EXPECT_EQ(w->write(big.data(), big.size()), 0u);
+    EXPECT_TRUE(w->corrupt());
+    // and stays rejected even once the tail looks sane again
+    hdr->tail.store(8192);
+    EXPECT_EQ(w->write(big.data(), 1), 0u);
+    EXPECT_EQ(w->free_space(), 0u);
+
+    // a tail ahead of head is just as invalid, and a forged head is never read back
+    auto w2 = ShmRingWriter::create(4096);
+    ASSERT_NE(w2, nullptr);
+    void* p2 = ::mmap(nullptr, uma::ipc::kShmDataOffset, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      w2->mem_fd(), 0);
+    ASSERT_NE(p2, MAP_FAILED);
+    auto* hdr2 = static_cast<uma::ipc::ShmRingHeader*>(p2);
+    hdr2->head.store(1u << 30);
+    hdr2->tail.store(1u << 30);
+    EXPECT_EQ(w2->write(big.data(), big.size()), 0u);
+    EXPECT_TRUE(w2->corrupt());
+    ::munmap(p, uma::ipc::kShmDataOffset);
+    ::munmap(p2, uma::ipc::kShmDataOffset);
+}
+
+TEST(ShmRing, DoorbellOnlyWhenReaderWaits) {
+    auto w = ShmRingWriter::create(4096);
+    ASSERT_NE(w, nullptr);
+    ShmRingReader r;
+    ASSERT_TRUE(attach_dup(r, *w));
+
+    // a reader that is not blocked costs the writer no syscall
+    ASSERT_EQ(w->write("a", 1), 1u);
+    EXPECT_FALSE(w->notify());
+    EXPECT_TRUE(r.wait(0)); // data already there: returns without blocking
+    char c;
+    ASSERT_EQ(r.read(&c, 1), 1u);
+    EXPECT_FALSE(r.wait(10)); // empty: times out
+
+    // a blocked reader is woken by the doorbell (or sees the data on its re-check if it
+    // had not blocked yet)
+    std::thread reader([&] { EXPECT_TRUE(r.wait(5000)); });
+    ::usleep(50 * 1000);
+    ASSERT_EQ(w->write("b", 1), 1u);
+    w->notify();
+    reader.join();
+    EXPECT_EQ(read_all(r), "b");
+}
+
+TEST(ShmRing, CloseWakesReader) {
+    auto w = ShmRingWriter::create(4096);
+    ASSERT_NE(w, nullptr);
+    ShmRingReader r;
+    ASSERT_TRUE(attach_dup(r, *w));
+    ASSERT_EQ(w->write("tail", 4), 4u);
+    w.reset(); // destroying the writer closes the stream; mapped bytes stay readable
+    EXPECT_TRUE(r.writer_closed());
+    EXPECT_TRUE(r.wait(1000));
+    EXPECT_EQ(read_all(r), "tail");
+}
+
+TEST(ShmRing, DrainsTxQueueFrames) {
+    auto w = ShmRingWriter::create(4096);
+    ASSERT_NE(w, nullptr);
+    ShmRingReader r;
+    ASSERT_TRUE(attach_dup(r, *w));
+
+    TxQueue q;
+    const std::string prefix = uma::ipc::protocol::render_token_prefix("r1");
+    for (int i = 0; i < 200; ++i)
+        uma::ipc::protocol::append_token_event(q, prefix, "tok" + std::to_string(i), i);
+    size_t total = q.size();
+    ASSERT_GT(total, 4096u);
+
+    // the ring takes a prefix; the rest stays queued until the reader catches up
+    std::string got;
+    size_t moved = w->drain(q);
+    EXPECT_EQ(moved, 4096u);
+    EXPECT_EQ(q.size(), total - moved);
+    while (!q.empty()) {
+        got += read_all(r);
+        ASSERT_GT(w->drain(q), 0u);
+    }
+    got += read_all(r);
+    ASSERT_EQ(got.size(), total);
+
+    // the bytes are the same length-prefixed frames a socket reader would parse
+    uma::ipc::ByteBuffer rx;
+    std::memcpy(rx.prepare(got.size()), got.data(), got.size());
+    rx.commit(got.size());
+    for (int i = 0; i < 200; ++i) {
+        std::string js, err;
+        ASSERT_TRUE(uma::ipc::protocol::try_read_frame(rx, js, uma::ipc::protocol::kDefaultMaxFrameBytes, &err));
+        EXPECT_NE(js.find("\"tok" + std::to_string(i) + "\""), std::string::npos);
+    }
+    EXPECT_EQ(rx.size(), 0u);
+}
+
+TEST(ShmRing, PassesDescriptorsOverUnixSocket) {
+    int sv[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+    auto w = ShmRingWriter::create(4096);
+    ASSERT_NE(w, nullptr);
+
+    const int fds[2] = {w->mem_fd(), w->doorbell_fd()};
+    ASSERT_EQ(uma::ipc::UDSServer::send_with_fds(sv[0], "hi", 2, fds, 2), 2);
+    char buf[8];
+    int got[uma::ipc::UDSServer::kMaxPassFds];
+    int nfds = 0;
+    ASSERT_EQ(uma::ipc::UDSServer::recv_with_fds(sv[1], buf, sizeof(buf), got,
+                                                 uma::ipc::UDSServer::kMaxPassFds, &nfds),
+              2);
+    ASSERT_EQ(nfds, 2);
+
+    ShmRingReader r;
+    ASSERT_TRUE(r.attach(got[0], got[1]));
+    ASSERT_EQ(w->write("via-fd", 6), 6u);
+    EXPECT_EQ(read_all(r), "via-fd");
+    ::close(sv[0]);
+    ::close(sv[1]);
+}
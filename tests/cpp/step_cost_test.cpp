@@ -0,0 +1,107 @@
+#include "gtest/gtest.h"
+#include "sched/step_cost.h"
+
+#include <random>
+
+using uma::sched::StepCost;
+using uma::sched::kv_units;
+
+namespace {
+
+struct Tick {
+    int32_t decode;
+    int32_t prefill;
+    uint64_t kv;
+};
+
+// Decoders at random context depths, sometimes with a prefill chunk deep into a prompt.
+Tick random_tick(std::mt19937& rng) {
+    std::uniform_int_distribution<int32_t> dec(1, 32), ctx(0, 4000), chunk(1, 512);
+    Tick t{dec(rng), 0, 0};
+    for (int32_t i = 0; i < t.decode; ++i)
+        t.kv += kv_units(ctx(rng), 1);
+    if (rng() % 2) {
+        t.prefill = chunk(rng);
+        t.kv += kv_units(ctx(rng), t.prefill);
+    }
+    return t;
+}
+
+double law(const StepCost::Coefficients& c, const Tick& t) {
+    return c.fixed_ms + c.decode_ms * t.decode + c.prefill_ms * t.prefill +
+           c.kv_ms_per_k * (double)t.kv / 1000.0;
+}
+
+} // namespace
+
+TEST(StepCostTest, KvUnitsCountAttendedPositions) {
+    EXPECT_EQ(kv_units(10, 1), 11u);        // one decode token at n_past 10
+    EXPECT_EQ(kv_units(0, 3), 6u);          // 1 + 2 + 3
+    EXPECT_EQ(kv_units(100, 2), 100u * 2 + 3);
+    EXPECT_EQ(kv_units(5, 0), 0u);
+}
+
+TEST(StepCostTest, KnowsOnlyWhatItHasSeen) {
+    StepCost cost;
+    EXPECT_FALSE(cost.decode_known());
+    EXPECT_FALSE(cost.prefill_known());
+    cost.observe(4, 0, kv_units(10, 1) * 4, 8.0);
+    EXPECT_TRUE(cost.decode_known());
+    EXPECT_FALSE(cost.prefill_known());
+    cost.observe(0, 0, 0, 100.0); // empty ticks teach nothing
+    EXPECT_EQ(cost.samples(), 1u);
+}
+
+TEST(StepCostTest, RecoversTheStepTimeLaw) {
+    StepCost::Coefficients truth;
+    truth.fixed_ms = 4.0;
+    truth.decode_ms = 0.5;
+    truth.prefill_ms = 0.2;
+    truth.kv_ms_per_k = 0.3;
+    StepCost cost;
+    std::mt19937 rng(3);
+    for (int i = 0; i < 300; ++i) {
+        const Tick t = random_tick(rng);
+        cost.observe(t.decode, t.prefill, t.kv, law(truth, t));
+    }
+    const auto c = cost.coefficients();
+    EXPECT_NEAR(c.fixed_ms, truth.fixed_ms, 1e-2);
+    EXPECT_NEAR(c.decode_ms, truth.decode_ms, 1e-3);
+    EXPECT_NEAR(c.prefill_ms, truth.prefill_ms, 1e-3);
+    EXPECT_NEAR(c.kv_ms_per_k, truth.kv_ms_per_k, 1e-3);
+    EXPECT_LT(cost.error_ms(), 0.05);
+
+    // the same 256-token chunk costs more deep into a context
+    EXPECT_GT(cost.prefill_chunk_ms(256, 8000), 2 * cost.prefill_chunk_ms(256, 0));
+    // prefill_within() is the largest chunk that fits
+    for (int32_t n_past : {0, 1000, 8000}) {
+        const int32_t n = cost.prefill_within(30.0, n_past);
+        EXPECT_LE(cost.prefill_chunk_ms(n, n_past), 30.0);
+        EXPECT_GT(cost.prefill_chunk_ms(n + 1, n_past), 30.0);
+    }
+    const int32_t d = cost.decode_within(30.0, 1000.0);
+    EXPECT_LE(cost.predict_ms(d, 0, kv_units(1000, 1) * d), 30.0);
+    EXPECT_GT(cost.predict_ms(d + 1, 0, kv_units(1000, 1) * (d + 1)), 30.0);
+}
+
+TEST(StepCostTest, FollowsTheDeviceWhenItSlowsDown) {
+    StepCost::Coefficients fast;
+    fast.fixed_ms = 2.0;
+    fast.decode_ms = 0.4;
+    fast.prefill_ms = 0.1;
+    fast.kv_ms_per_k = 0.2;
+    StepCost::Coefficients slow = fast; // e.g. thermal throttling
+    slow.fixed_ms *= 2;
+    slow.decode_ms *= 2;
+    slow.prefill_ms *= 2;
+    slow.kv_ms_per_k *= 2;
+
+    StepCost cost(fast);
+    std::mt19937 rng(5);
+    for (int i = 0; i < 500; ++i) {
+        const Tick t = random_tick(rng);
+        cost.observe(t.decode, t.prefill, t.kv, law(slow, t));
+    }
+    const Tick t = random_tick(rng);
+    EXPECT_NEAR(cost.predict_ms(t.decode, t.prefill, t.kv), law(slow, t), 0.01 * law(slow, t));
+}
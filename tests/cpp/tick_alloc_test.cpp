@@ -0,0 +1,110 @@
+#include "gtest/gtest.h"
+#include "ipc/session.h"
+#include "sched/bmt.h"
+#include "sched/policy.h"
+
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// Counts global operator new calls made on this thread while an AllocCounter is alive.
+// Replacing operator new affects the whole test binary; it only counts inside a scope.
+namespace {
+thread_local size_t* g_alloc_count = nullptr;
+
+struct AllocCounter {
+    size_t n = 0;
+    AllocCounter() { g_alloc_count = &n; }
+    ~AllocCounter() { g_alloc_count = nullptr; }
+};
+} // namespace
+
+void* operator new(std::size_t sz) {
+    if (g_alloc_count)
+        ++*g_alloc_count;
+    if (void* p = std::malloc(sz ? sz : 1))
+        return p;
+    throw std::bad_alloc();
+}
+// GCC pairs the inlined free() with the builtin operator new and warns; the pair is ours.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+using uma::sched::BaselinePolicy;
+using uma::sched::Phase;
+using uma::sched::Plan;
+
+namespace {
+
+void fill_busy_pool(uma::ipc::SessionPool& sessions) {
+    for (int i = 0; i < 8; ++i) {
+        auto& s = sessions.create();
+        sessions.set_state(s, uma::ipc::SessionState::DECODE);
+        s.hot->seq = i; s.hot->has_pending_tok = true; s.hot->n_past = 100 + i;
+    }
+    for (int i = 8; i < 12; ++i) {
+        auto& s = sessions.create();
+        sessions.set_state(s, uma::ipc::SessionState::PREFILL);
+        s.hot->seq = i;
+        s.prompt_tokens.assign(100000, 1);
+        s.first_emit_ns = (i % 2) ? 0 : 1; // half still waiting for their first token
+    }
+}
+
+// What Scheduler::prepare_batch does around the policy, minus the llama batch itself.
+void plan_tick(BaselinePolicy& pol, uma::ipc::SessionPool& sessions, Plan& plan,
+               size_t& rr_d, size_t& rr_p) {
+    pol.schedule_tick(sessions, /*batch_cap*/256, /*target*/128, rr_d, rr_p, plan);
+    bool trimmed = false;
+    uint64_t est = uma::sched::bmt::estimate_units(sessions, plan);
+    uma::sched::bmt::trim_to_budget(sessions, plan, est, /*budget*/20000, trimmed);
+    rr_d = plan.next_rr_decode_idx;
+    rr_p = plan.next_rr_prefill_idx;
+    for (const auto& item : plan.items) {
+        auto& h = *sessions.find(item.sid)->hot;
+        if (item.phase == Phase::DECODE) {
+            h.n_past += 1;
+        } else {
+            h.prefill_idx += (size_t)item.n_tokens;
+            h.n_past += item.n_tokens;
+        }
+    }
+}
+
+} // namespace
+
+TEST(TickAllocTest, SteadyStatePlanningDoesNotAllocate) {
+    uma::ipc::SessionPool sessions;
+    fill_busy_pool(sessions);
+    BaselinePolicy pol;
+    Plan plan;
+    size_t rr_d = 0, rr_p = 0;
+    // the first ticks size the reused buffers
+    for (int i = 0; i < 4; ++i)
+        plan_tick(pol, sessions, plan, rr_d, rr_p);
+
+    size_t allocs = 0;
+    {
+        AllocCounter counter;
+        for (int i = 0; i < 200; ++i)
+            plan_tick(pol, sessions, plan, rr_d, rr_p);
+        allocs = counter.n;
+    }
+    EXPECT_EQ(allocs, 0u);
+    EXPECT_EQ(plan.decode_tok_count, 8);
+    EXPECT_GT(plan.prefill_tok_count, 0);
+}
+
+TEST(TickAllocTest, CounterSeesAllocations) {
+    AllocCounter counter;
+    std::vector<int> v;
+    v.reserve(64);
+    EXPECT_EQ(counter.n, 1u);
+}
@@ -0,0 +1,92 @@
+#include "gtest/gtest.h"
+#include "runtime/tokenizer_pool.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using uma::runtime::TokenizeJob;
+using uma::runtime::TokenizeResult;
+using uma::runtime::TokenizerPool;
+
+namespace {
+
+// Stand-in tokenizer: one "token" per byte (its value), plus an optional BOS of 1.
+std::vector<int> fake_tokenize(const std::string& text, bool add_bos, bool) {
+    std::vector<int> out;
+    if (add_bos) out.push_back(1);
+    for (unsigned char c : text) out.push_back(c);
+    return out;
+}
+
+} // namespace
+
+TEST(TokenizerPool, CompletesEveryJobOffThread) {
+    std::atomic<int> notified{0};
+    const auto loop_id = std::this_thread::get_id();
+    std::atomic<bool> ran_on_loop{false};
+    TokenizerPool pool(
+            3,
+            [&](const std::string& t, bool bos, bool sp) {
+                if (std::this_thread::get_id() == loop_id) ran_on_loop = true;
+                return fake_tokenize(t, bos, sp);
+            },
+            [&] { notified.fetch_add(1); });
+
+    constexpr int kJobs = 200;
+    for (int i = 0; i < kJobs; ++i) {
+        TokenizeJob job;
+        job.sid = i;
+        job.submit_ns = 1000 + i;
+        job.add_bos = (i % 2) == 0;
+        job.text = "job-" + std::to_string(i);
+        pool.submit(std::move(job));
+    }
+
+    std::map<int, TokenizeResult> got;
+    std::vector<TokenizeResult> batch;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while ((int)got.size() < kJobs && std::chrono::steady_clock::now() < deadline) {
+        batch.clear();
+        pool.drain(batch);
+        for (auto& r : batch) got[r.sid] = std::move(r);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ((int)got.size(), kJobs);
+    EXPECT_EQ(pool.depth(), 0u);
+    EXPECT_FALSE(ran_on_loop.load());
+    EXPECT_EQ(notified.load(), kJobs);
+    for (int i = 0; i < kJobs; ++i) {
+        const auto& r = got[i];
+        EXPECT_EQ(r.submit_ns, 1000u + i);
+        EXPECT_EQ(r.tokens, fake_tokenize("job-" + std::to_string(i), (i % 2) == 0, true));
+    }
+}
+
+TEST(TokenizerPool, DrainIsEmptyWithoutWorkAndShutdownDropsBacklog) {
+    std::atomic<bool> release{false};
+    auto pool = std::make_unique<TokenizerPool>(
+            1,
+            [&](const std::string& t, bool bos, bool sp) {
+                while (!release.load()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                return fake_tokenize(t, bos, sp);
+            },
+            nullptr);
+    std::vector<TokenizeResult> out;
+    EXPECT_EQ(pool->drain(out), 0u);
+
+    for (int i = 0; i < 5; ++i) {
+        TokenizeJob job;
+        job.sid = i;
+        job.text = std::string(1000, 'x');
+        pool->submit(std::move(job));
+    }
+    EXPECT_EQ(pool->depth(), 5u);
+    release = true;
+    pool.reset(); // joins after the running job; queued ones are dropped
+    SUCCEED();
+}
@@ -0,0 +1,145 @@
+#include "gtest/gtest.h"
+#include "ipc/protocol.h"
+#include "ipc/tx_queue.h"
+
+#include <memory>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+using uma::ipc::ByteBuffer;
+using uma::ipc::TxQueue;
+
+namespace {
+
+// Concatenate what a gather write of the whole queue would send.
+std::string flatten(const TxQueue& q) {
+    iovec iov[TxQueue::kMaxIov];
+    int n = q.fill_iov(iov, TxQueue::kMaxIov);
+    std::string out;
+    for (int i = 0; i < n; ++i) out.append(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
+    return out;
+}
+
+std::string read_payload(ByteBuffer& rx) {
+    std::string js, err;
+    EXPECT_TRUE(uma::ipc::protocol::try_read_frame(rx, js, uma::ipc::protocol::kDefaultMaxFrameBytes, &err));
+    return js;
+}
+
+} // namespace
+
+TEST(TxQueueTest, OwnedAndSharedSegmentsInOrder) {
+    TxQueue q;
+    const std::string shared = "SHARED";
+    q.append(std::string("a"));
+    q.append_shared(shared.data(), shared.size());
+    q.append(std::string("b"));
+    q.append(std::string("c")); // merges with the previous owned segment
+    EXPECT_EQ(q.size(), 9u);
+    iovec iov[TxQueue::kMaxIov];
+    EXPECT_EQ(q.fill_iov(iov, TxQueue::kMaxIov), 3);
+    EXPECT_EQ(iov[1].iov_base, shared.data()); // referenced, not copied
+    EXPECT_EQ(flatten(q), "aSHAREDbc");
+}
+
+TEST(TxQueueTest, PartialConsumeAcrossSegments) {
+    TxQueue q;
+    const std::string shared = "0123";
+    q.append(std::string("xy"));
+    q.append_shared(shared.data(), shared.size());
+    q.append(std::string("z"));
+    q.consume(3); // "xy" + "0"
+    EXPECT_EQ(flatten(q), "123z");
+    q.consume(4);
+    EXPECT_TRUE(q.empty());
+}
+
+// Token frames must be byte-identical to the former single-buffer encoding.
+TEST(TxQueueTest, TokenEventMatchesJsonEncoding) {
+    const std::string id = "req-\"1\"";
+    const std::string prefix = uma::ipc::protocol::render_token_prefix(id);
+    TxQueue q;
+    uma::ipc::protocol::append_token_event(q, prefix, "he said \"hi\"\n\x01", 42);
+    uma::ipc::protocol::append_token_event(q, prefix, "", 7);
+
+    ByteBuffer rx;
+    rx.append(flatten(q));
+    EXPECT_EQ(read_payload(rx), "{\"id\":\"req-\\\"1\\\"\",\"event\":\"token\",\"text\":\"he said "
+                                "\\\"hi\\\"\\n\\u0001\",\"token_id\":42}");
+    EXPECT_EQ(read_payload(rx), "{\"id\":\"req-\\\"1\\\"\",\"event\":\"token\",\"text\":\"\",\"token_id\":7}");
+    EXPECT_TRUE(rx.empty());
+}
+
+// Coalesced events carry parallel arrays of pieces and ids, in JSON or binary form.
+TEST(TxQueueTest, CoalescedTokensEvents) {
+    const int32_t ids[] = {11, 12, 13};
+    const uint32_t lens[] = {2, 0, 4};
+    const std::string text = "a\"" "b\nc\xC3";
+    TxQueue q;
+    uma::ipc::protocol::append_tokens_event(q, "r1", ids, lens, 3, text);
+    uma::ipc::protocol::append_tokens_event_bin(q, 5, ids, lens, 3, text);
+
+    ByteBuffer rx;
+    rx.append(flatten(q));
+    EXPECT_EQ(read_payload(rx), "{\"id\":\"r1\",\"event\":\"tokens\",\"text\":[\"a\\\"\",\"\","
+                                "\"b\\nc\xC3\"],\"token_ids\":[11,12,13]}");
+    std::vector<uma::ipc::protocol::BinTokenEvent> evs;
+    const std::string bin = read_payload(rx); // events view into this payload
+    ASSERT_TRUE(uma::ipc::protocol::parse_token_events_bin(bin, evs));
+    ASSERT_EQ(evs.size(), 3u);
+    EXPECT_EQ(evs[0].handle, 5u);
+    EXPECT_EQ(evs[0].token_id, 11);
+    EXPECT_EQ(evs[0].text, "a\"");
+    EXPECT_TRUE(evs[1].text.empty());
+    EXPECT_EQ(evs[2].token_id, 13);
+    EXPECT_EQ(evs[2].text, "b\nc\xC3");
+    EXPECT_TRUE(rx.empty());
+}
+
+TEST(TxQueueTest, OwnAllDetachesSharedBytes) {
+    std::string prefix = uma::ipc::protocol::render_token_prefix("a");
+    TxQueue q;
+    uma::ipc::protocol::append_token_event(q, prefix, "x", 1);
+    const std::string before = flatten(q);
+    q.own_all();
+    prefix.assign(prefix.size(), '#'); // caller may now reuse its bytes
+    EXPECT_EQ(flatten(q), before);
+}
+
+TEST(TxQueueTest, RetainKeepsSharedBytesUntilDrained) {
+    auto prefix = std::make_shared<const std::string>(
+            uma::ipc::protocol::render_token_prefix("a"));
+    std::weak_ptr<const std::string> alive = prefix;
+    TxQueue q;
+    uma::ipc::protocol::append_token_event(q, *prefix, "x", 1);
+    const std::string before = flatten(q);
+    const size_t first = q.size();
+    q.retain(std::move(prefix)); // the request retires; its frame is still queued
+    q.append("later", 5);        // bytes queued afterwards do not extend the hold
+    EXPECT_FALSE(alive.expired());
+    EXPECT_EQ(flatten(q), before + "later");
+
+    q.consume(first - 1);
+    EXPECT_FALSE(alive.expired());
+    q.consume(1);
+    EXPECT_TRUE(alive.expired());
+    EXPECT_EQ(flatten(q), "later");
+}
+
+TEST(TxQueueTest, WriteToUsesOneGatherCall) {
+    int sv[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+    const std::string prefix = uma::ipc::protocol::render_token_prefix("r");
+    TxQueue q;
+    for (int i = 0; i < 5; ++i) uma::ipc::protocol::append_token_event(q, prefix, "tok", i);
+    const std::string expect = flatten(q);
+    ASSERT_EQ(q.write_to(sv[0]), (ssize_t)expect.size());
+    EXPECT_TRUE(q.empty());
+    std::string got(expect.size(), '\0');
+    ASSERT_EQ(::read(sv[1], &got[0], got.size()), (ssize_t)got.size());
+    EXPECT_EQ(got, expect);
+    ::close(sv[0]);
+    ::close(sv[1]);
+}
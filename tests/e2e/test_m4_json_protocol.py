@@ -90,11 +90,10 @@ def test_json_protocol_exchange(umad_daemon):
 
 
 @pytest.mark.e2e
-@pytest.mark.xfail(reason="Cancellation not implemented yet")
 def test_json_protocol_cancellation(umad_daemon):
     """
-    Tests that an in-flight request can be cancelled.
-    This is a TDD test and is expected to fail until cancellation is implemented.
+    Tests that an in-flight request can be cancelled: generation stops and the
+    request ends with eos reason "cancelled".
     """
     sock_path, _ = umad_daemon
     request_id = "test_cancellation"
@@ -191,3 +190,43 @@ def test_json_protocol_oversize_header(umad_daemon):
             assert ev.get("code") in ("E_PROTO_FRAME_TOO_LARGE", "E_PROTO_INVALID_LEN")
         except socket.timeout:
             pytest.fail("Timed out waiting for oversize error event")
+
+
+@pytest.mark.e2e
+def test_json_protocol_multiplexed_requests(umad_daemon):
+    """Two requests in flight on one connection; events are routed by id."""
+    sock_path, _ = umad_daemon
+    ids = ["mux_a", "mux_b"]
+    done = {}
+    counts = {i: 0 for i in ids}
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as s:
+        s.settimeout(60)
+        s.connect(sock_path)
+        out = b""
+        for rid in ids:
+            payload = json.dumps({"id": rid, "prompt": "Count to five.", "max_tokens": 8}).encode('utf-8')
+            out += struct.pack('<I', len(payload)) + payload
+        s.sendall(out)  # both frames in one write
+
+        buf = b""
+        while len(done) < len(ids):
+            chunk = s.recv(65536)
+            if not chunk:
+                break
+            buf += chunk
+            while len(buf) >= 4:
+                n = struct.unpack('<I', buf[:4])[0]
+                if len(buf) < 4 + n:
+                    break
+                ev = json.loads(buf[4:4 + n].decode('utf-8'))
+                buf = buf[4 + n:]
+                assert ev.get("id") in ids, f"Unexpected event {ev}"
+                if ev.get("event") in ("token", "tokens"):
+                    counts[ev["id"]] += 1
+                elif ev.get("event") in ("eos", "error"):
+                    done[ev["id"]] = ev
+
+    assert set(done) == set(ids), f"Missing final events: {done}"
+    for rid in ids:
+        assert done[rid]["event"] == "eos"
+        assert counts[rid] > 0, f"No tokens for {rid}"